@@ -88,29 +88,9 @@ BthPS3_DeviceContextHeaderInit(
 			break;
 		}
 
-		if (!NT_SUCCESS(status = WdfWaitLockCreate(
-			&attributes,
-			&Header->ClientsLock
-		)))
-		{
-			break;
-		}
-
-		if (!NT_SUCCESS(status = WdfCollectionCreate(
-			&attributes,
-			&Header->Clients
-		)))
-		{
-			break;
-		}
-
-		if (!NT_SUCCESS(status = WdfWaitLockCreate(
-			&attributes,
-			&Header->SlotsLock
-		)))
-		{
-			break;
-		}
+		RtlZeroMemory(Header->Clients, sizeof(Header->Clients));
+		Header->ClientsCount = 0;
+		ExInitializePushLock(&Header->ClientsLock);
 
 		//
 		// Open
@@ -134,11 +114,24 @@ BthPS3_DeviceContextHeaderInit(
 			hKey,
 			&slots,
 			sizeof(Header->Slots),
-			&Header->Slots,
+			(PVOID)Header->Slots,
 			&length,
 			&type
 		);
 
+		//
+		// Serve slot lookups from memory from here on
+		// 
+		if (!NT_SUCCESS(status = BthPS3_PDO_SlotCacheLoad(Header, hKey)))
+		{
+			TraceError(
+				TRACE_BTH,
+				"BthPS3_PDO_SlotCacheLoad failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
 	} while (FALSE);
 
 	if (hKey)
@@ -195,36 +188,46 @@ BthPS3_ServerContextInit(
 			break;
 		}
 
+		WDF_TIMER_CONFIG_INIT(&timerCfg, BthPS3_ExclusionExpiryEvtWdfTimer);
+		//
+		// Re-sends the exclusions synchronously, requires PASSIVE_LEVEL
+		// 
+		timerCfg.AutomaticSerialization = FALSE;
+
 		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
 		attributes.ParentObject = Device;
+		attributes.ExecutionLevel = WdfExecutionLevelPassive;
 
-		if (!NT_SUCCESS(status = WdfCollectionCreate(
+		if (!NT_SUCCESS(status = WdfTimerCreate(
+			&timerCfg,
 			&attributes,
-			&Context->Settings.SIXAXISSupportedNames
+			&Context->PsmFilter.ExclusionExpiryTimer
 		)))
 		{
 			break;
 		}
 
-		if (!NT_SUCCESS(status = WdfCollectionCreate(
-			&attributes,
-			&Context->Settings.NAVIGATIONSupportedNames
-		)))
-		{
-			break;
-		}
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = Device;
 
-		if (!NT_SUCCESS(status = WdfCollectionCreate(
+		if (!NT_SUCCESS(status = WdfWaitLockCreate(
 			&attributes,
-			&Context->Settings.MOTIONSupportedNames
+			&Context->PsmFilter.ExcludedLock
 		)))
 		{
 			break;
 		}
 
-		if (!NT_SUCCESS(status = WdfCollectionCreate(
+		ExInitializePushLock(&Context->SettingsLock);
+		ExInitializePushLock(&Context->NameCache.Lock);
+		KeInitializeEvent(&Context->SettingsNotify.StoppedEvent, NotificationEvent, FALSE);
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = Device;
+
+		if (!NT_SUCCESS(status = WdfWaitLockCreate(
 			&attributes,
-			&Context->Settings.WIRELESSSupportedNames
+			&Context->SettingsNotify.Lock
 		)))
 		{
 			break;
@@ -244,7 +247,7 @@ BthPS3_ServerContextInit(
 #pragma code_seg()
 
 //
-// Read runtime properties from registry
+// Read runtime properties from registry into a new snapshot and publish it
 // 
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -256,6 +259,9 @@ BthPS3_SettingsContextInit(
 	NTSTATUS status;
 	WDFKEY hKey = NULL;
 	WDF_OBJECT_ATTRIBUTES attributes;
+	WDFMEMORY memory = NULL;
+	PBTHPS3_SETTINGS pSettings = NULL;
+	PBTHPS3_SETTINGS pPrevious;
 
 	PAGED_CODE();
 
@@ -268,124 +274,583 @@ BthPS3_SettingsContextInit(
 	DECLARE_CONST_UNICODE_STRING(isMOTIONSupported, BTHPS3_REG_VALUE_IS_MOTION_SUPPORTED);
 	DECLARE_CONST_UNICODE_STRING(isWIRELESSSupported, BTHPS3_REG_VALUE_IS_WIRELESS_SUPPORTED);
 
+	DECLARE_CONST_UNICODE_STRING(rawPdo, BTHPS3_REG_VALUE_RAW_PDO);
+	DECLARE_CONST_UNICODE_STRING(adminOnlyPdo, BTHPS3_REG_VALUE_ADMIN_ONLY_PDO);
+	DECLARE_CONST_UNICODE_STRING(exclusivePdo, BTHPS3_REG_VALUE_EXCLUSIVE_PDO);
+	DECLARE_CONST_UNICODE_STRING(hidePdo, BTHPS3_REG_VALUE_HIDE_PDO);
+	DECLARE_CONST_UNICODE_STRING(childReadRingSize, BTHPS3_REG_VALUE_CHILD_READ_RING_SIZE);
+	DECLARE_CONST_UNICODE_STRING(childCoalesceReads, BTHPS3_REG_VALUE_CHILD_COALESCE_READS);
+	DECLARE_CONST_UNICODE_STRING(childLingerTimeout, BTHPS3_REG_VALUE_CHILD_LINGER_TIMEOUT);
+
 	DECLARE_CONST_UNICODE_STRING(SIXAXISSupportedNames, BTHPS3_REG_VALUE_SIXAXIS_SUPPORTED_NAMES);
 	DECLARE_CONST_UNICODE_STRING(NAVIGATIONSupportedNames, BTHPS3_REG_VALUE_NAVIGATION_SUPPORTED_NAMES);
 	DECLARE_CONST_UNICODE_STRING(MOTIONSupportedNames, BTHPS3_REG_VALUE_MOTION_SUPPORTED_NAMES);
 	DECLARE_CONST_UNICODE_STRING(WIRELESSSupportedNames, BTHPS3_REG_VALUE_WIRELESS_SUPPORTED_NAMES);
 
-	//
-	// Set default values
-	//
-	Context->Settings.AutoEnableFilter = TRUE;
-	Context->Settings.AutoDisableFilter = TRUE;
-	Context->Settings.AutoEnableFilterDelay = 10; // Seconds
+	do
+	{
+		//
+		// Snapshot memory, owns the name collections
+		// 
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = Context->Header.Device;
 
-	Context->Settings.IsSIXAXISSupported = TRUE;
-	Context->Settings.IsNAVIGATIONSupported = TRUE;
-	Context->Settings.IsMOTIONSupported = TRUE;
-	Context->Settings.IsWIRELESSSupported = TRUE;
+		if (!NT_SUCCESS(status = WdfMemoryCreate(
+			&attributes,
+			NonPagedPoolNx,
+			POOLTAG_BTHPS3,
+			sizeof(BTHPS3_SETTINGS),
+			&memory,
+			(PVOID*)&pSettings
+		)))
+		{
+			break;
+		}
 
-	//
-	// Open
-	//   HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Services\BthPS3\Parameters
-	// key
-	// 
-	status = WdfDriverOpenParametersRegistryKey(
-		WdfGetDriver(),
-		STANDARD_RIGHTS_READ,
-		WDF_NO_OBJECT_ATTRIBUTES,
-		&hKey
-	);
+		RtlZeroMemory(pSettings, sizeof(BTHPS3_SETTINGS));
+
+		pSettings->Memory = memory;
+		pSettings->RefCount = 1;
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = memory;
+
+		if (!NT_SUCCESS(status = WdfCollectionCreate(
+			&attributes,
+			&pSettings->SIXAXISSupportedNames
+		)))
+		{
+			break;
+		}
+
+		if (!NT_SUCCESS(status = WdfCollectionCreate(
+			&attributes,
+			&pSettings->NAVIGATIONSupportedNames
+		)))
+		{
+			break;
+		}
+
+		if (!NT_SUCCESS(status = WdfCollectionCreate(
+			&attributes,
+			&pSettings->MOTIONSupportedNames
+		)))
+		{
+			break;
+		}
+
+		if (!NT_SUCCESS(status = WdfCollectionCreate(
+			&attributes,
+			&pSettings->WIRELESSSupportedNames
+		)))
+		{
+			break;
+		}
+
+		//
+		// Set default values
+		// 
+		pSettings->AutoEnableFilter = TRUE;
+		pSettings->AutoDisableFilter = TRUE;
+		pSettings->AutoEnableFilterDelay = 10; // Seconds
+
+		pSettings->IsSIXAXISSupported = TRUE;
+		pSettings->IsNAVIGATIONSupported = TRUE;
+		pSettings->IsMOTIONSupported = TRUE;
+		pSettings->IsWIRELESSSupported = TRUE;
+
+		pSettings->RawPdo = FALSE;
+		pSettings->AdminOnlyPdo = FALSE;
+		pSettings->ExclusivePdo = TRUE;
+		pSettings->HidePdo = FALSE;
+		pSettings->ChildReadRingSize = 0;
+		pSettings->ChildCoalesceReads = FALSE;
+		pSettings->ChildLingerTimeout = 0;
+
+		//
+		// Open
+		//   HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Services\BthPS3\Parameters
+		// key
+		// 
+		if (!NT_SUCCESS(status = WdfDriverOpenParametersRegistryKey(
+			WdfGetDriver(),
+			STANDARD_RIGHTS_READ,
+			WDF_NO_OBJECT_ATTRIBUTES,
+			&hKey
+		)))
+		{
+			break;
+		}
 
-	//
-	// On success, read configuration values
-	// 
-	if (NT_SUCCESS(status))
-	{
 		//
 		// Don't care, if it fails, keep default value
 		// 
 		(void)WdfRegistryQueryULong(
 			hKey,
 			&autoEnableFilter,
-			&Context->Settings.AutoEnableFilter
+			&pSettings->AutoEnableFilter
 		);
 
 		(void)WdfRegistryQueryULong(
 			hKey,
 			&autoDisableFilter,
-			&Context->Settings.AutoDisableFilter
+			&pSettings->AutoDisableFilter
 		);
 
 		(void)WdfRegistryQueryULong(
 			hKey,
 			&autoEnableFilterDelay,
-			&Context->Settings.AutoEnableFilterDelay
+			&pSettings->AutoEnableFilterDelay
 		);
 
 		(void)WdfRegistryQueryULong(
 			hKey,
 			&isSIXAXISSupported,
-			&Context->Settings.IsSIXAXISSupported
+			&pSettings->IsSIXAXISSupported
 		);
 
 		(void)WdfRegistryQueryULong(
 			hKey,
 			&isNAVIGATIONSupported,
-			&Context->Settings.IsNAVIGATIONSupported
+			&pSettings->IsNAVIGATIONSupported
 		);
 
 		(void)WdfRegistryQueryULong(
 			hKey,
 			&isMOTIONSupported,
-			&Context->Settings.IsMOTIONSupported
+			&pSettings->IsMOTIONSupported
 		);
 
 		(void)WdfRegistryQueryULong(
 			hKey,
 			&isWIRELESSSupported,
-			&Context->Settings.IsWIRELESSSupported
+			&pSettings->IsWIRELESSSupported
+		);
+
+		(void)WdfRegistryQueryULong(
+			hKey,
+			&rawPdo,
+			&pSettings->RawPdo
+		);
+
+		(void)WdfRegistryQueryULong(
+			hKey,
+			&adminOnlyPdo,
+			&pSettings->AdminOnlyPdo
+		);
+
+		(void)WdfRegistryQueryULong(
+			hKey,
+			&exclusivePdo,
+			&pSettings->ExclusivePdo
+		);
+
+		(void)WdfRegistryQueryULong(
+			hKey,
+			&hidePdo,
+			&pSettings->HidePdo
+		);
+
+		(void)WdfRegistryQueryULong(
+			hKey,
+			&childReadRingSize,
+			&pSettings->ChildReadRingSize
+		);
+
+		(void)WdfRegistryQueryULong(
+			hKey,
+			&childCoalesceReads,
+			&pSettings->ChildCoalesceReads
+		);
+
+		(void)WdfRegistryQueryULong(
+			hKey,
+			&childLingerTimeout,
+			&pSettings->ChildLingerTimeout
 		);
 
 		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-		attributes.ParentObject = Context->Settings.SIXAXISSupportedNames;
+		attributes.ParentObject = pSettings->SIXAXISSupportedNames;
 		(void)WdfRegistryQueryMultiString(
 			hKey,
 			&SIXAXISSupportedNames,
 			&attributes,
-			Context->Settings.SIXAXISSupportedNames
+			pSettings->SIXAXISSupportedNames
 		);
 
 		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-		attributes.ParentObject = Context->Settings.NAVIGATIONSupportedNames;
+		attributes.ParentObject = pSettings->NAVIGATIONSupportedNames;
 		(void)WdfRegistryQueryMultiString(
 			hKey,
 			&NAVIGATIONSupportedNames,
 			&attributes,
-			Context->Settings.NAVIGATIONSupportedNames
+			pSettings->NAVIGATIONSupportedNames
 		);
 
 		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-		attributes.ParentObject = Context->Settings.MOTIONSupportedNames;
+		attributes.ParentObject = pSettings->MOTIONSupportedNames;
 		(void)WdfRegistryQueryMultiString(
 			hKey,
 			&MOTIONSupportedNames,
 			&attributes,
-			Context->Settings.MOTIONSupportedNames
+			pSettings->MOTIONSupportedNames
 		);
 
 		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-		attributes.ParentObject = Context->Settings.WIRELESSSupportedNames;
+		attributes.ParentObject = pSettings->WIRELESSSupportedNames;
 		(void)WdfRegistryQueryMultiString(
 			hKey,
 			&WIRELESSSupportedNames,
 			&attributes,
-			Context->Settings.WIRELESSSupportedNames
+			pSettings->WIRELESSSupportedNames
 		);
 
+		//
+		// Compile in identification order, earlier device types win on overlapping names
+		// 
+		NameMatcher_Init(&pSettings->NameMatcher);
+
+		if (pSettings->IsSIXAXISSupported)
+		{
+			BthPS3_SettingsCompileNames(pSettings, pSettings->SIXAXISSupportedNames, DS_DEVICE_TYPE_SIXAXIS);
+		}
+
+		if (pSettings->IsNAVIGATIONSupported)
+		{
+			BthPS3_SettingsCompileNames(pSettings, pSettings->NAVIGATIONSupportedNames, DS_DEVICE_TYPE_NAVIGATION);
+		}
+
+		if (pSettings->IsMOTIONSupported)
+		{
+			BthPS3_SettingsCompileNames(pSettings, pSettings->MOTIONSupportedNames, DS_DEVICE_TYPE_MOTION);
+		}
+
+		if (pSettings->IsWIRELESSSupported)
+		{
+			BthPS3_SettingsCompileNames(pSettings, pSettings->WIRELESSSupportedNames, DS_DEVICE_TYPE_WIRELESS);
+		}
+
+		//
+		// Publish, consumers still holding the previous snapshot keep it alive
+		// 
+		KeEnterCriticalRegion();
+		ExAcquirePushLockExclusive(&Context->SettingsLock);
+
+		pPrevious = Context->Settings;
+		Context->Settings = pSettings;
+
+		ExReleasePushLockExclusive(&Context->SettingsLock);
+		KeLeaveCriticalRegion();
+
+		if (pPrevious != NULL)
+		{
+			BthPS3_SettingsRelease(pPrevious);
+		}
+
+	} while (FALSE);
+
+	if (hKey)
+	{
 		WdfRegistryClose(hKey);
 	}
 
+	//
+	// Keep the current snapshot on failure
+	// 
+	if (!NT_SUCCESS(status) && memory != NULL)
+	{
+		WdfObjectDelete(memory);
+	}
+
+	return status;
+}
+#pragma code_seg()
+
+//
+// Adds the (UTF-8 converted) names of a collection to the name matcher
+// 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+BthPS3_SettingsCompileNames(
+	_In_ PBTHPS3_SETTINGS Settings,
+	_In_ WDFCOLLECTION Names,
+	_In_ DS_DEVICE_TYPE DeviceType
+)
+{
+	NTSTATUS status;
+	UNICODE_STRING name;
+	CHAR utf8Name[BTH_MAX_NAME_SIZE];
+	ULONG length;
+
+	PAGED_CODE();
+
+	for (ULONG index = 0; index < WdfCollectionGetCount(Names); index++)
+	{
+		WdfStringGetUnicodeString(WdfCollectionGetItem(Names, index), &name);
+
+		if (!NT_SUCCESS(status = RtlUnicodeToUTF8N(
+			utf8Name,
+			sizeof(utf8Name),
+			&length,
+			name.Buffer,
+			name.Length
+		)))
+		{
+			TraceError(
+				TRACE_BTH,
+				"RtlUnicodeToUTF8N failed with status %!STATUS!, skipping \"%wZ\"",
+				status,
+				&name
+			);
+			continue;
+		}
+
+		if (!NameMatcher_Add(&Settings->NameMatcher, utf8Name, length, DeviceType))
+		{
+			TraceError(
+				TRACE_BTH,
+				"Name matcher is full, ignoring \"%wZ\" and following names",
+				&name
+			);
+			break;
+		}
+	}
+}
+#pragma code_seg()
+
+//
+// Takes a reference on the current settings snapshot
+// 
+_IRQL_requires_max_(APC_LEVEL)
+PBTHPS3_SETTINGS
+BthPS3_SettingsAcquire(
+	_In_ PBTHPS3_SERVER_CONTEXT Context
+)
+{
+	PBTHPS3_SETTINGS pSettings;
+
+	KeEnterCriticalRegion();
+	ExAcquirePushLockShared(&Context->SettingsLock);
+
+	pSettings = Context->Settings;
+	InterlockedIncrement(&pSettings->RefCount);
+
+	ExReleasePushLockShared(&Context->SettingsLock);
+	KeLeaveCriticalRegion();
+
+	return pSettings;
+}
+
+//
+// Drops a reference on a settings snapshot, frees it once unused
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_SettingsRelease(
+	_In_ PBTHPS3_SETTINGS Settings
+)
+{
+	if (InterlockedDecrement(&Settings->RefCount) == 0)
+	{
+		WdfObjectDelete(Settings->Memory);
+	}
+}
+
+//
+// Opens the Parameters key and starts watching it for changes
+// 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_SettingsNotifyStart(
+	_In_ PBTHPS3_SERVER_CONTEXT Context
+)
+{
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+
+	FuncEntry(TRACE_BTH);
+
+	PAGED_CODE();
+
+	do
+	{
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = Context->Header.Device;
+
+		if (!NT_SUCCESS(status = WdfDriverOpenParametersRegistryKey(
+			WdfGetDriver(),
+			KEY_READ,
+			&attributes,
+			&Context->SettingsNotify.Key
+		)))
+		{
+			TraceError(
+				TRACE_BTH,
+				"WdfDriverOpenParametersRegistryKey failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
+		ExInitializeWorkItem(
+			&Context->SettingsNotify.WorkItem,
+			BthPS3_SettingsChangedWorkItem,
+			Context
+		);
+
+		Context->SettingsNotify.IsStopping = FALSE;
+
+		if (!NT_SUCCESS(status = BthPS3_SettingsNotifyArm(Context)))
+		{
+			TraceError(
+				TRACE_BTH,
+				"BthPS3_SettingsNotifyArm failed with status %!STATUS!",
+				status
+			);
+
+			WdfRegistryClose(Context->SettingsNotify.Key);
+			Context->SettingsNotify.Key = NULL;
+			break;
+		}
+
+		Context->SettingsNotify.IsArmed = TRUE;
+
+	} while (FALSE);
+
+	FuncExit(TRACE_BTH, "status=%!STATUS!", status);
+
 	return status;
 }
 #pragma code_seg()
+
+//
+// Requests a one-shot change notification, completion queues the work item
+// 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_SettingsNotifyArm(
+	_In_ PBTHPS3_SERVER_CONTEXT Context
+)
+{
+	PAGED_CODE();
+
+	//
+	// Kernel-mode callers may pass a work item in place of the APC routine
+	// 
+	return ZwNotifyChangeKey(
+		WdfRegistryWdmGetHandle(Context->SettingsNotify.Key),
+		NULL,
+		(PIO_APC_ROUTINE)(ULONG_PTR)&Context->SettingsNotify.WorkItem,
+		(PVOID)(UINT_PTR)(unsigned int)DelayedWorkQueue,
+		&Context->SettingsNotify.IoStatus,
+		REG_NOTIFY_CHANGE_LAST_SET,
+		FALSE,
+		NULL,
+		0,
+		TRUE
+	);
+}
+#pragma code_seg()
+
+//
+// Stops watching the Parameters key and waits for the work item to settle
+// 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+BthPS3_SettingsNotifyStop(
+	_In_ PBTHPS3_SERVER_CONTEXT Context
+)
+{
+	FuncEntry(TRACE_BTH);
+
+	PAGED_CODE();
+
+	if (Context->SettingsNotify.IsArmed)
+	{
+		WdfWaitLockAcquire(Context->SettingsNotify.Lock, NULL);
+
+		Context->SettingsNotify.IsStopping = TRUE;
+
+		//
+		// Closing the key completes a pending notification with STATUS_NOTIFY_CLEANUP
+		// 
+		WdfRegistryClose(Context->SettingsNotify.Key);
+		Context->SettingsNotify.Key = NULL;
+
+		WdfWaitLockRelease(Context->SettingsNotify.Lock);
+
+		(void)KeWaitForSingleObject(
+			&Context->SettingsNotify.StoppedEvent,
+			Executive,
+			KernelMode,
+			FALSE,
+			NULL
+		);
+
+		Context->SettingsNotify.IsArmed = FALSE;
+	}
+
+	FuncExitNoReturn(TRACE_BTH);
+}
+#pragma code_seg()
+
+//
+// Parameters key changed, reload settings and re-arm notification
+// 
+#pragma code_seg("PAGE")
+_Use_decl_annotations_
+VOID
+BthPS3_SettingsChangedWorkItem(
+	PVOID Parameter
+)
+{
+	const PBTHPS3_SERVER_CONTEXT pCtx = (PBTHPS3_SERVER_CONTEXT)Parameter;
+	NTSTATUS status;
+
+	FuncEntry(TRACE_BTH);
+
+	PAGED_CODE();
+
+	do
+	{
+		if (pCtx->SettingsNotify.IsStopping
+			|| pCtx->SettingsNotify.IoStatus.Status == STATUS_NOTIFY_CLEANUP)
+		{
+			status = STATUS_NOTIFY_CLEANUP;
+			break;
+		}
+
+		if (!NT_SUCCESS(status = BthPS3_SettingsContextInit(pCtx)))
+		{
+			TraceError(
+				TRACE_BTH,
+				"BthPS3_SettingsContextInit failed with status %!STATUS!, keeping previous settings",
+				status
+			);
+		}
+
+		WdfWaitLockAcquire(pCtx->SettingsNotify.Lock, NULL);
+
+		status = pCtx->SettingsNotify.IsStopping
+			? STATUS_NOTIFY_CLEANUP
+			: BthPS3_SettingsNotifyArm(pCtx);
+
+		WdfWaitLockRelease(pCtx->SettingsNotify.Lock);
+
+	} while (FALSE);
+
+	//
+	// No notification pending anymore, unblock shutdown
+	// 
+	if (status == STATUS_NOTIFY_CLEANUP || !NT_SUCCESS(status))
+	{
+		KeSetEvent(&pCtx->SettingsNotify.StoppedEvent, IO_NO_INCREMENT, FALSE);
+	}
+
+	FuncExit(TRACE_BTH, "status=%!STATUS!", status);
+}
+#pragma code_seg()
@@ -291,6 +291,127 @@ BthPS3_GetDeviceName(
     return status;
 }
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_GetDeviceNameCached(
+    PBTHPS3_SERVER_CONTEXT Context,
+    BTH_ADDR RemoteAddress,
+    PCHAR Name
+)
+{
+    FuncEntryArguments(
+        TRACE_BTH,
+        "RemoteAddress=%012llX",
+        RemoteAddress
+    );
+
+    NTSTATUS status = STATUS_NOT_FOUND;
+    ULONG index;
+
+    KeEnterCriticalRegion();
+    ExAcquirePushLockShared(&Context->NameCache.Lock);
+
+    for (index = 0; index < BTHPS3_NAME_CACHE_SIZE; index++)
+    {
+        if (Context->NameCache.Entries[index].RemoteAddress == RemoteAddress)
+        {
+            strcpy_s(Name, BTH_MAX_NAME_SIZE, Context->NameCache.Entries[index].Name);
+            status = STATUS_SUCCESS;
+            break;
+        }
+    }
+
+    ExReleasePushLockShared(&Context->NameCache.Lock);
+    KeLeaveCriticalRegion();
+
+    if (NT_SUCCESS(status))
+    {
+        TraceVerbose(
+            TRACE_BTH,
+            "Remote name served from cache"
+        );
+
+        FuncExit(TRACE_BTH, "status=%!STATUS!", status);
+
+        return status;
+    }
+
+    //
+    // Cold path, query (possibly huge) device cache of radio
+    // 
+    if (!NT_SUCCESS(status = BthPS3_GetDeviceName(
+        Context->Header.IoTarget,
+        RemoteAddress,
+        Name
+    )))
+    {
+        FuncExit(TRACE_BTH, "status=%!STATUS!", status);
+
+        return status;
+    }
+
+    KeEnterCriticalRegion();
+    ExAcquirePushLockExclusive(&Context->NameCache.Lock);
+
+    PBTHPS3_NAME_CACHE_ENTRY pEntry = NULL;
+
+    //
+    // Refresh existing entry (concurrent miss) or occupy a free one
+    // 
+    for (index = 0; index < BTHPS3_NAME_CACHE_SIZE; index++)
+    {
+        if (Context->NameCache.Entries[index].RemoteAddress == RemoteAddress)
+        {
+            pEntry = &Context->NameCache.Entries[index];
+            break;
+        }
+
+        if (pEntry == NULL && Context->NameCache.Entries[index].RemoteAddress == 0)
+        {
+            pEntry = &Context->NameCache.Entries[index];
+        }
+    }
+
+    if (pEntry == NULL)
+    {
+        pEntry = &Context->NameCache.Entries[Context->NameCache.NextVictim];
+        Context->NameCache.NextVictim = (Context->NameCache.NextVictim + 1) % BTHPS3_NAME_CACHE_SIZE;
+    }
+
+    pEntry->RemoteAddress = RemoteAddress;
+    strcpy_s(pEntry->Name, BTH_MAX_NAME_SIZE, Name);
+
+    ExReleasePushLockExclusive(&Context->NameCache.Lock);
+    KeLeaveCriticalRegion();
+
+    FuncExit(TRACE_BTH, "status=%!STATUS!", status);
+
+    return status;
+}
+
+_IRQL_requires_max_(APC_LEVEL)
+VOID
+BthPS3_InvalidateDeviceName(
+    PBTHPS3_SERVER_CONTEXT Context,
+    BTH_ADDR RemoteAddress
+)
+{
+    KeEnterCriticalRegion();
+    ExAcquirePushLockExclusive(&Context->NameCache.Lock);
+
+    for (ULONG index = 0; index < BTHPS3_NAME_CACHE_SIZE; index++)
+    {
+        if (Context->NameCache.Entries[index].RemoteAddress == RemoteAddress)
+        {
+            Context->NameCache.Entries[index].RemoteAddress = 0;
+            break;
+        }
+    }
+
+    ExReleasePushLockExclusive(&Context->NameCache.Lock);
+    KeLeaveCriticalRegion();
+}
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
 BthPS3_GetHciVersion(
@@ -52,6 +52,52 @@
 #define BTH_DEVICE_INFO_MAX_RETRIES     UCHAR_MAX
 #define BTHPS3_MAX_NUM_DEVICES			UCHAR_MAX
 #define BTHPS3_BTH_ADDR_MAX_CHARS		13 /* 12 characters + NULL terminator */
+#define BTHPS3_CLIENTS_TABLE_BITS		9
+#define BTHPS3_CLIENTS_TABLE_SIZE		(1 << BTHPS3_CLIENTS_TABLE_BITS) /* keeps load factor below 0.5 */
+#define BTHPS3_NAME_CACHE_SIZE			32
+#define BTHPS3_SLOT_CACHE_SIZE			BTHPS3_CLIENTS_TABLE_SIZE /* shares the clients table hash */
+
+
+//
+// Child PDO slot in the open-addressed clients table
+// 
+typedef struct _BTHPS3_CLIENTS_TABLE_ENTRY
+{
+	//
+	// Remote address used as key
+	// 
+	BTH_ADDR RemoteAddress;
+
+	//
+	// Child PDO, NULL if the slot is free
+	// 
+	WDFDEVICE Device;
+
+	//
+	// TRUE while the child PDO gets unplugged, Device must not be used anymore
+	// 
+	BOOLEAN IsRemoving;
+
+} BTHPS3_CLIENTS_TABLE_ENTRY, * PBTHPS3_CLIENTS_TABLE_ENTRY;
+
+//
+// Slot assigned to a remote address, mirrors Parameters\Devices\%012llX\SlotNo
+// 
+typedef struct _BTHPS3_SLOT_CACHE_ENTRY
+{
+	//
+	// Remote address used as key, 0 if the entry is free
+	// 
+	BTH_ADDR RemoteAddress;
+
+	ULONG Slot;
+
+	//
+	// Not yet written back to the registry
+	// 
+	BOOLEAN IsDirty;
+
+} BTHPS3_SLOT_CACHE_ENTRY, * PBTHPS3_SLOT_CACHE_ENTRY;
 
 
 typedef struct _BTHPS3_DEVICE_CONTEXT_HEADER
@@ -83,30 +129,55 @@ typedef struct _BTHPS3_DEVICE_CONTEXT_HEADER
 	WDFREQUEST HostInitRequest;
 
 	//
-	// Collection of state information about 
-	// currently established connections
+	// Child PDOs of currently established connections, 
+	// open-addressed (linear probing) and keyed by remote address
 	// 
-	WDFCOLLECTION Clients;
+	BTHPS3_CLIENTS_TABLE_ENTRY Clients[BTHPS3_CLIENTS_TABLE_SIZE];
 
 	//
-	// Lock for ClientConnections collection
+	// Number of occupied slots in Clients
 	// 
-	WDFWAITLOCK ClientsLock;
+	ULONG ClientsCount;
 
 	//
-	// DMF module to handle PDO creation
+	// Reader/writer lock for Clients table
 	// 
-	DMFMODULE PdoModule;
+	EX_PUSH_LOCK ClientsLock;
 
 	//
-	// Free and occupied serial numbers
+	// DMF module to handle PDO creation
 	// 
-	UINT32 Slots[8]; // 256 usable bits
+	DMFMODULE PdoModule;
 
 	//
-	// Lock protecting Slots access
+	// Free and occupied serial numbers, modified with interlocked bit operations only
 	// 
-	WDFWAITLOCK SlotsLock;
+	volatile LONG Slots[8]; // 256 usable bits
+
+	struct
+	{
+		//
+		// Lock protecting Entries and Count
+		// 
+		EX_PUSH_LOCK Lock;
+
+		//
+		// Assigned slots by remote address, open-addressed (linear probing),
+		// loaded once on start, entries are never removed
+		// 
+		BTHPS3_SLOT_CACHE_ENTRY Entries[BTHPS3_SLOT_CACHE_SIZE];
+
+		//
+		// Number of occupied Entries, kept below BTHPS3_SLOT_CACHE_SIZE
+		// 
+		ULONG Count;
+
+		//
+		// Writes dirty entries back to the registry at low priority
+		// 
+		WDFWORKITEM WriteBackWorkItem;
+
+	} SlotCache;
 
 	//
 	// DMF module to enqueue work items
@@ -115,6 +186,84 @@ typedef struct _BTHPS3_DEVICE_CONTEXT_HEADER
 
 } BTHPS3_DEVICE_CONTEXT_HEADER, * PBTHPS3_DEVICE_CONTEXT_HEADER;
 
+//
+// Remote name resolved earlier, kept across reconnects
+// 
+typedef struct _BTHPS3_NAME_CACHE_ENTRY
+{
+	//
+	// Remote address, 0 if the entry is free
+	// 
+	BTH_ADDR RemoteAddress;
+
+	//
+	// Remote name as reported by the radio
+	// 
+	CHAR Name[BTH_MAX_NAME_SIZE];
+
+} BTHPS3_NAME_CACHE_ENTRY, * PBTHPS3_NAME_CACHE_ENTRY;
+
+//
+// Immutable snapshot of runtime properties read from registry
+// 
+typedef struct _BTHPS3_SETTINGS
+{
+	//
+	// Memory object holding this snapshot, deleted on last release
+	// 
+	WDFMEMORY Memory;
+
+	//
+	// One reference held while published plus one per consumer
+	// 
+	volatile LONG RefCount;
+
+	ULONG AutoEnableFilter;
+
+	ULONG AutoDisableFilter;
+
+	ULONG AutoEnableFilterDelay;
+
+	ULONG IsSIXAXISSupported;
+
+	ULONG IsNAVIGATIONSupported;
+
+	ULONG IsMOTIONSupported;
+
+	ULONG IsWIRELESSSupported;
+
+	//
+	// Child device exposure, read here so PDO creation stays off the registry
+	// 
+	ULONG RawPdo;
+
+	ULONG AdminOnlyPdo;
+
+	ULONG ExclusivePdo;
+
+	ULONG HidePdo;
+
+	ULONG ChildReadRingSize;
+
+	ULONG ChildCoalesceReads;
+
+	ULONG ChildLingerTimeout;
+
+	WDFCOLLECTION SIXAXISSupportedNames;
+
+	WDFCOLLECTION NAVIGATIONSupportedNames;
+
+	WDFCOLLECTION MOTIONSupportedNames;
+
+	WDFCOLLECTION WIRELESSSupportedNames;
+
+	//
+	// Supported names of all enabled device types compiled to DS_DEVICE_TYPE lookup
+	// 
+	NAME_MATCHER NameMatcher;
+
+} BTHPS3_SETTINGS, * PBTHPS3_SETTINGS;
+
 typedef struct _BTHPS3_SERVER_CONTEXT
 {
 	//
@@ -163,33 +312,107 @@ typedef struct _BTHPS3_SERVER_CONTEXT
 		// 
 		WDFREQUEST AsyncRequest;
 
+		//
+		// Lock protecting Excluded* members
+		// 
+		WDFWAITLOCK ExcludedLock;
+
+		//
+		// Unsupported remote devices the filter must not patch for
+		// 
+		BTH_ADDR ExcludedAddresses[BTHPS3PSM_MAX_SCOPE_ADDRESSES];
+
+		//
+		// KeQueryInterruptTime() value each exclusion was added at, oldest gets replaced once full
+		// 
+		ULONGLONG ExcludedSince[BTHPS3PSM_MAX_SCOPE_ADDRESSES];
+
+		//
+		// KeQueryInterruptTime() value each exclusion lapses at, 0 if it never does
+		// 
+		ULONGLONG ExcludedUntil[BTHPS3PSM_MAX_SCOPE_ADDRESSES];
+
+		ULONG ExcludedCount;
+
+		//
+		// Filter device index the exclusions were sent to
+		// 
+		ULONG ExcludedDeviceIndex;
+
+		//
+		// Delayed action to lift lapsed exclusions
+		// 
+		WDFTIMER ExclusionExpiryTimer;
+
 	} PsmFilter;
 
+	//
+	// Current settings snapshot, replaced (never modified) on registry change
+	// 
+	PBTHPS3_SETTINGS Settings;
+
+	//
+	// Lock protecting Settings pointer swaps
+	// 
+	EX_PUSH_LOCK SettingsLock;
+
 	struct
 	{
-		ULONG AutoEnableFilter;
+		//
+		// Lock protecting Entries
+		// 
+		EX_PUSH_LOCK Lock;
 
-		ULONG AutoDisableFilter;
+		//
+		// Remote names by address
+		// 
+		BTHPS3_NAME_CACHE_ENTRY Entries[BTHPS3_NAME_CACHE_SIZE];
 
-		ULONG AutoEnableFilterDelay;
+		//
+		// Next entry to replace once all are occupied
+		// 
+		ULONG NextVictim;
 
-		ULONG IsSIXAXISSupported;
+	} NameCache;
 
-		ULONG IsNAVIGATIONSupported;
+	struct
+	{
+		//
+		// Parameters key watched for changes
+		// 
+		WDFKEY Key;
 
-		ULONG IsMOTIONSupported;
+		//
+		// Queued by the configuration manager on key change
+		// 
+		WORK_QUEUE_ITEM WorkItem;
 
-		ULONG IsWIRELESSSupported;
+		//
+		// Completion status of the pending notification
+		// 
+		IO_STATUS_BLOCK IoStatus;
 
-		WDFCOLLECTION SIXAXISSupportedNames;
+		//
+		// Signaled once no more notifications are pending
+		// 
+		KEVENT StoppedEvent;
 
-		WDFCOLLECTION NAVIGATIONSupportedNames;
+		//
+		// Serializes re-arming against shutdown
+		// 
+		WDFWAITLOCK Lock;
 
-		WDFCOLLECTION MOTIONSupportedNames;
+		//
+		// TRUE if a notification was successfully requested
+		// 
+		BOOLEAN IsArmed;
 
-		WDFCOLLECTION WIRELESSSupportedNames;
+		//
+		// Set on shutdown, suppresses re-arming
+		// 
+		volatile BOOLEAN IsStopping;
 
-	} Settings;
+	} SettingsNotify;
 
 } BTHPS3_SERVER_CONTEXT, * PBTHPS3_SERVER_CONTEXT;
 
@@ -223,6 +446,8 @@ EVT_DMF_QueuedWorkItem_Callback BthPS3_EvtQueuedWorkItemHandler;
 
 EVT_WDF_TIMER BthPS3_EnablePatchEvtWdfTimer;
 
+EVT_WDF_TIMER BthPS3_ExclusionExpiryEvtWdfTimer;
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
 BthPS3_RetrieveLocalInfo(
@@ -281,6 +506,46 @@ BthPS3_SettingsContextInit(
 	PBTHPS3_SERVER_CONTEXT Context
 );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+BthPS3_SettingsCompileNames(
+	_In_ PBTHPS3_SETTINGS Settings,
+	_In_ WDFCOLLECTION Names,
+	_In_ DS_DEVICE_TYPE DeviceType
+);
+
+_IRQL_requires_max_(APC_LEVEL)
+PBTHPS3_SETTINGS
+BthPS3_SettingsAcquire(
+	_In_ PBTHPS3_SERVER_CONTEXT Context
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_SettingsRelease(
+	_In_ PBTHPS3_SETTINGS Settings
+);
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_SettingsNotifyStart(
+	_In_ PBTHPS3_SERVER_CONTEXT Context
+);
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_SettingsNotifyArm(
+	_In_ PBTHPS3_SERVER_CONTEXT Context
+);
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+BthPS3_SettingsNotifyStop(
+	_In_ PBTHPS3_SERVER_CONTEXT Context
+);
+
+WORKER_THREAD_ROUTINE BthPS3_SettingsChangedWorkItem;
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
 BthPS3_QueryInterfaces(
@@ -336,6 +601,27 @@ BthPS3_GetDeviceName(
 	PCHAR Name
 );
 
+//
+// Request remote device friendly name from cache, falls back to radio
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_GetDeviceNameCached(
+	_In_ PBTHPS3_SERVER_CONTEXT Context,
+	_In_ BTH_ADDR RemoteAddress,
+	_Out_writes_(BTH_MAX_NAME_SIZE) PCHAR Name
+);
+
+//
+// Drop a remote device name from cache
+// 
+_IRQL_requires_max_(APC_LEVEL)
+VOID
+BthPS3_InvalidateDeviceName(
+	_In_ PBTHPS3_SERVER_CONTEXT Context,
+	_In_ BTH_ADDR RemoteAddress
+);
+
 //
 // Request HCI version from radio
 // 
@@ -235,6 +235,204 @@ BthPS3_PDO_HandleHidInterruptWrite(
 	return status;
 }
 
+//
+// Handles IOCTL_BTHPS3_HID_INTERRUPT_READ_BATCH
+// 
+NTSTATUS
+BthPS3_PDO_HandleHidInterruptReadBatch(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(Queue);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(InputBuffer);
+	UNREFERENCED_PARAMETER(InputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBuffer);
+	UNREFERENCED_PARAMETER(OutputBufferSize);
+
+	FuncEntry(TRACE_BUSLOGIC);
+
+	NTSTATUS status;
+	const WDFDEVICE device = DMF_ParentDeviceGet(DmfModule);
+	const PBTHPS3_PDO_CONTEXT pPdoCtx = GetPdoContext(device);
+
+    *BytesReturned = 0;
+
+	//
+	// Reports are only buffered if the read ring is enabled
+	// 
+	if (pPdoCtx->InterruptReadRing.Size == 0)
+	{
+		status = STATUS_NOT_SUPPORTED;
+
+		FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+
+		return status;
+	}
+
+	if (!NT_SUCCESS(status = WdfRequestForwardToIoQueue(
+		Request,
+		pPdoCtx->Queues.HidInterruptReadBatchRequests
+	)))
+	{
+		TraceError(
+			TRACE_BUSLOGIC,
+			"WdfRequestForwardToIoQueue failed with status %!STATUS!",
+			status
+		);
+	}
+	else status = STATUS_PENDING;
+
+	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+
+	return status;
+}
+
+//
+// Handles IOCTL_BTHPS3_HID_INTERRUPT_SET_COALESCING
+// 
+NTSTATUS
+BthPS3_PDO_HandleHidInterruptSetCoalescing(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(Queue);
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(InputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBufferSize);
+
+	FuncEntry(TRACE_BUSLOGIC);
+
+	NTSTATUS status;
+	const WDFDEVICE device = DMF_ParentDeviceGet(DmfModule);
+	const PBTHPS3_PDO_CONTEXT pPdoCtx = GetPdoContext(device);
+	const PBTHPS3_HID_INTERRUPT_SET_COALESCING pRequest = InputBuffer;
+	const PBTHPS3_HID_INTERRUPT_SET_COALESCING pResponse = OutputBuffer;
+	const BOOLEAN isEnabled = (pRequest->IsEnabled) ? TRUE : FALSE;
+
+    *BytesReturned = 0;
+
+	if (NT_SUCCESS(status = BthPS3_PDO_InterruptReadRingSetCoalescing(
+		pPdoCtx,
+		isEnabled
+	)))
+	{
+		pResponse->IsEnabled = isEnabled;
+		pResponse->CoalescedReports = (ULONG64)InterlockedCompareExchange64(
+			&pPdoCtx->InterruptReadRing.Coalesced,
+			0,
+			0
+		);
+
+		*BytesReturned = sizeof(BTHPS3_HID_INTERRUPT_SET_COALESCING);
+	}
+
+	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+
+	return status;
+}
+
+//
+// Takes care of the parts of a request that have to run in the issuing process
+// 
+_Use_decl_annotations_
+VOID
+BthPS3_PDO_EvtIoInCallerContext(
+	WDFDEVICE Device,
+	WDFREQUEST Request
+)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+	WDF_REQUEST_PARAMETERS params;
+
+	WDF_REQUEST_PARAMETERS_INIT(&params);
+	WdfRequestGetParameters(Request, &params);
+
+	//
+	// Event handle of the mailbox consumer is only valid in its own process
+	// 
+	if (params.Type == WdfRequestTypeDeviceControl
+		&& params.Parameters.DeviceIoControl.IoControlCode == IOCTL_BTHPS3_HID_INTERRUPT_MAP_MAILBOX)
+	{
+		status = BthPS3_PDO_MailboxReferenceEvent(Request);
+	}
+
+	if (NT_SUCCESS(status))
+	{
+		status = WdfDeviceEnqueueRequest(Device, Request);
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		WdfRequestComplete(Request, status);
+	}
+}
+
+//
+// Handles IOCTL_BTHPS3_HID_INTERRUPT_MAP_MAILBOX
+// 
+NTSTATUS
+BthPS3_PDO_HandleHidInterruptMapMailbox(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(Queue);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(InputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBufferSize);
+
+	FuncEntry(TRACE_BUSLOGIC);
+
+	NTSTATUS status;
+	const WDFDEVICE device = DMF_ParentDeviceGet(DmfModule);
+	const PBTHPS3_PDO_CONTEXT pPdoCtx = GetPdoContext(device);
+
+    *BytesReturned = 0;
+
+	//
+	// Output buffer is the locked consumer memory (direct I/O), it stays
+	// valid until the request is completed on cancellation
+	// 
+	if (NT_SUCCESS(status = BthPS3_PDO_MailboxRegister(
+		pPdoCtx,
+		Request,
+		InputBuffer,
+		OutputBuffer
+	)))
+	{
+		status = STATUS_PENDING;
+	}
+
+	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+
+	return status;
+}
+
 //
 // Handles IOCTL_BTH_DISCONNECT_DEVICE requests
 // 
@@ -378,6 +576,48 @@ BthPS3_PDO_HandleBthDisconnect(
 }
 
 
+//
+// Retrieves the transfer buffer (buffered I/O) or MDL (direct I/O) of a HID request
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+BthPS3_PDO_RetrieveTransferBuffer(
+	_In_ WDFREQUEST Request,
+	_In_ BOOLEAN IsWrite,
+	_Outptr_result_maybenull_ PVOID* Buffer,
+	_Outptr_result_maybenull_ PMDL* Mdl,
+	_Out_ size_t* Length
+)
+{
+	NTSTATUS status;
+	WDF_REQUEST_PARAMETERS params;
+
+	*Buffer = NULL;
+	*Mdl = NULL;
+	*Length = 0;
+
+	WDF_REQUEST_PARAMETERS_INIT(&params);
+	WdfRequestGetParameters(Request, &params);
+
+	//
+	// Direct I/O, payload is described by the output buffer MDL in both directions
+	// and gets handed to the bus driver without an intermediate copy
+	// 
+	if (METHOD_FROM_CTL_CODE(params.Parameters.DeviceIoControl.IoControlCode) != METHOD_BUFFERED)
+	{
+		if (NT_SUCCESS(status = WdfRequestRetrieveOutputWdmMdl(Request, Mdl)))
+		{
+			*Length = params.Parameters.DeviceIoControl.OutputBufferLength;
+		}
+
+		return status;
+	}
+
+	return (IsWrite)
+		? WdfRequestRetrieveInputBuffer(Request, 0, Buffer, Length)
+		: WdfRequestRetrieveOutputBuffer(Request, 0, Buffer, Length);
+}
+
 //
 // Sends pending HID Control Read Requests through L2CAP channel to remote device
 // 
@@ -393,20 +633,22 @@ BthPS3_PDO_DispatchHidControlRead(
 	NTSTATUS status;
 	WDFREQUEST request = NULL;
 	PVOID buffer = NULL;
+	PMDL mdl = NULL;
 	size_t length = 0;
 
 	while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(Queue, &request)))
 	{
-		if (!NT_SUCCESS(status = WdfRequestRetrieveOutputBuffer(
+		if (!NT_SUCCESS(status = BthPS3_PDO_RetrieveTransferBuffer(
 			request,
-			0,
+			FALSE,
 			&buffer,
+			&mdl,
 			&length
 		)))
 		{
 			TraceError(
 				TRACE_BUSLOGIC,
-				"WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+				"BthPS3_PDO_RetrieveTransferBuffer failed with status %!STATUS!",
 				status
 			);
 
@@ -418,6 +660,7 @@ BthPS3_PDO_DispatchHidControlRead(
 			pPdoCtx,
 			request,
 			buffer,
+			mdl,
 			length,
 			L2CAP_PS3_AsyncReadControlTransferCompleted
 		)))
@@ -451,20 +694,22 @@ BthPS3_PDO_DispatchHidControlWrite(
 	NTSTATUS status;
 	WDFREQUEST request = NULL;
 	PVOID buffer = NULL;
+	PMDL mdl = NULL;
 	size_t length = 0;
 
 	while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(Queue, &request)))
 	{
-		if (!NT_SUCCESS(status = WdfRequestRetrieveInputBuffer(
+		if (!NT_SUCCESS(status = BthPS3_PDO_RetrieveTransferBuffer(
 			request,
-			0,
+			TRUE,
 			&buffer,
+			&mdl,
 			&length
 		)))
 		{
 			TraceError(
 				TRACE_BUSLOGIC,
-				"WdfRequestRetrieveInputBuffer failed with status %!STATUS!",
+				"BthPS3_PDO_RetrieveTransferBuffer failed with status %!STATUS!",
 				status
 			);
 
@@ -476,6 +721,7 @@ BthPS3_PDO_DispatchHidControlWrite(
 			pPdoCtx,
 			request,
 			buffer,
+			mdl,
 			length,
 			L2CAP_PS3_AsyncSendControlTransferCompleted
 		)))
@@ -509,20 +755,33 @@ BthPS3_PDO_DispatchHidInterruptRead(
 	NTSTATUS status;
 	WDFREQUEST request = NULL;
 	PVOID buffer = NULL;
+	PMDL mdl = NULL;
 	size_t length = 0;
 
+	//
+	// Reads are already in flight, serve from the ring buffer
+	// 
+	if (pPdoCtx->InterruptReadRing.Size > 0)
+	{
+		BthPS3_PDO_InterruptReadRingDrain(pPdoCtx);
+
+		FuncExitNoReturn(TRACE_BUSLOGIC);
+		return;
+	}
+
 	while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(Queue, &request)))
 	{
-		if (!NT_SUCCESS(status = WdfRequestRetrieveOutputBuffer(
+		if (!NT_SUCCESS(status = BthPS3_PDO_RetrieveTransferBuffer(
 			request,
-			0,
+			FALSE,
 			&buffer,
+			&mdl,
 			&length
 		)))
 		{
 			TraceError(
 				TRACE_BUSLOGIC,
-				"WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+				"BthPS3_PDO_RetrieveTransferBuffer failed with status %!STATUS!",
 				status
 			);
 
@@ -534,6 +793,7 @@ BthPS3_PDO_DispatchHidInterruptRead(
 			pPdoCtx,
 			request,
 			buffer,
+			mdl,
 			length,
 			L2CAP_PS3_AsyncReadInterruptTransferCompleted
 		)))
@@ -567,20 +827,22 @@ BthPS3_PDO_DispatchHidInterruptWrite(
 	NTSTATUS status;
 	WDFREQUEST request = NULL;
 	PVOID buffer = NULL;
+	PMDL mdl = NULL;
 	size_t length = 0;
 
 	while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(Queue, &request)))
 	{
-		if (!NT_SUCCESS(status = WdfRequestRetrieveInputBuffer(
+		if (!NT_SUCCESS(status = BthPS3_PDO_RetrieveTransferBuffer(
 			request,
-			0,
+			TRUE,
 			&buffer,
+			&mdl,
 			&length
 		)))
 		{
 			TraceError(
 				TRACE_BUSLOGIC,
-				"WdfRequestRetrieveInputBuffer failed with status %!STATUS!",
+				"BthPS3_PDO_RetrieveTransferBuffer failed with status %!STATUS!",
 				status
 			);
 
@@ -592,6 +854,7 @@ BthPS3_PDO_DispatchHidInterruptWrite(
 			pPdoCtx,
 			request,
 			buffer,
+			mdl,
 			length,
 			L2CAP_PS3_AsyncSendInterruptTransferCompleted
 		)))
@@ -609,3 +872,23 @@ BthPS3_PDO_DispatchHidInterruptWrite(
 
 	FuncExitNoReturn(TRACE_BUSLOGIC);
 }
+
+//
+// Completes pending HID Interrupt batch read requests from the ring buffer
+// 
+VOID
+BthPS3_PDO_DispatchHidInterruptReadBatch(
+	_In_ WDFQUEUE Queue,
+	_In_ WDFCONTEXT Context
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	UNREFERENCED_PARAMETER(Queue);
+
+	const PBTHPS3_PDO_CONTEXT pPdoCtx = Context;
+
+	BthPS3_PDO_InterruptReadRingDrain(pPdoCtx);
+
+	FuncExitNoReturn(TRACE_BUSLOGIC);
+}
@@ -0,0 +1,421 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3 - Windows kernel-mode Bluetooth profile and bus driver                  *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#include "Driver.h"
+#include "BusLogic.Mailbox.tmh"
+
+
+//
+// Prepares the (initially unregistered) report mailbox
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_MailboxInit(
+	_In_ WDFDEVICE Device,
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	const PBTHPS3_REPORT_MAILBOX pMailbox = &PdoContext->Mailbox;
+
+	pMailbox->Shared = NULL;
+	pMailbox->Event = NULL;
+	pMailbox->Request = NULL;
+	pMailbox->FileObject = NULL;
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = Device;
+
+	if (!NT_SUCCESS(status = WdfSpinLockCreate(
+		&attributes,
+		&pMailbox->Lock
+	)))
+	{
+		TraceError(
+			TRACE_BUSLOGIC,
+			"WdfSpinLockCreate (Mailbox) failed with status %!STATUS!",
+			status
+		);
+	}
+
+	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+
+	return status;
+}
+
+//
+// Detaches the mailbox from the registration request, if any (and matching 
+// the optional request or file object)
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+WDFREQUEST
+BthPS3_PDO_MailboxDetach(
+	_In_ PBTHPS3_REPORT_MAILBOX Mailbox,
+	_In_opt_ WDFREQUEST Request,
+	_In_opt_ WDFFILEOBJECT FileObject,
+	_Outptr_result_maybenull_ PKEVENT* Event
+)
+{
+	WDFREQUEST request = NULL;
+
+	*Event = NULL;
+
+	WdfSpinLockAcquire(Mailbox->Lock);
+
+	if (Mailbox->Request != NULL
+		&& (Request == NULL || Mailbox->Request == Request)
+		&& (FileObject == NULL || Mailbox->FileObject == FileObject))
+	{
+		request = Mailbox->Request;
+		*Event = Mailbox->Event;
+
+		Mailbox->Shared = NULL;
+		Mailbox->Event = NULL;
+		Mailbox->Request = NULL;
+		Mailbox->FileObject = NULL;
+	}
+
+	WdfSpinLockRelease(Mailbox->Lock);
+
+	return request;
+}
+
+//
+// Completes the registration request, optionally only if issued on the given handle
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_MailboxRelease(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_opt_ WDFFILEOBJECT FileObject,
+	_In_ NTSTATUS Status
+)
+{
+	FuncEntryArguments(TRACE_BUSLOGIC, "Status=%!STATUS!", Status);
+
+	PKEVENT event = NULL;
+	const WDFREQUEST request = BthPS3_PDO_MailboxDetach(
+		&PdoContext->Mailbox,
+		NULL,
+		FileObject,
+		&event
+	);
+
+	if (event != NULL)
+	{
+		ObDereferenceObject(event);
+	}
+
+	//
+	// Cancel routine owns the request if it is already running
+	// 
+	if (request != NULL && NT_SUCCESS(WdfRequestUnmarkCancelable(request)))
+	{
+		WdfRequestComplete(request, Status);
+	}
+
+	FuncExitNoReturn(TRACE_BUSLOGIC);
+}
+
+//
+// Registration request got cancelled (process terminated, device removed)
+// 
+VOID
+BthPS3_PDO_MailboxRequestCancel(
+	_In_ WDFREQUEST Request
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	const WDFDEVICE device = WdfIoQueueGetDevice(WdfRequestGetIoQueue(Request));
+	const PBTHPS3_PDO_CONTEXT pPdoCtx = GetPdoContext(device);
+	PKEVENT event = NULL;
+
+	(void)BthPS3_PDO_MailboxDetach(&pPdoCtx->Mailbox, Request, NULL, &event);
+
+	if (event != NULL)
+	{
+		ObDereferenceObject(event);
+	}
+
+	WdfRequestComplete(Request, STATUS_CANCELLED);
+
+	FuncExitNoReturn(TRACE_BUSLOGIC);
+}
+
+//
+// Drops the event reference if the request never got registered
+// 
+VOID
+BthPS3_PDO_MailboxRequestContextCleanup(
+	_In_ WDFOBJECT Object
+)
+{
+	const PBTHPS3_MAILBOX_REQUEST_CONTEXT pReqCtx = GetMailboxRequestContext(Object);
+
+	if (pReqCtx->Event != NULL)
+	{
+		ObDereferenceObject(pReqCtx->Event);
+		pReqCtx->Event = NULL;
+	}
+}
+
+//
+// Runs in the context of the issuing process, references the optional event handle
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_MailboxReferenceEvent(
+	_In_ WDFREQUEST Request
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	PBTHPS3_HID_INTERRUPT_MAP_MAILBOX pParameters = NULL;
+	PBTHPS3_MAILBOX_REQUEST_CONTEXT pReqCtx = NULL;
+
+	do
+	{
+		if (!NT_SUCCESS(status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(BTHPS3_HID_INTERRUPT_MAP_MAILBOX),
+			(PVOID*)&pParameters,
+			NULL
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"WdfRequestRetrieveInputBuffer failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
+		if (pParameters->EventHandle == 0)
+		{
+			break;
+		}
+
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, BTHPS3_MAILBOX_REQUEST_CONTEXT);
+		attributes.EvtCleanupCallback = BthPS3_PDO_MailboxRequestContextCleanup;
+
+		if (!NT_SUCCESS(status = WdfObjectAllocateContext(
+			Request,
+			&attributes,
+			(PVOID*)&pReqCtx
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"WdfObjectAllocateContext failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
+		if (!NT_SUCCESS(status = ObReferenceObjectByHandle(
+			(HANDLE)(ULONG_PTR)pParameters->EventHandle,
+			EVENT_MODIFY_STATE,
+			*ExEventObjectType,
+			WdfRequestGetRequestorMode(Request),
+			(PVOID*)&pReqCtx->Event,
+			NULL
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"ObReferenceObjectByHandle failed with status %!STATUS!",
+				status
+			);
+
+			pReqCtx->Event = NULL;
+			break;
+		}
+
+	} while (FALSE);
+
+	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+
+	return status;
+}
+
+//
+// Attaches the output buffer of a pending request as report mailbox
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_MailboxRegister(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ WDFREQUEST Request,
+	_In_ PBTHPS3_HID_INTERRUPT_MAP_MAILBOX Parameters,
+	_In_ PBTHPS3_HID_INPUT_REPORT_MAILBOX Shared
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	NTSTATUS status = STATUS_SUCCESS;
+	const PBTHPS3_REPORT_MAILBOX pMailbox = &PdoContext->Mailbox;
+	const PBTHPS3_MAILBOX_REQUEST_CONTEXT pReqCtx = GetMailboxRequestContext(Request);
+	PKEVENT event = (pReqCtx != NULL) ? pReqCtx->Event : NULL;
+	BOOLEAN isBusy;
+
+	do
+	{
+		//
+		// Handle got referenced by BthPS3_PDO_EvtIoInCallerContext, missing if it failed
+		// 
+		if (Parameters->EventHandle != 0 && event == NULL)
+		{
+			status = STATUS_INVALID_DEVICE_STATE;
+			break;
+		}
+
+		RtlZeroMemory(Shared, sizeof(BTHPS3_HID_INPUT_REPORT_MAILBOX));
+
+		WdfSpinLockAcquire(pMailbox->Lock);
+
+		isBusy = (pMailbox->Request != NULL);
+
+		if (!isBusy)
+		{
+			pMailbox->Shared = Shared;
+			pMailbox->Event = event;
+			pMailbox->Request = Request;
+			pMailbox->FileObject = WdfRequestGetFileObject(Request);
+		}
+
+		WdfSpinLockRelease(pMailbox->Lock);
+
+		//
+		// Only one consumer at a time
+		// 
+		if (isBusy)
+		{
+			status = STATUS_DEVICE_BUSY;
+			break;
+		}
+
+		//
+		// Mailbox owns the event reference now
+		// 
+		if (pReqCtx != NULL)
+		{
+			pReqCtx->Event = NULL;
+		}
+
+		if (!NT_SUCCESS(status = WdfRequestMarkCancelableEx(
+			Request,
+			BthPS3_PDO_MailboxRequestCancel
+		)))
+		{
+			//
+			// Already cancelled, undo registration
+			// 
+			(void)BthPS3_PDO_MailboxDetach(pMailbox, Request, NULL, &event);
+
+			if (event != NULL)
+			{
+				ObDereferenceObject(event);
+			}
+			break;
+		}
+
+	} while (FALSE);
+
+	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+
+	return status;
+}
+
+//
+// Publishes the latest input report to the registered mailbox
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_MailboxPublish(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ LARGE_INTEGER Timestamp,
+	_In_reads_bytes_(Length) PVOID Buffer,
+	_In_ ULONG Length
+)
+{
+	const PBTHPS3_REPORT_MAILBOX pMailbox = &PdoContext->Mailbox;
+
+	//
+	// Cheap check without lock, nobody listening
+	// 
+	if (pMailbox->Shared == NULL)
+	{
+		return;
+	}
+
+	//
+	// Lock also serializes writers of the sequence lock
+	// 
+	WdfSpinLockAcquire(pMailbox->Lock);
+
+	const PBTHPS3_HID_INPUT_REPORT_MAILBOX pShared = pMailbox->Shared;
+
+	if (pShared != NULL)
+	{
+		Length = min(Length, sizeof(pShared->Data));
+
+		//
+		// Odd value signals an update in progress to readers
+		// 
+		InterlockedIncrement(&pShared->SeqLock);
+
+		pShared->Timestamp = Timestamp;
+		pShared->Length = Length;
+		RtlCopyMemory(pShared->Data, Buffer, Length);
+		pShared->Sequence++;
+
+		InterlockedIncrement(&pShared->SeqLock);
+
+		if (pMailbox->Event != NULL)
+		{
+			KeSetEvent(pMailbox->Event, IO_NO_INCREMENT, FALSE);
+		}
+	}
+
+	WdfSpinLockRelease(pMailbox->Lock);
+}
@@ -0,0 +1,223 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3 - Windows kernel-mode Bluetooth profile and bus driver                  *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#include "Driver.h"
+#include "BusLogic.Pool.tmh"
+
+
+//
+// Pre-allocates the ACL transfer BRBs used by the HID channels of this PDO
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_BrbPoolInit(
+	_In_ WDFDEVICE Device,
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	const PBTHPS3_BRB_POOL pPool = &PdoContext->BrbPool;
+	//
+	// The PDO context header isn't assigned yet, fetch the interface from the parent
+	// 
+	const PBTHPS3_SERVER_CONTEXT pSrvCtx = GetServerDeviceContext(WdfPdoGetParent(Device));
+
+	pPool->ProfileDrvInterface = &pSrvCtx->Header.ProfileDrvInterface;
+	pPool->Count = 0;
+	pPool->Hits = 0;
+	pPool->Misses = 0;
+
+	do
+	{
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = Device;
+
+		if (!NT_SUCCESS(status = WdfSpinLockCreate(
+			&attributes,
+			&pPool->Lock
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"WdfSpinLockCreate (BrbPool) failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
+		for (ULONG index = 0; index < BTHPS3_PDO_BRB_POOL_SIZE; index++)
+		{
+			struct _BRB_L2CA_ACL_TRANSFER* brb = (struct _BRB_L2CA_ACL_TRANSFER*)
+				pPool->ProfileDrvInterface->BthAllocateBrb(
+					BRB_L2CA_ACL_TRANSFER,
+					POOLTAG_BTHPS3
+				);
+
+			//
+			// Not fatal, transfers will fall back to allocating on demand
+			// 
+			if (brb == NULL)
+			{
+				TraceError(
+					TRACE_BUSLOGIC,
+					"BthAllocateBrb failed, pool holds %d of %d entries",
+					pPool->Count,
+					BTHPS3_PDO_BRB_POOL_SIZE
+				);
+				break;
+			}
+
+			pPool->Entries[pPool->Count++] = brb;
+		}
+
+	} while (FALSE);
+
+	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+
+	return status;
+}
+
+//
+// Takes a BRB from the pool or allocates a new one if the pool ran dry
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+struct _BRB_L2CA_ACL_TRANSFER*
+BthPS3_PDO_BrbPoolAcquire(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	const PBTHPS3_BRB_POOL pPool = &PdoContext->BrbPool;
+	struct _BRB_L2CA_ACL_TRANSFER* brb = NULL;
+
+	WdfSpinLockAcquire(pPool->Lock);
+
+	if (pPool->Count > 0)
+	{
+		brb = pPool->Entries[--pPool->Count];
+	}
+
+	WdfSpinLockRelease(pPool->Lock);
+
+	if (brb != NULL)
+	{
+		InterlockedIncrement64(&pPool->Hits);
+
+		pPool->ProfileDrvInterface->BthReuseBrb(
+			(PBRB)brb,
+			BRB_L2CA_ACL_TRANSFER
+		);
+
+		return brb;
+	}
+
+	InterlockedIncrement64(&pPool->Misses);
+
+	return (struct _BRB_L2CA_ACL_TRANSFER*)
+		pPool->ProfileDrvInterface->BthAllocateBrb(
+			BRB_L2CA_ACL_TRANSFER,
+			POOLTAG_BTHPS3
+		);
+}
+
+//
+// Returns a BRB to the pool or frees it if the pool is full
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_BrbPoolRelease(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ struct _BRB_L2CA_ACL_TRANSFER* Brb
+)
+{
+	const PBTHPS3_BRB_POOL pPool = &PdoContext->BrbPool;
+	BOOLEAN pooled = FALSE;
+
+	WdfSpinLockAcquire(pPool->Lock);
+
+	if (pPool->Count < BTHPS3_PDO_BRB_POOL_SIZE)
+	{
+		pPool->Entries[pPool->Count++] = Brb;
+		pooled = TRUE;
+	}
+
+	WdfSpinLockRelease(pPool->Lock);
+
+	if (!pooled)
+	{
+		pPool->ProfileDrvInterface->BthFreeBrb((PBRB)Brb);
+	}
+}
+
+//
+// Frees all pooled BRBs
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+BthPS3_PDO_BrbPoolFree(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	const PBTHPS3_BRB_POOL pPool = &PdoContext->BrbPool;
+
+	//
+	// Pool was never initialized
+	// 
+	if (pPool->ProfileDrvInterface == NULL)
+	{
+		FuncExitNoReturn(TRACE_BUSLOGIC);
+		return;
+	}
+
+	TraceInformation(
+		TRACE_BUSLOGIC,
+		"BRB pool statistics - hits: %lld, misses: %lld",
+		pPool->Hits,
+		pPool->Misses
+	);
+
+	while (pPool->Count > 0)
+	{
+		pPool->ProfileDrvInterface->BthFreeBrb((PBRB)pPool->Entries[--pPool->Count]);
+	}
+
+	FuncExitNoReturn(TRACE_BUSLOGIC);
+}
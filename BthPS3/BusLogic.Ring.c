@@ -0,0 +1,725 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3 - Windows kernel-mode Bluetooth profile and bus driver                  *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#include "Driver.h"
+#include "BusLogic.Ring.tmh"
+
+
+
+//
+// Submits a driver-owned HID Interrupt read request
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+BthPS3_PDO_InterruptReadRingSubmit(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ WDFREQUEST Request
+)
+{
+	NTSTATUS status;
+	const PBTHPS3_INTERRUPT_READ_RING pRing = &PdoContext->InterruptReadRing;
+	const PBTHPS3_RING_READ_CONTEXT pReadCtx = GetRingReadContext(Request);
+	const WDFIOTARGET ioTarget = PdoContext->DevCtxHdr->IoTarget;
+
+	CLIENT_CONNECTION_REQUEST_REUSE(Request);
+
+	//
+	// BRB is embedded in the request context, no allocation required
+	// 
+	PdoContext->DevCtxHdr->ProfileDrvInterface.BthInitializeBrb(
+		(PBRB)&pReadCtx->Brb,
+		BRB_L2CA_ACL_TRANSFER
+	);
+
+	pReadCtx->Brb.BtAddress = PdoContext->RemoteAddress;
+	pReadCtx->Brb.ChannelHandle = PdoContext->HidInterruptChannel.ChannelHandle;
+	pReadCtx->Brb.TransferFlags = ACL_TRANSFER_DIRECTION_IN | ACL_SHORT_TRANSFER_OK;
+	pReadCtx->Brb.BufferMDL = NULL;
+	pReadCtx->Brb.Buffer = pReadCtx->Buffer;
+	pReadCtx->Brb.BufferSize = sizeof(pReadCtx->Buffer);
+
+	if (!NT_SUCCESS(status = WdfIoTargetFormatRequestForInternalIoctlOthers(
+		ioTarget,
+		Request,
+		IOCTL_INTERNAL_BTH_SUBMIT_BRB,
+		pReadCtx->BrbMemory,
+		NULL, //OtherArg1Offset
+		NULL, //OtherArg2
+		NULL, //OtherArg2Offset
+		NULL, //OtherArg4
+		NULL  //OtherArg4Offset
+	)))
+	{
+		TraceError(
+			TRACE_BUSLOGIC,
+			"WdfIoTargetFormatRequestForInternalIoctlOthers failed with status %!STATUS!",
+			status
+		);
+
+		return status;
+	}
+
+	WdfRequestSetCompletionRoutine(
+		Request,
+		BthPS3_PDO_InterruptReadRingCompleted,
+		pReadCtx
+	);
+
+	if (InterlockedIncrement(&pRing->Outstanding) == 1)
+	{
+		KeClearEvent(&pRing->IdleEvent);
+	}
+
+	if (WdfRequestSend(
+		Request,
+		ioTarget,
+		WDF_NO_SEND_OPTIONS
+	) == FALSE)
+	{
+		status = WdfRequestGetStatus(Request);
+
+		TraceError(
+			TRACE_BUSLOGIC,
+			"WdfRequestSend failed with status %!STATUS!",
+			status
+		);
+
+		if (InterlockedDecrement(&pRing->Outstanding) == 0)
+		{
+			KeSetEvent(&pRing->IdleEvent, IO_NO_INCREMENT, FALSE);
+		}
+	}
+
+	return status;
+}
+
+//
+// Allocates ring slots and driver-owned read requests
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_InterruptReadRingInit(
+	_In_ WDFDEVICE Device,
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ ULONG Size
+)
+{
+	FuncEntryArguments(TRACE_BUSLOGIC, "Size=%d", Size);
+
+	NTSTATUS status = STATUS_SUCCESS;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	WDFMEMORY memory;
+	const PBTHPS3_INTERRUPT_READ_RING pRing = &PdoContext->InterruptReadRing;
+	//
+	// The PDO context header isn't assigned yet, fetch the I/O target from the parent
+	// 
+	const PBTHPS3_SERVER_CONTEXT pSrvCtx = GetServerDeviceContext(WdfPdoGetParent(Device));
+
+	pRing->Size = 0;
+	pRing->Head = 0;
+	pRing->Count = 0;
+	pRing->Outstanding = 0;
+	pRing->IsStopping = FALSE;
+	pRing->ConsecutiveErrors = 0;
+	pRing->Overruns = 0;
+	pRing->IsCoalescing = FALSE;
+	pRing->Coalesced = 0;
+
+	KeInitializeEvent(&pRing->IdleEvent, NotificationEvent, TRUE);
+
+	//
+	// Feature disabled
+	// 
+	if (Size == 0)
+	{
+		FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+		return status;
+	}
+
+	if (Size > BTHPS3_PDO_READ_RING_MAX_SIZE)
+	{
+		Size = BTHPS3_PDO_READ_RING_MAX_SIZE;
+	}
+
+	do
+	{
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = Device;
+
+		if (!NT_SUCCESS(status = WdfSpinLockCreate(
+			&attributes,
+			&pRing->Lock
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"WdfSpinLockCreate (InterruptReadRing) failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
+		if (!NT_SUCCESS(status = WdfMemoryCreate(
+			&attributes,
+			NonPagedPoolNx,
+			POOLTAG_BTHPS3,
+			sizeof(BTHPS3_HID_INPUT_REPORT_SLOT) * Size,
+			&memory,
+			(PVOID*)&pRing->Slots
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"WdfMemoryCreate (Slots) failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
+		if (!NT_SUCCESS(status = WdfMemoryCreate(
+			&attributes,
+			NonPagedPoolNx,
+			POOLTAG_BTHPS3,
+			sizeof(WDFREQUEST) * Size,
+			&memory,
+			(PVOID*)&pRing->Requests
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"WdfMemoryCreate (Requests) failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
+		for (ULONG index = 0; index < Size; index++)
+		{
+			WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, BTHPS3_RING_READ_CONTEXT);
+			attributes.ParentObject = Device;
+
+			if (!NT_SUCCESS(status = WdfRequestCreate(
+				&attributes,
+				pSrvCtx->Header.IoTarget,
+				&pRing->Requests[index]
+			)))
+			{
+				TraceError(
+					TRACE_BUSLOGIC,
+					"WdfRequestCreate failed with status %!STATUS!",
+					status
+				);
+				break;
+			}
+
+			const PBTHPS3_RING_READ_CONTEXT pReadCtx = GetRingReadContext(pRing->Requests[index]);
+
+			pReadCtx->PdoContext = PdoContext;
+
+			WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+			attributes.ParentObject = pRing->Requests[index];
+
+			//
+			// Wrap the embedded BRB once so it doesn't get re-created per transfer
+			// 
+			if (!NT_SUCCESS(status = WdfMemoryCreatePreallocated(
+				&attributes,
+				&pReadCtx->Brb,
+				sizeof(pReadCtx->Brb),
+				&pReadCtx->BrbMemory
+			)))
+			{
+				TraceError(
+					TRACE_BUSLOGIC,
+					"WdfMemoryCreatePreallocated failed with status %!STATUS!",
+					status
+				);
+				break;
+			}
+		}
+
+		if (!NT_SUCCESS(status))
+		{
+			break;
+		}
+
+		pRing->Size = Size;
+
+	} while (FALSE);
+
+	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+
+	return status;
+}
+
+//
+// Puts all driver-owned reads in flight once the HID Interrupt channel is up
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_InterruptReadRingStart(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	NTSTATUS status;
+	const PBTHPS3_INTERRUPT_READ_RING pRing = &PdoContext->InterruptReadRing;
+
+	for (ULONG index = 0; index < pRing->Size; index++)
+	{
+		if (!NT_SUCCESS(status = BthPS3_PDO_InterruptReadRingSubmit(
+			PdoContext,
+			pRing->Requests[index]
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"BthPS3_PDO_InterruptReadRingSubmit failed with status %!STATUS!",
+				status
+			);
+		}
+	}
+
+	FuncExitNoReturn(TRACE_BUSLOGIC);
+}
+
+//
+// Cancels all driver-owned reads and waits for them to return
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+BthPS3_PDO_InterruptReadRingStop(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	NTSTATUS status;
+	const PBTHPS3_INTERRUPT_READ_RING pRing = &PdoContext->InterruptReadRing;
+	LARGE_INTEGER timeout;
+	timeout.QuadPart = WDF_REL_TIMEOUT_IN_SEC(5);
+
+	if (pRing->Size == 0)
+	{
+		FuncExitNoReturn(TRACE_BUSLOGIC);
+		return;
+	}
+
+	InterlockedExchange(&pRing->IsStopping, TRUE);
+
+	for (ULONG index = 0; index < pRing->Size; index++)
+	{
+		(void)WdfRequestCancelSentRequest(pRing->Requests[index]);
+	}
+
+	//
+	// STATUS_TIMEOUT is a success code; reads still pending afterwards keep the 
+	// ring non-idle, which BthPS3_PDO_InterruptReadRingIsIdle reports to reattach
+	// 
+	status = KeWaitForSingleObject(
+		&pRing->IdleEvent,
+		Executive,
+		KernelMode,
+		FALSE,
+		&timeout
+	);
+
+	if (status != STATUS_SUCCESS)
+	{
+		TraceError(
+			TRACE_BUSLOGIC,
+			"Waiting for %d outstanding reads failed with status %!STATUS!",
+			InterlockedCompareExchange(&pRing->Outstanding, 0, 0),
+			status
+		);
+	}
+
+	TraceInformation(
+		TRACE_BUSLOGIC,
+		"Interrupt read ring statistics - overruns: %lld, coalesced: %lld",
+		pRing->Overruns,
+		pRing->Coalesced
+	);
+
+	FuncExitNoReturn(TRACE_BUSLOGIC);
+}
+
+//
+// TRUE if no driver-owned read is in flight, i.e. all of them may be (re-)submitted
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+BthPS3_PDO_InterruptReadRingIsIdle(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	return InterlockedCompareExchange(&PdoContext->InterruptReadRing.Outstanding, 0, 0) == 0;
+}
+
+//
+// Discards reports of a previous connection and allows re-submission after a stop
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_InterruptReadRingReset(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	const PBTHPS3_INTERRUPT_READ_RING pRing = &PdoContext->InterruptReadRing;
+
+	if (pRing->Size == 0)
+	{
+		return;
+	}
+
+	WdfSpinLockAcquire(pRing->Lock);
+
+	pRing->Head = 0;
+	pRing->Count = 0;
+
+	WdfSpinLockRelease(pRing->Lock);
+
+	InterlockedExchange(&pRing->ConsecutiveErrors, 0);
+	InterlockedExchange(&pRing->IsStopping, FALSE);
+}
+
+//
+// Completes one pending HID Interrupt read request with the oldest buffered report, 
+// returns FALSE if there was no request or no report
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static BOOLEAN
+BthPS3_PDO_InterruptReadRingServeRead(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	NTSTATUS status;
+	const PBTHPS3_INTERRUPT_READ_RING pRing = &PdoContext->InterruptReadRing;
+	BTHPS3_HID_INPUT_REPORT_SLOT report;
+	WDFREQUEST request = NULL;
+	PVOID buffer = NULL;
+	size_t length = 0;
+
+	WdfSpinLockAcquire(pRing->Lock);
+
+	//
+	// Only dequeue a request if there's a report to satisfy it with
+	// 
+	if (pRing->Count > 0 && NT_SUCCESS(WdfIoQueueRetrieveNextRequest(
+		PdoContext->Queues.HidInterruptReadRequests,
+		&request
+	)))
+	{
+		RtlCopyMemory(&report, &pRing->Slots[pRing->Head], sizeof(report));
+
+		pRing->Head = (pRing->Head + 1) % pRing->Size;
+		pRing->Count--;
+	}
+
+	WdfSpinLockRelease(pRing->Lock);
+
+	if (request == NULL)
+	{
+		return FALSE;
+	}
+
+	if (!NT_SUCCESS(status = WdfRequestRetrieveOutputBuffer(
+		request,
+		0,
+		&buffer,
+		&length
+	)))
+	{
+		TraceError(
+			TRACE_BUSLOGIC,
+			"WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+			status
+		);
+
+		WdfRequestComplete(request, status);
+		return TRUE;
+	}
+
+	length = min(length, report.Length);
+
+	RtlCopyMemory(buffer, report.Data, length);
+
+	WdfRequestCompleteWithInformation(request, STATUS_SUCCESS, length);
+
+	return TRUE;
+}
+
+//
+// Completes one pending HID Interrupt batch read request with as many buffered 
+// reports as fit, returns FALSE if there was no request or no report
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static BOOLEAN
+BthPS3_PDO_InterruptReadRingServeBatch(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	NTSTATUS status;
+	const PBTHPS3_INTERRUPT_READ_RING pRing = &PdoContext->InterruptReadRing;
+	WDFREQUEST request = NULL;
+	PVOID buffer = NULL;
+	size_t bufferLength = 0;
+	size_t length = 0;
+
+	WdfSpinLockAcquire(pRing->Lock);
+
+	if (pRing->Count > 0 && NT_SUCCESS(WdfIoQueueRetrieveNextRequest(
+		PdoContext->Queues.HidInterruptReadBatchRequests,
+		&request
+	)))
+	{
+		//
+		// Minimum buffer size is enforced by the IOCTL handler
+		// 
+		if (!NT_SUCCESS(status = WdfRequestRetrieveOutputBuffer(
+			request,
+			0,
+			&buffer,
+			&bufferLength
+		)))
+		{
+			WdfSpinLockRelease(pRing->Lock);
+
+			TraceError(
+				TRACE_BUSLOGIC,
+				"WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+				status
+			);
+
+			WdfRequestComplete(request, status);
+			return TRUE;
+		}
+
+		//
+		// Copy as many reports as fit, each prefixed with a header
+		// 
+		while (pRing->Count > 0)
+		{
+			const PBTHPS3_HID_INPUT_REPORT_SLOT pSlot = &pRing->Slots[pRing->Head];
+			const size_t recordLength = sizeof(BTHPS3_HID_INPUT_REPORT_HEADER) + pSlot->Length;
+
+			if (length + recordLength > bufferLength)
+			{
+				break;
+			}
+
+			const PBTHPS3_HID_INPUT_REPORT_HEADER pHeader =
+				(PBTHPS3_HID_INPUT_REPORT_HEADER)((PUCHAR)buffer + length);
+
+			pHeader->Length = pSlot->Length;
+			pHeader->Timestamp = pSlot->Timestamp;
+			RtlCopyMemory((PUCHAR)(pHeader + 1), pSlot->Data, pSlot->Length);
+
+			length += recordLength;
+
+			pRing->Head = (pRing->Head + 1) % pRing->Size;
+			pRing->Count--;
+		}
+	}
+
+	WdfSpinLockRelease(pRing->Lock);
+
+	if (request == NULL)
+	{
+		return FALSE;
+	}
+
+	WdfRequestCompleteWithInformation(request, STATUS_SUCCESS, length);
+
+	return TRUE;
+}
+
+//
+// Completes pending HID Interrupt (batch) read requests with buffered reports
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_InterruptReadRingDrain(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	//
+	// Take turns so a busy single-report reader can't starve batch readers 
+	// and vice versa, each pending request gets reports while there are any
+	// 
+	for (;;)
+	{
+		const BOOLEAN isReadServed = BthPS3_PDO_InterruptReadRingServeRead(PdoContext);
+		const BOOLEAN isBatchServed = BthPS3_PDO_InterruptReadRingServeBatch(PdoContext);
+
+		if (!isReadServed && !isBatchServed)
+		{
+			break;
+		}
+	}
+}
+
+//
+// Driver-owned HID Interrupt read has been completed
+// 
+void
+BthPS3_PDO_InterruptReadRingCompleted(
+	_In_ WDFREQUEST Request,
+	_In_ WDFIOTARGET Target,
+	_In_ PWDF_REQUEST_COMPLETION_PARAMS Params,
+	_In_ WDFCONTEXT Context
+)
+{
+	const PBTHPS3_RING_READ_CONTEXT pReadCtx = Context;
+	const PBTHPS3_PDO_CONTEXT pPdoCtx = pReadCtx->PdoContext;
+	const PBTHPS3_INTERRUPT_READ_RING pRing = &pPdoCtx->InterruptReadRing;
+	const NTSTATUS status = Params->IoStatus.Status;
+
+	const LARGE_INTEGER timestamp = KeQueryPerformanceCounter(NULL);
+
+	UNREFERENCED_PARAMETER(Target);
+
+	TraceVerbose(
+		TRACE_BUSLOGIC,
+		"Ring read transfer request completed with status %!STATUS!",
+		status
+	);
+
+	if (NT_SUCCESS(status))
+	{
+		WdfSpinLockAcquire(pRing->Lock);
+
+		//
+		// Only the latest report is of interest, replace the pending one
+		// 
+		if (pRing->IsCoalescing && pRing->Count > 0)
+		{
+			pRing->Head = (pRing->Head + pRing->Count - 1) % pRing->Size;
+			pRing->Coalesced += pRing->Count;
+			pRing->Count = 0;
+		}
+
+		//
+		// Ring full, oldest report gets overwritten
+		// 
+		if (pRing->Count == pRing->Size)
+		{
+			pRing->Head = (pRing->Head + 1) % pRing->Size;
+			pRing->Count--;
+			pRing->Overruns++;
+		}
+
+		const PBTHPS3_HID_INPUT_REPORT_SLOT pSlot =
+			&pRing->Slots[(pRing->Head + pRing->Count) % pRing->Size];
+
+		pSlot->Timestamp = timestamp;
+		pSlot->Length = min(pReadCtx->Brb.BufferSize, sizeof(pSlot->Data));
+		RtlCopyMemory(pSlot->Data, pReadCtx->Buffer, pSlot->Length);
+
+		pRing->Count++;
+
+		WdfSpinLockRelease(pRing->Lock);
+
+		BthPS3_PDO_MailboxPublish(
+			pPdoCtx,
+			timestamp,
+			pReadCtx->Buffer,
+			pReadCtx->Brb.BufferSize
+		);
+
+		BthPS3_PDO_InterruptReadRingDrain(pPdoCtx);
+
+		InterlockedExchange(&pRing->ConsecutiveErrors, 0);
+	}
+
+	//
+	// Keep the read in flight, unless cancelled, the channel is gone or it keeps failing
+	// 
+	if (!InterlockedCompareExchange(&pRing->IsStopping, FALSE, FALSE)
+		&& status != STATUS_CANCELLED
+		&& pPdoCtx->HidInterruptChannel.ConnectionState == ConnectionStateConnected
+		&& (NT_SUCCESS(status)
+			|| InterlockedIncrement(&pRing->ConsecutiveErrors) < BTHPS3_PDO_READ_RING_MAX_ERRORS))
+	{
+		(void)BthPS3_PDO_InterruptReadRingSubmit(pPdoCtx, Request);
+	}
+
+	if (InterlockedDecrement(&pRing->Outstanding) == 0)
+	{
+		KeSetEvent(&pRing->IdleEvent, IO_NO_INCREMENT, FALSE);
+	}
+}
+
+//
+// Toggles latest-value mode, keeping only the newest buffered report
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+BthPS3_PDO_InterruptReadRingSetCoalescing(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ BOOLEAN IsEnabled
+)
+{
+	const PBTHPS3_INTERRUPT_READ_RING pRing = &PdoContext->InterruptReadRing;
+
+	//
+	// Requires driver-owned reads
+	// 
+	if (pRing->Size == 0)
+	{
+		return STATUS_NOT_SUPPORTED;
+	}
+
+	WdfSpinLockAcquire(pRing->Lock);
+
+	pRing->IsCoalescing = IsEnabled;
+
+	//
+	// Drop everything but the newest report
+	// 
+	if (IsEnabled && pRing->Count > 1)
+	{
+		pRing->Head = (pRing->Head + pRing->Count - 1) % pRing->Size;
+		pRing->Coalesced += pRing->Count - 1;
+		pRing->Count = 1;
+	}
+
+	WdfSpinLockRelease(pRing->Lock);
+
+	return STATUS_SUCCESS;
+}
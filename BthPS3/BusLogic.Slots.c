@@ -3,152 +3,400 @@
 
 
 //
-// Gets a stored slot/serial/index number for a given remote address or selects a free one
+// Slot 0 is invalid and never handed out
+// 
+#define BTHPS3_SLOTS_RESERVED_MASK(_word_)	((_word_) == 0 ? 0x1UL : 0x0UL)
+
+//
+// Marks a slot occupied
+// 
+#define BthPS3_PDO_SetSlot(_header_, _slot_) \
+	(void)InterlockedBitTestAndSet(&(_header_)->Slots[(_slot_) / 32], (_slot_) % 32)
+
+//
+// Claims the lowest free slot, a word at a time and without locking
+// 
+static BOOLEAN
+BthPS3_PDO_ClaimFreeSlot(
+	PBTHPS3_DEVICE_CONTEXT_HEADER Header,
+	PULONG Slot
+)
+{
+	ULONG bit;
+
+	for (ULONG word = 0; word < ARRAYSIZE(Header->Slots); word++)
+	{
+		ULONG freeBits = ~((ULONG)ReadNoFence(&Header->Slots[word]) | BTHPS3_SLOTS_RESERVED_MASK(word));
+
+		//
+		// Someone else may grab the same bit in between, try the next one then
+		// 
+		while (BitScanForward(&bit, freeBits))
+		{
+			if (!InterlockedBitTestAndSet(&Header->Slots[word], (LONG)bit))
+			{
+				*Slot = word * 32 + bit;
+				return TRUE;
+			}
+
+			freeBits = ~((ULONG)ReadNoFence(&Header->Slots[word]) | BTHPS3_SLOTS_RESERVED_MASK(word));
+		}
+	}
+
+	return FALSE;
+}
+
+
+//
+// Finds the entry of a remote address or the free entry it belongs in, NULL if 
+// the address isn't cached and the cache is full, lock must be held
+// 
+static PBTHPS3_SLOT_CACHE_ENTRY
+BthPS3_PDO_SlotCacheFind(
+	PBTHPS3_DEVICE_CONTEXT_HEADER Header,
+	BTH_ADDR RemoteAddress
+)
+{
+	ULONG index = BthPS3_PDO_ClientsTableHash(RemoteAddress);
+
+	//
+	// Registry may hold any number of addresses, never rely on hitting a free entry
+	// 
+	for (ULONG probe = 0; probe < BTHPS3_SLOT_CACHE_SIZE; probe++)
+	{
+		const PBTHPS3_SLOT_CACHE_ENTRY pEntry = &Header->SlotCache.Entries[index];
+
+		if (pEntry->RemoteAddress == RemoteAddress)
+		{
+			return pEntry;
+		}
+
+		if (pEntry->RemoteAddress == 0)
+		{
+			//
+			// Keep one free so probes of missing addresses stop early
+			// 
+			return (Header->SlotCache.Count < BTHPS3_SLOT_CACHE_SIZE - 1) ? pEntry : NULL;
+		}
+
+		index = (index + 1) & (BTHPS3_SLOT_CACHE_SIZE - 1);
+	}
+
+	return NULL;
+}
+
+//
+// Parses a Devices subkey name back into the remote address
+// 
+static BOOLEAN
+BthPS3_PDO_ParseDeviceKeyName(
+	PCWCH Name,
+	ULONG Length,
+	PBTH_ADDR RemoteAddress
+)
+{
+	BTH_ADDR address = 0;
+
+	if (Length != BTH_ADDR_HEX_LEN)
+	{
+		return FALSE;
+	}
+
+	for (ULONG i = 0; i < Length; i++)
+	{
+		const WCHAR c = Name[i];
+		ULONG nibble;
+
+		if (c >= L'0' && c <= L'9')
+			nibble = c - L'0';
+		else if (c >= L'A' && c <= L'F')
+			nibble = c - L'A' + 10;
+		else if (c >= L'a' && c <= L'f')
+			nibble = c - L'a' + 10;
+		else
+			return FALSE;
+
+		address = (address << 4) | nibble;
+	}
+
+	*RemoteAddress = address;
+
+	return (address != 0);
+}
+
+//
+// Loads all slots cached in the registry, so connects don't have to go there
 // 
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
-BthPS3_PDO_QuerySlot(
+BthPS3_PDO_SlotCacheLoad(
 	PBTHPS3_DEVICE_CONTEXT_HEADER Header,
-	BTH_ADDR RemoteAddress,
-	PULONG Slot
+	WDFKEY ParametersKey
 )
 {
 	NTSTATUS status;
-	WDFKEY hKey = NULL;
-	WDFKEY hDeviceKey = NULL;
+	WDFKEY hDevicesKey = NULL;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	WDF_WORKITEM_CONFIG workItemCfg;
+	ULONG resultLength;
+	ULONG slot;
+	BTH_ADDR remoteAddress;
+	ULONG loaded = 0;
+	union
+	{
+		KEY_BASIC_INFORMATION Info;
+		UCHAR Buffer[sizeof(KEY_BASIC_INFORMATION) + BTHPS3_BTH_ADDR_MAX_CHARS * sizeof(WCHAR)];
+	} keyInfo;
 
 	FuncEntry(TRACE_BUSLOGIC);
 
 	PAGED_CODE();
 
-	DECLARE_UNICODE_STRING_SIZE(deviceKeyName, REG_CACHED_DEVICE_KEY_FMT_LEN);
+	DECLARE_CONST_UNICODE_STRING(devicesKeyName, REG_CACHED_DEVICES_KEY);
 	DECLARE_CONST_UNICODE_STRING(slotNo, BTHPS3_REG_VALUE_SLOT_NO);
 
+	RtlZeroMemory(Header->SlotCache.Entries, sizeof(Header->SlotCache.Entries));
+	Header->SlotCache.Count = 0;
+	ExInitializePushLock(&Header->SlotCache.Lock);
+
 	do
 	{
-		//
-		// Open
-		//   HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Services\BthPS3\Parameters
-		// key
-		// 
-		if (!NT_SUCCESS(status = WdfDriverOpenParametersRegistryKey(
-			WdfGetDriver(),
-			STANDARD_RIGHTS_READ,
-			WDF_NO_OBJECT_ATTRIBUTES,
-			&hKey
+		WDF_WORKITEM_CONFIG_INIT(&workItemCfg, BthPS3_PDO_EvtSlotCacheWriteBack);
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = Header->Device;
+
+		if (!NT_SUCCESS(status = WdfWorkItemCreate(
+			&workItemCfg,
+			&attributes,
+			&Header->SlotCache.WriteBackWorkItem
 		)))
 		{
 			TraceError(
 				TRACE_BUSLOGIC,
-				"WdfDriverOpenParametersRegistryKey failed with status %!STATUS!",
+				"WdfWorkItemCreate failed with status %!STATUS!",
 				status
 			);
 			break;
 		}
 
-		if (!NT_SUCCESS(status = RtlUnicodeStringPrintf(
-			&deviceKeyName,
-			REG_CACHED_DEVICE_KEY_FMT,
-			RemoteAddress
+		//
+		// Nothing cached yet
+		// 
+		if (!NT_SUCCESS(WdfRegistryOpenKey(
+			ParametersKey,
+			&devicesKeyName,
+			KEY_READ,
+			WDF_NO_OBJECT_ATTRIBUTES,
+			&hDevicesKey
 		)))
 		{
-			TraceError(
-				TRACE_BUSLOGIC,
-				"RtlUnicodeStringPrintf failed with status %!STATUS!",
-				status
-			);
 			break;
 		}
 
-		//
-		// Try to get cached value
-		// 
-		if (NT_SUCCESS(WdfRegistryOpenKey(
-			hKey,
-			&deviceKeyName,
-			GENERIC_READ,
-			WDF_NO_OBJECT_ATTRIBUTES,
-			&hDeviceKey
-		))
-			&& NT_SUCCESS(status = WdfRegistryQueryULong(
-				hDeviceKey,
-				&slotNo,
-				Slot
-			)))
+		for (ULONG index = 0; ; index++)
 		{
-			TraceVerbose(
-				TRACE_BUSLOGIC,
-				"Found cached serial"
+			WDFKEY hDeviceKey = NULL;
+			UNICODE_STRING deviceKeyName;
+
+			status = ZwEnumerateKey(
+				WdfRegistryWdmGetHandle(hDevicesKey),
+				index,
+				KeyBasicInformation,
+				&keyInfo,
+				sizeof(keyInfo),
+				&resultLength
 			);
 
+			if (status == STATUS_NO_MORE_ENTRIES)
+			{
+				status = STATUS_SUCCESS;
+				break;
+			}
+
 			//
-			// Validate
+			// Names not fitting aren't ours
 			// 
-			if (*Slot == 0 /* invalid value */ || *Slot > BTHPS3_MAX_NUM_DEVICES)
+			if (status == STATUS_BUFFER_OVERFLOW || status == STATUS_BUFFER_TOO_SMALL)
 			{
-				status = STATUS_INVALID_PARAMETER;
-				break;
+				continue;
 			}
 
-			WdfWaitLockAcquire(Header->SlotsLock, NULL);
+			if (!NT_SUCCESS(status))
+			{
+				TraceError(
+					TRACE_BUSLOGIC,
+					"ZwEnumerateKey failed with status %!STATUS!",
+					status
+				);
+
+				//
+				// Keep what got loaded, missing addresses get a new slot like before
+				// 
+				status = STATUS_SUCCESS;
+				break;
+			}
 
-			SetBit(Header->Slots, *Slot);
+			if (!BthPS3_PDO_ParseDeviceKeyName(
+				keyInfo.Info.Name,
+				keyInfo.Info.NameLength / sizeof(WCHAR),
+				&remoteAddress
+			))
+			{
+				continue;
+			}
 
-			WdfWaitLockRelease(Header->SlotsLock);
+			deviceKeyName.Buffer = keyInfo.Info.Name;
+			deviceKeyName.Length = deviceKeyName.MaximumLength = (USHORT)keyInfo.Info.NameLength;
 
-			status = STATUS_SUCCESS;
-		}
-		//
-		// Get next free one
-		// 
-		else
-		{
-			TraceVerbose(
-				TRACE_BUSLOGIC,
-				"Looking for free serial"
-			);
-
-			WdfWaitLockAcquire(Header->SlotsLock, NULL);
+			if (!NT_SUCCESS(WdfRegistryOpenKey(
+				hDevicesKey,
+				&deviceKeyName,
+				KEY_READ,
+				WDF_NO_OBJECT_ATTRIBUTES,
+				&hDeviceKey
+			)))
+			{
+				continue;
+			}
 
-			//
-			// ...otherwise get next free serial number
-			// 
-			for (*Slot = 1; *Slot <= BTHPS3_MAX_NUM_DEVICES; (*Slot)++)
+			if (NT_SUCCESS(WdfRegistryQueryULong(
+				hDeviceKey,
+				&slotNo,
+				&slot
+			))
+				&& slot != 0 /* invalid value */
+				&& slot <= BTHPS3_MAX_NUM_DEVICES)
 			{
-				if (!TestBit(Header->Slots, *Slot))
+				const PBTHPS3_SLOT_CACHE_ENTRY pEntry = BthPS3_PDO_SlotCacheFind(Header, remoteAddress);
+
+				//
+				// More addresses than fit, the rest get a new slot like before
+				// 
+				if (pEntry == NULL)
 				{
-					TraceVerbose(
+					TraceEvents(TRACE_LEVEL_WARNING,
 						TRACE_BUSLOGIC,
-						"Assigned serial: %d",
-						*Slot
+						"Slot cache full, ignoring remaining cached devices"
 					);
 
-					SetBit(Header->Slots, *Slot);
-
-					status = STATUS_SUCCESS;
+					WdfRegistryClose(hDeviceKey);
 					break;
 				}
-			}
 
-			if (*Slot > BTHPS3_MAX_NUM_DEVICES)
-			{
-				status = STATUS_NO_MORE_ENTRIES;
+				if (pEntry->RemoteAddress == 0)
+				{
+					Header->SlotCache.Count++;
+				}
+
+				pEntry->RemoteAddress = remoteAddress;
+				pEntry->Slot = slot;
+				pEntry->IsDirty = FALSE;
+
+				BthPS3_PDO_SetSlot(Header, slot);
+
+				loaded++;
 			}
 
-			WdfWaitLockRelease(Header->SlotsLock);
+			WdfRegistryClose(hDeviceKey);
 		}
 
 	} while (FALSE);
 
-	if (hKey)
+	if (hDevicesKey)
 	{
-		WdfRegistryClose(hKey);
+		WdfRegistryClose(hDevicesKey);
 	}
 
-	if (hDeviceKey)
+	TraceVerbose(
+		TRACE_BUSLOGIC,
+		"Loaded %d cached slots",
+		loaded
+	);
+
+	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+
+	return status;
+}
+#pragma code_seg()
+
+//
+// Gets a stored slot/serial/index number for a given remote address or selects a free one
+// 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_QuerySlot(
+	PBTHPS3_DEVICE_CONTEXT_HEADER Header,
+	BTH_ADDR RemoteAddress,
+	PULONG Slot
+)
+{
+	NTSTATUS status;
+	PBTHPS3_SLOT_CACHE_ENTRY pEntry;
+	ULONG cachedSlot = 0;
+
+	FuncEntry(TRACE_BUSLOGIC);
+
+	PAGED_CODE();
+
+	KeEnterCriticalRegion();
+	ExAcquirePushLockShared(&Header->SlotCache.Lock);
+
+	pEntry = BthPS3_PDO_SlotCacheFind(Header, RemoteAddress);
+
+	if (pEntry != NULL && pEntry->RemoteAddress == RemoteAddress)
+	{
+		cachedSlot = pEntry->Slot;
+	}
+
+	ExReleasePushLockShared(&Header->SlotCache.Lock);
+	KeLeaveCriticalRegion();
+
+	//
+	// Try to get cached value
+	// 
+	if (cachedSlot != 0)
 	{
-		WdfRegistryClose(hDeviceKey);
+		TraceVerbose(
+			TRACE_BUSLOGIC,
+			"Found cached serial"
+		);
+
+		*Slot = cachedSlot;
+
+		BthPS3_PDO_SetSlot(Header, *Slot);
+
+		status = STATUS_SUCCESS;
+	}
+	//
+	// Get next free one
+	// 
+	else
+	{
+		TraceVerbose(
+			TRACE_BUSLOGIC,
+			"Looking for free serial"
+		);
+
+		//
+		// ...otherwise get next free serial number
+		// 
+		if (BthPS3_PDO_ClaimFreeSlot(Header, Slot))
+		{
+			TraceVerbose(
+				TRACE_BUSLOGIC,
+				"Assigned serial: %d",
+				*Slot
+			);
+
+			status = STATUS_SUCCESS;
+		}
+		else
+		{
+			status = STATUS_NO_MORE_ENTRIES;
+		}
 	}
 
 	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
@@ -158,7 +406,7 @@ BthPS3_PDO_QuerySlot(
 #pragma code_seg()
 
 //
-// Caches an occupied slot in the registry
+// Caches an occupied slot, the registry is updated in the background
 // 
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -168,27 +416,99 @@ BthPS3_PDO_AssignSlot(
 	BTH_ADDR RemoteAddress,
 	ULONG Slot
 )
+{
+	BOOLEAN isChanged = FALSE;
+
+	FuncEntry(TRACE_BUSLOGIC);
+
+	PAGED_CODE();
+
+	if (Slot == 0 /* invalid value */ || Slot > BTHPS3_MAX_NUM_DEVICES)
+	{
+		FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", STATUS_INVALID_PARAMETER);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	BthPS3_PDO_SetSlot(Header, Slot);
+
+	KeEnterCriticalRegion();
+	ExAcquirePushLockExclusive(&Header->SlotCache.Lock);
+
+	const PBTHPS3_SLOT_CACHE_ENTRY pEntry = BthPS3_PDO_SlotCacheFind(Header, RemoteAddress);
+
+	//
+	// Slot stays claimed for now, it just won't be remembered across restarts
+	// 
+	if (pEntry == NULL)
+	{
+		TraceEvents(TRACE_LEVEL_WARNING,
+			TRACE_BUSLOGIC,
+			"Slot cache full, slot %d of device %012llX not persisted",
+			Slot,
+			RemoteAddress
+		);
+	}
+	else if (pEntry->RemoteAddress != RemoteAddress || pEntry->Slot != Slot)
+	{
+		if (pEntry->RemoteAddress == 0)
+		{
+			Header->SlotCache.Count++;
+		}
+
+		pEntry->RemoteAddress = RemoteAddress;
+		pEntry->Slot = Slot;
+		pEntry->IsDirty = TRUE;
+		isChanged = TRUE;
+	}
+
+	ExReleasePushLockExclusive(&Header->SlotCache.Lock);
+	KeLeaveCriticalRegion();
+
+	//
+	// Already queued ones pick up this entry too
+	// 
+	if (isChanged)
+	{
+		WdfWorkItemEnqueue(Header->SlotCache.WriteBackWorkItem);
+	}
+
+	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", STATUS_SUCCESS);
+
+	return STATUS_SUCCESS;
+}
+#pragma code_seg()
+
+//
+// Persists slot cache entries not yet written to the registry
+// 
+#pragma code_seg("PAGE")
+_Use_decl_annotations_
+VOID
+BthPS3_PDO_EvtSlotCacheWriteBack(
+	WDFWORKITEM WorkItem
+)
 {
 	NTSTATUS status;
 	WDFKEY hKey = NULL;
 	WDFKEY hDeviceKey = NULL;
+	BTH_ADDR remoteAddress;
+	ULONG slot = 0;
+	ULONG written = 0;
+	ULONG next = 0;
 
 	FuncEntry(TRACE_BUSLOGIC);
 
 	PAGED_CODE();
 
+	const PBTHPS3_DEVICE_CONTEXT_HEADER pHeader =
+		&GetServerDeviceContext(WdfWorkItemGetParentObject(WorkItem))->Header;
+
 	DECLARE_UNICODE_STRING_SIZE(deviceKeyName, REG_CACHED_DEVICE_KEY_FMT_LEN);
 	DECLARE_CONST_UNICODE_STRING(slotNo, BTHPS3_REG_VALUE_SLOT_NO);
 	DECLARE_CONST_UNICODE_STRING(slots, BTHPS3_REG_VALUE_SLOTS);
 
 	do
 	{
-		if (Slot == 0 /* invalid value */ || Slot > BTHPS3_MAX_NUM_DEVICES)
-		{
-			status = STATUS_INVALID_PARAMETER;
-			break;
-		}
-
 		//
 		// Open
 		//   HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Services\BthPS3\Parameters
@@ -209,64 +529,119 @@ BthPS3_PDO_AssignSlot(
 			break;
 		}
 
-		if (!NT_SUCCESS(status = RtlUnicodeStringPrintf(
-			&deviceKeyName,
-			REG_CACHED_DEVICE_KEY_FMT,
-			RemoteAddress
-		)))
+		for (;;)
 		{
-			TraceError(
-				TRACE_BUSLOGIC,
-				"RtlUnicodeStringPrintf failed with status %!STATUS!",
-				status
-			);
-			break;
-		}
+			remoteAddress = 0;
 
-		//
-		// Create key for device
-		// 
-		if (!NT_SUCCESS(status = WdfRegistryCreateKey(
-			hKey,
-			&deviceKeyName,
-			GENERIC_WRITE,
-			REG_OPTION_NON_VOLATILE,
-			NULL,
-			WDF_NO_OBJECT_ATTRIBUTES,
-			&hDeviceKey
-		)))
-		{
-			TraceError(
-				TRACE_BUSLOGIC,
-				"WdfRegistryCreateKey failed with status %!STATUS!",
-				status
-			);
-			break;
+			//
+			// Take one dirty entry at a time, the lock isn't held across registry calls. 
+			// Entries stay dirty until written, failed ones are retried with the next 
+			// write-back instead of being picked again in this one.
+			// 
+			KeEnterCriticalRegion();
+			ExAcquirePushLockExclusive(&pHeader->SlotCache.Lock);
+
+			for (; next < BTHPS3_SLOT_CACHE_SIZE; next++)
+			{
+				const PBTHPS3_SLOT_CACHE_ENTRY pEntry = &pHeader->SlotCache.Entries[next];
+
+				if (pEntry->RemoteAddress != 0 && pEntry->IsDirty)
+				{
+					remoteAddress = pEntry->RemoteAddress;
+					slot = pEntry->Slot;
+					next++;
+					break;
+				}
+			}
+
+			ExReleasePushLockExclusive(&pHeader->SlotCache.Lock);
+			KeLeaveCriticalRegion();
+
+			if (remoteAddress == 0)
+			{
+				break;
+			}
+
+			if (!NT_SUCCESS(status = RtlUnicodeStringPrintf(
+				&deviceKeyName,
+				REG_CACHED_DEVICE_KEY_FMT,
+				remoteAddress
+			)))
+			{
+				TraceError(
+					TRACE_BUSLOGIC,
+					"RtlUnicodeStringPrintf failed with status %!STATUS!",
+					status
+				);
+				continue;
+			}
+
+			//
+			// Create key for device
+			// 
+			if (!NT_SUCCESS(status = WdfRegistryCreateKey(
+				hKey,
+				&deviceKeyName,
+				GENERIC_WRITE,
+				REG_OPTION_NON_VOLATILE,
+				NULL,
+				WDF_NO_OBJECT_ATTRIBUTES,
+				&hDeviceKey
+			)))
+			{
+				TraceError(
+					TRACE_BUSLOGIC,
+					"WdfRegistryCreateKey failed with status %!STATUS!",
+					status
+				);
+				continue;
+			}
+
+			//
+			// Store serial value
+			// 
+			if (!NT_SUCCESS(status = WdfRegistryAssignULong(
+				hDeviceKey,
+				&slotNo,
+				slot
+			)))
+			{
+				TraceError(
+					TRACE_BUSLOGIC,
+					"WdfRegistryAssignULong failed with status %!STATUS!",
+					status
+				);
+			}
+			else
+			{
+				const PBTHPS3_SLOT_CACHE_ENTRY pEntry = &pHeader->SlotCache.Entries[next - 1];
+
+				//
+				// Stays dirty if it got reassigned while we were writing
+				// 
+				KeEnterCriticalRegion();
+				ExAcquirePushLockExclusive(&pHeader->SlotCache.Lock);
+
+				if (pEntry->RemoteAddress == remoteAddress && pEntry->Slot == slot)
+				{
+					pEntry->IsDirty = FALSE;
+				}
+
+				ExReleasePushLockExclusive(&pHeader->SlotCache.Lock);
+				KeLeaveCriticalRegion();
+
+				written++;
+			}
+
+			WdfRegistryClose(hDeviceKey);
+			hDeviceKey = NULL;
 		}
 
-		//
-		// Store serial value
-		// 
-		if (!NT_SUCCESS(status = WdfRegistryAssignULong(
-			hDeviceKey,
-			&slotNo,
-			Slot
-		)))
+		if (written == 0)
 		{
-			TraceError(
-				TRACE_BUSLOGIC,
-				"WdfRegistryAssignULong failed with status %!STATUS!",
-				status
-			);
 			break;
 		}
 
-		WdfWaitLockAcquire(Header->SlotsLock, NULL);
-
-		SetBit(Header->Slots, Slot);
-
-		WdfWaitLockRelease(Header->SlotsLock);
-
 		//
 		// Store occupied slots in registry
 		// 
@@ -274,8 +649,8 @@ BthPS3_PDO_AssignSlot(
 			hKey,
 			&slots,
 			REG_BINARY,
-			sizeof(Header->Slots),
-			&Header->Slots
+			sizeof(pHeader->Slots),
+			(PVOID)pHeader->Slots
 		)))
 		{
 			TraceError(
@@ -293,13 +668,12 @@ BthPS3_PDO_AssignSlot(
 		WdfRegistryClose(hKey);
 	}
 
-	if (hDeviceKey)
-	{
-		WdfRegistryClose(hDeviceKey);
-	}
-
-	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+	TraceVerbose(
+		TRACE_BUSLOGIC,
+		"Wrote back %d slots",
+		written
+	);
 
-	return status;
+	FuncExitNoReturn(TRACE_BUSLOGIC);
 }
 #pragma code_seg()
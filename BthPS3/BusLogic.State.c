@@ -55,19 +55,10 @@ BthPS3_PDO_EvtPreCreate(
 
 	NTSTATUS status = STATUS_SUCCESS;
 	WDF_PNPPOWER_EVENT_CALLBACKS power;
-	WDFKEY hKey = NULL;
-	ULONG rawPdo = 0;
-	ULONG adminOnlyPdo = 0;
-	ULONG exclusivePdo = 1;
+	WDF_FILEOBJECT_CONFIG fileConfig;
 
-	UNREFERENCED_PARAMETER(DmfModule);
-	UNREFERENCED_PARAMETER(DmfDeviceInit);
 	UNREFERENCED_PARAMETER(PdoRecord);
 
-	DECLARE_CONST_UNICODE_STRING(rawPdoValue, BTHPS3_REG_VALUE_RAW_PDO);
-	DECLARE_CONST_UNICODE_STRING(adminOnlyPdoValue, BTHPS3_REG_VALUE_ADMIN_ONLY_PDO);
-	DECLARE_CONST_UNICODE_STRING(exclusivePdoValue, BTHPS3_REG_VALUE_EXCLUSIVE_PDO);
-
 	WdfDeviceInitSetDeviceType(DeviceInit, FILE_DEVICE_BUS_EXTENDER);
 
 	//
@@ -78,94 +69,56 @@ BthPS3_PDO_EvtPreCreate(
 
 	WDF_PNPPOWER_EVENT_CALLBACKS_INIT(&power);
 	power.EvtDeviceSelfManagedIoInit = BthPS3_PDO_SelfManagedIoInit;
+	power.EvtDeviceSelfManagedIoFlush = BthPS3_PDO_SelfManagedIoFlush;
 
 	WdfDeviceInitSetPnpPowerEventCallbacks(DeviceInit, &power);
 
-	do
-	{
-		//
-		// Open
-		//   HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Services\BthPS3\Parameters
-		// key
-		// 
-		if (!NT_SUCCESS(status = WdfDriverOpenParametersRegistryKey(
-			WdfGetDriver(),
-			STANDARD_RIGHTS_READ,
-			WDF_NO_OBJECT_ATTRIBUTES,
-			&hKey
-		)))
-		{
-			TraceError(
-				TRACE_BUSLOGIC,
-				"WdfDriverOpenParametersRegistryKey failed with status %!STATUS!",
-				status
-			);
+	//
+	// Mailbox registration is bound to the handle it was issued on
+	// 
+	WDF_FILEOBJECT_CONFIG_INIT(&fileConfig, NULL, NULL, BthPS3_PDO_EvtFileCleanup);
 
-			status = STATUS_SUCCESS;
-			break;
-		}
+	DMF_DmfDeviceInitHookFileObjectConfig(DmfDeviceInit, &fileConfig);
 
-		//
-		// Don't care, if it fails, keep default value
-		// 
-		(void)WdfRegistryQueryULong(
-			hKey,
-			&rawPdoValue,
-			&rawPdo
-		);
+	WdfDeviceInitSetFileObjectConfig(DeviceInit, &fileConfig, WDF_NO_OBJECT_ATTRIBUTES);
 
+	WdfDeviceInitSetIoInCallerContextCallback(DeviceInit, BthPS3_PDO_EvtIoInCallerContext);
+
+	//
+	// Settings are kept current by registry change notification
+	// 
+	const PBTHPS3_SETTINGS pSettings = BthPS3_SettingsAcquire(
+		GetServerDeviceContext(DMF_ParentDeviceGet(DmfModule))
+	);
+
+	if (pSettings->RawPdo)
+	{
 		//
-		// Don't care, if it fails, keep default value
+		// Only one instance (either function driver or user-land application)
+		// may talk to this PDO at the same time to avoid splitting traffic.
 		// 
-		(void)WdfRegistryQueryULong(
-			hKey,
-			&adminOnlyPdoValue,
-			&adminOnlyPdo
-		);
+		WdfDeviceInitSetExclusive(DeviceInit, (BOOLEAN)pSettings->ExclusivePdo);
 
 		//
-		// Don't care, if it fails, keep default value
+		// Let the world talk to us
 		// 
-		(void)WdfRegistryQueryULong(
-			hKey,
-			&exclusivePdoValue,
-			&exclusivePdo
+		status = WdfDeviceInitAssignSDDLString(DeviceInit,
+			(pSettings->AdminOnlyPdo) ? &SDDL_DEVOBJ_SYS_ALL_ADM_ALL : // only elevated allowed
+			&SDDL_DEVOBJ_SYS_ALL_ADM_RWX_WORLD_RWX_RES_RWX  // everyone is allowed
 		);
 
-		if (rawPdo)
+		if (!NT_SUCCESS(status))
 		{
-			//
-			// Only one instance (either function driver or user-land application)
-			// may talk to this PDO at the same time to avoid splitting traffic.
-			// 
-			WdfDeviceInitSetExclusive(DeviceInit, (BOOLEAN)exclusivePdo);
-
-			//
-			// Let the world talk to us
-			// 
-			status = WdfDeviceInitAssignSDDLString(DeviceInit,
-				(adminOnlyPdo) ? &SDDL_DEVOBJ_SYS_ALL_ADM_ALL : // only elevated allowed
-				&SDDL_DEVOBJ_SYS_ALL_ADM_RWX_WORLD_RWX_RES_RWX  // everyone is allowed
+			TraceError(
+				TRACE_BUSLOGIC,
+				"WdfDeviceInitAssignSDDLString failed with status %!STATUS!",
+				status
 			);
-
-			if (!NT_SUCCESS(status))
-			{
-				TraceError(
-					TRACE_BUSLOGIC,
-					"WdfDeviceInitAssignSDDLString failed with status %!STATUS!",
-					status
-				);
-				break;
-			}
 		}
-
-	} while (FALSE);
-
-	if (hKey)
-	{
-		WdfRegistryClose(hKey);
 	}
 
+	BthPS3_SettingsRelease(pSettings);
+
 	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
 
 	return status;
@@ -188,16 +141,17 @@ BthPS3_PDO_EvtPostCreate(
 	WDF_OBJECT_ATTRIBUTES attributes;
 	WDF_IO_QUEUE_CONFIG queueCfg;
 	WDF_DEVICE_PNP_CAPABILITIES pnp;
-	WDFKEY hKey = NULL;
-	ULONG hidePdo = 0;
-
-	DECLARE_CONST_UNICODE_STRING(hidePdoValue, BTHPS3_REG_VALUE_HIDE_PDO);
+	WDF_WORKITEM_CONFIG workItemCfg;
+	WDF_TIMER_CONFIG timerCfg;
 
-	UNREFERENCED_PARAMETER(DmfModule);
 	UNREFERENCED_PARAMETER(DmfDeviceInit);
 	UNREFERENCED_PARAMETER(PdoRecord);
 
 	const PBTHPS3_PDO_CONTEXT pPdoCtx = GetPdoContext(ChildDevice);
+	const PBTHPS3_SETTINGS pSettings = BthPS3_SettingsAcquire(
+		GetServerDeviceContext(DMF_ParentDeviceGet(DmfModule))
+	);
+	ULONG readRingSize = pSettings->ChildReadRingSize;
 
 	do
 	{
@@ -269,53 +223,141 @@ BthPS3_PDO_EvtPostCreate(
 			break;
 		}
 
+		if (!NT_SUCCESS(status = WdfIoQueueCreate(
+			ChildDevice,
+			&queueCfg,
+			&attributes,
+			&pPdoCtx->Queues.HidInterruptReadBatchRequests
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"WdfIoQueueCreate (HidInterruptReadBatchRequests) failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
 		//
-		// Open
-		//   HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Services\BthPS3\Parameters
-		// key
+		// Pre-allocate BRBs used for HID Control & Interrupt transfers
 		// 
-		if (!NT_SUCCESS(status = WdfDriverOpenParametersRegistryKey(
-			WdfGetDriver(),
-			STANDARD_RIGHTS_READ,
-			WDF_NO_OBJECT_ATTRIBUTES,
-			&hKey
+		if (!NT_SUCCESS(status = BthPS3_PDO_BrbPoolInit(
+			ChildDevice,
+			pPdoCtx
 		)))
 		{
 			TraceError(
 				TRACE_BUSLOGIC,
-				"WdfDriverOpenParametersRegistryKey failed with status %!STATUS!",
+				"BthPS3_PDO_BrbPoolInit failed with status %!STATUS!",
 				status
 			);
+			break;
+		}
 
-			status = STATUS_SUCCESS;
+		if (!NT_SUCCESS(status = BthPS3_PDO_MailboxInit(
+			ChildDevice,
+			pPdoCtx
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"BthPS3_PDO_MailboxInit failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
+		WDF_WORKITEM_CONFIG_INIT(&workItemCfg, BthPS3_PDO_EvtDeferredPropertiesWorkItem);
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = ChildDevice;
+
+		if (!NT_SUCCESS(status = WdfWorkItemCreate(
+			&workItemCfg,
+			&attributes,
+			&pPdoCtx->DeferredPropertiesWorkItem
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"WdfWorkItemCreate failed with status %!STATUS!",
+				status
+			);
 			break;
 		}
 
 		//
-		// Don't care, if it fails, keep default value
+		// Released by self-managed I/O init and HID Control channel acceptance
 		// 
-		(void)WdfRegistryQueryULong(
-			hKey,
-			&hidePdoValue,
-			&hidePdo
-		);
+		pPdoCtx->DeferredPropertiesGates = 2;
+
+		WDF_TIMER_CONFIG_INIT(&timerCfg, BthPS3_PDO_EvtLingerTimerFunc);
+		timerCfg.AutomaticSerialization = FALSE;
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = ChildDevice;
+		//
+		// Expiry unplugs the PDO which requires PASSIVE_LEVEL
+		// 
+		attributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+		if (!NT_SUCCESS(status = WdfTimerCreate(
+			&timerCfg,
+			&attributes,
+			&pPdoCtx->LingerTimer
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"WdfTimerCreate failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
 
-		if (hidePdo) 
+		if (pSettings->HidePdo) 
 		{
 			WDF_DEVICE_PNP_CAPABILITIES_INIT(&pnp);
 			pnp.Removable = WdfTrue;
 			pnp.SurpriseRemovalOK = WdfTrue;
-			pnp.NoDisplayInUI = (hidePdo) ? WdfTrue : WdfFalse;
+			pnp.NoDisplayInUI = (pSettings->HidePdo) ? WdfTrue : WdfFalse;
 
 			WdfDeviceSetPnpCapabilities(ChildDevice, &pnp);
 		}
 
+		//
+		// Coalescing needs at least one driver-owned read
+		// 
+		if (pSettings->ChildCoalesceReads && readRingSize == 0)
+		{
+			readRingSize = 1;
+		}
+
+		//
+		// Optionally keep HID Interrupt reads permanently outstanding
+		// 
+		if (!NT_SUCCESS(status = BthPS3_PDO_InterruptReadRingInit(
+			ChildDevice,
+			pPdoCtx,
+			readRingSize
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"BthPS3_PDO_InterruptReadRingInit failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
+		if (pSettings->ChildCoalesceReads)
+		{
+			(void)BthPS3_PDO_InterruptReadRingSetCoalescing(pPdoCtx, TRUE);
+		}
+
 	} while (FALSE);
 
-	if (hKey)
-	{
-		WdfRegistryClose(hKey);
-	}
+	BthPS3_SettingsRelease(pSettings);
 
 	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
 
@@ -433,11 +475,50 @@ BthPS3_PDO_SelfManagedIoInit(
 		WdfRegistryClose(hKey);
 	}
 
+	//
+	// Device is known to PnP now, properties may be written
+	// 
+	BthPS3_PDO_DeferredPropertiesGateRelease(GetPdoContext(Device));
+
 	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
 
 	return status;
 }
 
+//
+// PDO is going away, don't keep the mailbox consumer waiting
+// 
+_Use_decl_annotations_
+VOID
+BthPS3_PDO_SelfManagedIoFlush(
+	WDFDEVICE Device
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	BthPS3_PDO_MailboxRelease(GetPdoContext(Device), NULL, STATUS_DEVICE_NOT_CONNECTED);
+
+	FuncExitNoReturn(TRACE_BUSLOGIC);
+}
+
+//
+// Handle got closed, release resources bound to it
+// 
+_Use_decl_annotations_
+VOID
+BthPS3_PDO_EvtFileCleanup(
+	WDFFILEOBJECT FileObject
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	const WDFDEVICE device = WdfFileObjectGetDevice(FileObject);
+
+	BthPS3_PDO_MailboxRelease(GetPdoContext(device), FileObject, STATUS_CANCELLED);
+
+	FuncExitNoReturn(TRACE_BUSLOGIC);
+}
+
 //
 // Disconnect request completed
 // 
@@ -50,11 +50,124 @@ IoctlHandler_IoctlRecord G_PDO_IoctlSpecification[] =
 	{IOCTL_BTHPS3_HID_CONTROL_WRITE, 1, 0, BthPS3_PDO_HandleHidControlWrite},
 	{IOCTL_BTHPS3_HID_INTERRUPT_READ, 0, 1, BthPS3_PDO_HandleHidInterruptRead},
 	{IOCTL_BTHPS3_HID_INTERRUPT_WRITE, 1, 0, BthPS3_PDO_HandleHidInterruptWrite},
+	/* Direct I/O variants of the above, payload is passed to the radio without copying */
+	{IOCTL_BTHPS3_HID_CONTROL_READ_DIRECT, 0, 1, BthPS3_PDO_HandleHidControlRead},
+	{IOCTL_BTHPS3_HID_CONTROL_WRITE_DIRECT, 0, 1, BthPS3_PDO_HandleHidControlWrite},
+	{IOCTL_BTHPS3_HID_INTERRUPT_READ_DIRECT, 0, 1, BthPS3_PDO_HandleHidInterruptRead},
+	{IOCTL_BTHPS3_HID_INTERRUPT_WRITE_DIRECT, 0, 1, BthPS3_PDO_HandleHidInterruptWrite},
+	{IOCTL_BTHPS3_HID_INTERRUPT_READ_BATCH, 0, sizeof(BTHPS3_HID_INPUT_REPORT_HEADER) + BTHPS3_SIXAXIS_HID_INPUT_REPORT_SIZE, BthPS3_PDO_HandleHidInterruptReadBatch},
+	{IOCTL_BTHPS3_HID_INTERRUPT_SET_COALESCING, sizeof(BTHPS3_HID_INTERRUPT_SET_COALESCING), sizeof(BTHPS3_HID_INTERRUPT_SET_COALESCING), BthPS3_PDO_HandleHidInterruptSetCoalescing},
+	{IOCTL_BTHPS3_HID_INTERRUPT_MAP_MAILBOX, sizeof(BTHPS3_HID_INTERRUPT_MAP_MAILBOX), sizeof(BTHPS3_HID_INPUT_REPORT_MAILBOX), BthPS3_PDO_HandleHidInterruptMapMailbox},
 	/* Disconnect instruction (e.g. from DsHidMini) */
 	{IOCTL_BTH_DISCONNECT_DEVICE, sizeof(BTH_ADDR), 0, BthPS3_PDO_HandleBthDisconnect},
 };
 
 
+//
+// Child device identification, indexed by DS_DEVICE_TYPE
+// 
+static BTHPS3_PDO_TEMPLATE G_PDO_Templates[] =
+{
+	/* DS_DEVICE_TYPE_UNKNOWN */
+	{NULL, NULL, NULL, NULL, NULL},
+	/* DS_DEVICE_TYPE_SIXAXIS */
+	{&GUID_BUSENUM_BTHPS3_SIXAXIS, &GUID_DEVCLASS_BTHPS3_SIXAXIS, &BTHPS3_SIXAXIS_VID, &BTHPS3_SIXAXIS_PID, L"PLAYSTATION(R)3 Controller"},
+	/* DS_DEVICE_TYPE_NAVIGATION */
+	{&GUID_BUSENUM_BTHPS3_NAVIGATION, &GUID_DEVCLASS_BTHPS3_NAVIGATION, &BTHPS3_NAVIGATION_VID, &BTHPS3_NAVIGATION_PID, L"Navigation Controller"},
+	/* DS_DEVICE_TYPE_MOTION */
+	{&GUID_BUSENUM_BTHPS3_MOTION, &GUID_DEVCLASS_BTHPS3_MOTION, &BTHPS3_MOTION_VID, &BTHPS3_MOTION_PID, L"Motion Controller"},
+	/* DS_DEVICE_TYPE_WIRELESS */
+	{&GUID_BUSENUM_BTHPS3_WIRELESS, &GUID_DEVCLASS_BTHPS3_WIRELESS, &BTHPS3_WIRELESS_VID, &BTHPS3_WIRELESS_PID, L"Wireless Controller"},
+};
+
+C_ASSERT(ARRAYSIZE(G_PDO_Templates) == DS_DEVICE_TYPE_WIRELESS + 1);
+
+
+//
+// Renders the hardware IDs of all device types, called once from DriverEntry
+// 
+#pragma code_seg("INIT")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_TemplatesInit(
+	VOID
+)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+	UNICODE_STRING guidString;
+
+	FuncEntry(TRACE_BUSLOGIC);
+
+	for (ULONG index = DS_DEVICE_TYPE_SIXAXIS; index < ARRAYSIZE(G_PDO_Templates); index++)
+	{
+		const PBTHPS3_PDO_TEMPLATE pTemplate = &G_PDO_Templates[index];
+
+		if (!NT_SUCCESS(status = RtlStringFromGUID(
+			pTemplate->BusGuid,
+			&guidString
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"RtlStringFromGUID failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
+		status = RtlStringCchPrintfW(
+			pTemplate->HardwareId,
+			ARRAYSIZE(pTemplate->HardwareId),
+			L"%ws\\%wZ&Dev&VID_%04X&PID_%04X",
+			BthPS3BusEnumeratorName,
+			&guidString,
+			*pTemplate->VendorId,
+			*pTemplate->ProductId
+		);
+
+		RtlFreeUnicodeString(&guidString);
+
+		if (!NT_SUCCESS(status))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"RtlStringCchPrintfW failed for hardwareId with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
+		TraceVerbose(
+			TRACE_BUSLOGIC,
+			"Device type %u uses hardware ID %ws",
+			index,
+			pTemplate->HardwareId
+		);
+	}
+
+	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+
+	return status;
+}
+#pragma code_seg()
+
+//
+// Looks up the identification of a device type, NULL if unsupported
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+PBTHPS3_PDO_TEMPLATE
+BthPS3_PDO_TemplateGet(
+	_In_ DS_DEVICE_TYPE DeviceType
+)
+{
+	if (DeviceType == DS_DEVICE_TYPE_UNKNOWN || (ULONG)DeviceType >= ARRAYSIZE(G_PDO_Templates))
+	{
+		return NULL;
+	}
+
+	return &G_PDO_Templates[DeviceType];
+}
+
 //
 // Called when initializing DMF modules for the PDO
 // 
@@ -120,18 +233,14 @@ BthPS3_PDO_Create(
 	WDF_OBJECT_ATTRIBUTES attributes;
 	PDO_RECORD record;
 	WDFDEVICE device;
-	UNICODE_STRING guidString = { 0 };
 	WCHAR devAddr[BTHPS3_BTH_ADDR_MAX_CHARS]; // MAC address in hex format including NULL terminator
-	PWSTR manufacturer = L"Nefarius Software Solutions e.U.";
 	LARGE_INTEGER lastConnectionTime;
-	WDFKEY hKey = NULL;
-	ULONG rawPdo = 0;
+	PBTHPS3_SETTINGS pSettings;
+	ULONG rawPdo;
 
     *PdoContext = NULL;
 
-	DECLARE_UNICODE_STRING_SIZE(hardwareId, MAX_DEVICE_ID_LEN);
-	DECLARE_UNICODE_STRING_SIZE(remotenameWide, BTH_MAX_NAME_SIZE);
-	DECLARE_CONST_UNICODE_STRING(rawPdoValue, BTHPS3_REG_VALUE_RAW_PDO);
+	const PBTHPS3_PDO_TEMPLATE pTemplate = BthPS3_PDO_TemplateGet(DeviceType);
 
 	WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, BTHPS3_PDO_CONTEXT);
 
@@ -150,34 +259,20 @@ BthPS3_PDO_Create(
 
 
 	//
-	// Open
-	//   HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Services\BthPS3\Parameters
-	// key
-	// 
-	status = WdfDriverOpenParametersRegistryKey(
-		WdfGetDriver(),
-		STANDARD_RIGHTS_READ,
-		WDF_NO_OBJECT_ATTRIBUTES,
-		&hKey
-	);
-
-	//
-	// On success, read configuration values
+	// Settings are kept current by registry change notification
 	// 
-	if (NT_SUCCESS(status))
-	{
-		//
-		// Don't care, if it fails, keep default value
-		// 
-		(void)WdfRegistryQueryULong(
-			hKey,
-			&rawPdoValue,
-			&rawPdo
-		);
-	}
+	pSettings = BthPS3_SettingsAcquire(Context);
+	rawPdo = pSettings->RawPdo;
+	BthPS3_SettingsRelease(pSettings);
 
 	do
 	{
+		if (pTemplate == NULL)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
 		//
 		// Get unique serial
 		// 
@@ -195,23 +290,6 @@ BthPS3_PDO_Create(
 			break;
 		}
 
-		//
-		// Convert remote name from narrow to wide
-		// 
-		if (!NT_SUCCESS(status = RtlUnicodeStringPrintf(
-			&remotenameWide,
-			L"%hs",
-			RemoteName
-		)))
-		{
-			TraceError(
-				TRACE_BUSLOGIC,
-				"RtlUnicodeStringPrintf failed with status %!STATUS!",
-				status
-			);
-			break;
-		}
-
 		//
 		// Prepare properties
 		// 
@@ -232,7 +310,8 @@ BthPS3_PDO_Create(
 		}
 
 		//
-		// Set these device properties for the new PDO
+		// Set these device properties for the new PDO, the ones only 
+		// cosmetic to the user are written once the channels are up
 		// TODO: convert from stack to heap allocated!
 		// 
 		Pdo_DevicePropertyEntry entries[] =
@@ -240,7 +319,7 @@ BthPS3_PDO_Create(
 			{
 				{sizeof(WDF_DEVICE_PROPERTY_DATA), &DEVPKEY_Bluetooth_DeviceVID, LOCALE_NEUTRAL, PLUGPLAY_PROPERTY_PERSISTENT},
 				DEVPROP_TYPE_UINT16,
-				NULL,
+				pTemplate->VendorId,
 				sizeof(USHORT),
 				FALSE,
 				NULL
@@ -248,7 +327,7 @@ BthPS3_PDO_Create(
 			{
 				{sizeof(WDF_DEVICE_PROPERTY_DATA), &DEVPKEY_Bluetooth_DevicePID, LOCALE_NEUTRAL, PLUGPLAY_PROPERTY_PERSISTENT},
 				DEVPROP_TYPE_UINT16,
-				NULL,
+				pTemplate->ProductId,
 				sizeof(USHORT),
 				FALSE,
 				NULL
@@ -269,59 +348,8 @@ BthPS3_PDO_Create(
 				FALSE,
 				NULL
 			},
-			{
-				{sizeof(WDF_DEVICE_PROPERTY_DATA), &DEVPKEY_Device_FriendlyName, LOCALE_NEUTRAL, PLUGPLAY_PROPERTY_PERSISTENT},
-				DEVPROP_TYPE_STRING,
-				remotenameWide.Buffer,
-				remotenameWide.Length + sizeof(L'\0'),
-				FALSE,
-				NULL
-			},
-			{
-				{sizeof(WDF_DEVICE_PROPERTY_DATA), &DEVPKEY_Bluetooth_DeviceManufacturer, LOCALE_NEUTRAL, PLUGPLAY_PROPERTY_PERSISTENT},
-				DEVPROP_TYPE_STRING,
-				manufacturer,
-				(ULONG)(wcslen(manufacturer) * sizeof(WCHAR)) + sizeof(L'\0'),
-				FALSE,
-				NULL
-			},
-			{
-				{sizeof(WDF_DEVICE_PROPERTY_DATA), &DEVPKEY_Bluetooth_LastConnectedTime, LOCALE_NEUTRAL, PLUGPLAY_PROPERTY_PERSISTENT},
-				DEVPROP_TYPE_FILETIME,
-				&lastConnectionTime,
-				sizeof(LARGE_INTEGER),
-				FALSE,
-				NULL
-			},
 		};
 
-		//
-		// Set VID/PID according to device type
-		// 
-		switch (DeviceType)
-		{
-		case DS_DEVICE_TYPE_SIXAXIS:
-			entries[0].ValueData = &BTHPS3_SIXAXIS_VID;
-			entries[1].ValueData = &BTHPS3_SIXAXIS_PID;
-			break;
-		case DS_DEVICE_TYPE_NAVIGATION:
-			entries[0].ValueData = &BTHPS3_NAVIGATION_VID;
-			entries[1].ValueData = &BTHPS3_NAVIGATION_PID;
-			break;
-		case DS_DEVICE_TYPE_MOTION:
-			entries[0].ValueData = &BTHPS3_MOTION_VID;
-			entries[1].ValueData = &BTHPS3_MOTION_PID;
-			break;
-		case DS_DEVICE_TYPE_WIRELESS:
-			entries[0].ValueData = &BTHPS3_WIRELESS_VID;
-			entries[1].ValueData = &BTHPS3_WIRELESS_PID;
-			break;
-		case DS_DEVICE_TYPE_UNKNOWN:
-		default:  // NOLINT(clang-diagnostic-covered-switch-default)
-			status = STATUS_INVALID_PARAMETER;
-			break;
-		}
-
 		Pdo_DeviceProperty_Table properties;
 
 		properties.ItemCount = ARRAYSIZE(entries);
@@ -330,119 +358,10 @@ BthPS3_PDO_Create(
 		record.DeviceProperties = &properties;
 
 		//
-		// Prepare Hardware ID GUID segment and description based on device type
-		// 
-		switch (DeviceType)
-		{
-		case DS_DEVICE_TYPE_SIXAXIS:
-			record.Description = L"PLAYSTATION(R)3 Controller";
-			status = RtlStringFromGUID(&GUID_BUSENUM_BTHPS3_SIXAXIS,
-				&guidString
-			);
-			break;
-		case DS_DEVICE_TYPE_NAVIGATION:
-			record.Description = L"Navigation Controller";
-			status = RtlStringFromGUID(&GUID_BUSENUM_BTHPS3_NAVIGATION,
-				&guidString
-			);
-			break;
-		case DS_DEVICE_TYPE_MOTION:
-			record.Description = L"Motion Controller";
-			status = RtlStringFromGUID(&GUID_BUSENUM_BTHPS3_MOTION,
-				&guidString
-			);
-			break;
-		case DS_DEVICE_TYPE_WIRELESS:
-			record.Description = L"Wireless Controller";
-			status = RtlStringFromGUID(&GUID_BUSENUM_BTHPS3_WIRELESS,
-				&guidString
-			);
-			break;
-		case DS_DEVICE_TYPE_UNKNOWN:
-		default:  // NOLINT(clang-diagnostic-covered-switch-default)
-			status = STATUS_INVALID_PARAMETER;
-			break;
-		}
-
-		if (!NT_SUCCESS(status))
-		{
-			TraceError(
-				TRACE_BUSLOGIC,
-				"RtlStringFromGUID failed with status %!STATUS!",
-				status
-			);
-			break;
-		}
-
-        //
-        // Format string to build hardware ID with
-        // 
-        PCWSTR hardwareIdFormat = L"%ws\\%wZ&Dev&VID_%04X&PID_%04X";
-
-		//
-		// Build Hardware ID depending on device type
-		// 
-		switch (DeviceType)
-		{
-		case DS_DEVICE_TYPE_SIXAXIS:
-			status = RtlUnicodeStringPrintf(
-				&hardwareId,
-				hardwareIdFormat,
-				BthPS3BusEnumeratorName,
-				&guidString,
-				BTHPS3_SIXAXIS_VID,
-				BTHPS3_SIXAXIS_PID
-			);
-			break;
-		case DS_DEVICE_TYPE_NAVIGATION:
-			status = RtlUnicodeStringPrintf(
-				&hardwareId,
-				hardwareIdFormat,
-				BthPS3BusEnumeratorName,
-				&guidString,
-				BTHPS3_NAVIGATION_VID,
-				BTHPS3_NAVIGATION_PID
-			);
-			break;
-		case DS_DEVICE_TYPE_MOTION:
-			status = RtlUnicodeStringPrintf(
-				&hardwareId,
-				hardwareIdFormat,
-				BthPS3BusEnumeratorName,
-				&guidString,
-				BTHPS3_MOTION_VID,
-				BTHPS3_MOTION_PID
-			);
-			break;
-		case DS_DEVICE_TYPE_WIRELESS:
-			status = RtlUnicodeStringPrintf(
-				&hardwareId,
-				hardwareIdFormat,
-				BthPS3BusEnumeratorName,
-				&guidString,
-				BTHPS3_WIRELESS_VID,
-				BTHPS3_WIRELESS_PID
-			);
-			break;
-		case DS_DEVICE_TYPE_UNKNOWN:
-		default:  // NOLINT(clang-diagnostic-covered-switch-default)
-			status = STATUS_INVALID_PARAMETER;
-			break;
-		}
-
-		if (!NT_SUCCESS(status)) {
-			TraceError(
-				TRACE_BUSLOGIC,
-				"RtlUnicodeStringPrintf failed for hardwareId with status %!STATUS!",
-				status
-			);
-			break;
-		}
-
-		//
-		// Set Hardware ID previously built
+		// Identification pre-rendered at driver load
 		// 
-		record.HardwareIds[0] = hardwareId.Buffer;
+		record.Description = pTemplate->Description;
+		record.HardwareIds[0] = pTemplate->HardwareId;
 		record.HardwareIdsCount = 1;
 
 		//
@@ -451,26 +370,7 @@ BthPS3_PDO_Create(
 		if (rawPdo)
 		{
 			record.RawDevice = TRUE;
-
-			switch (DeviceType)
-			{
-			case DS_DEVICE_TYPE_SIXAXIS:
-				record.RawDeviceClassGuid = &GUID_DEVCLASS_BTHPS3_SIXAXIS;
-				break;
-			case DS_DEVICE_TYPE_NAVIGATION:
-				record.RawDeviceClassGuid = &GUID_DEVCLASS_BTHPS3_NAVIGATION;
-				break;
-			case DS_DEVICE_TYPE_MOTION:
-				record.RawDeviceClassGuid = &GUID_DEVCLASS_BTHPS3_MOTION;
-				break;
-			case DS_DEVICE_TYPE_WIRELESS:
-				record.RawDeviceClassGuid = &GUID_DEVCLASS_BTHPS3_WIRELESS;
-				break;
-			case DS_DEVICE_TYPE_UNKNOWN:
-			default:  // NOLINT(clang-diagnostic-covered-switch-default)
-				status = STATUS_INVALID_PARAMETER;
-				break;
-			}
+			record.RawDeviceClassGuid = pTemplate->RawDeviceClassGuid;
 		}
 
 		//
@@ -491,16 +391,17 @@ BthPS3_PDO_Create(
 		}
 
 		//
-		// Insert PDO in connection collection
+		// Insert PDO in clients table
 		// 
-		if (!NT_SUCCESS(status = WdfCollectionAdd(
-			Context->Header.Clients,
+		if (!NT_SUCCESS(status = BthPS3_PDO_ClientsTableInsert(
+			&Context->Header,
+			RemoteAddress,
 			device
 		)))
 		{
 			TraceError(
 				TRACE_BUSLOGIC,
-				"WdfCollectionAdd for PDO device object failed with status %!STATUS!",
+				"BthPS3_PDO_ClientsTableInsert for PDO device object failed with status %!STATUS!",
 				status
 			);
 			break;
@@ -529,34 +430,24 @@ BthPS3_PDO_Create(
 		pPdoCtx->DevCtxHdr = &Context->Header;
 		pPdoCtx->DeviceType = DeviceType;
 		pPdoCtx->SerialNumber = record.SerialNumber;
+		pPdoCtx->LastConnectionTime = lastConnectionTime;
+
+		//
+		// Keep for the deferred friendly name, truncation is acceptable
+		// 
+		(void)RtlStringCbCopyA(
+			pPdoCtx->RemoteName,
+			sizeof(pPdoCtx->RemoteName),
+			RemoteName
+		);
 
 		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
 		attributes.ParentObject = device;
 
-		PUCHAR pBuffer = NULL;
-		const size_t hwIdByteCount = (wcslen(hardwareId.Buffer) * sizeof(WCHAR)) + sizeof(L'\0');
-
 		//
 		// Save Hardware ID for later unplug
 		// 
-		if (!NT_SUCCESS(status = WdfMemoryCreate(
-			&attributes,
-			NonPagedPoolNx,
-			POOLTAG_BTHPS3,
-			hwIdByteCount,
-			&pPdoCtx->HardwareId,
-			(PVOID*)&pBuffer
-		)))
-		{
-			TraceError(
-				TRACE_BUSLOGIC,
-				"WdfMemoryCreate failed with status %!STATUS!",
-				status
-			);
-			break;
-		}
-
-		RtlCopyMemory(pBuffer, hardwareId.Buffer, hwIdByteCount);
+		pPdoCtx->HardwareId = pTemplate->HardwareId;
 
 		//
 		// Initialize HidControlChannel properties
@@ -646,6 +537,25 @@ BthPS3_PDO_Create(
 
 		pPdoCtx->HidInterruptChannel.ConnectionState = ConnectionStateInitialized;
 
+		//
+		// Initialize connection setup state machine
+		// 
+
+		if (!NT_SUCCESS(status = WdfSpinLockCreate(
+			&attributes,
+			&pPdoCtx->Connection.Lock
+		)))
+		{
+			TraceError(
+				TRACE_BUSLOGIC,
+				"WdfSpinLockCreate for Connection failed with status %!STATUS!",
+				status
+			);
+			break;
+		}
+
+		pPdoCtx->Connection.State = PdoConnectStateIdle;
+
 		//
 		// We're ready, expose interface
 		// 
@@ -653,11 +563,6 @@ BthPS3_PDO_Create(
 
 	} while (FALSE);
 
-	if (hKey)
-	{
-		WdfRegistryClose(hKey);
-	}
-
 	if (NT_SUCCESS(status))
 	{
 		EventWriteChildDeviceCreationSuccessful(
@@ -685,145 +590,701 @@ BthPS3_PDO_Create(
 }
 
 //
-// Retrieves an existing connection from connection list identified by BTH_ADDR
+// Writes the PnP properties not required for enumeration, runs once the 
+// PDO is started and the HID Control channel has been accepted
 // 
-_IRQL_requires_max_(PASSIVE_LEVEL)
-_Must_inspect_result_
-_Success_(return == STATUS_SUCCESS)
-NTSTATUS
-BthPS3_PDO_RetrieveByBthAddr(
-	_In_ PBTHPS3_SERVER_CONTEXT Context,
-	_In_ BTH_ADDR RemoteAddress,
-	_Outptr_result_maybenull_ PBTHPS3_PDO_CONTEXT* PdoContext
+#pragma code_seg("PAGE")
+_Use_decl_annotations_
+VOID
+BthPS3_PDO_EvtDeferredPropertiesWorkItem(
+	WDFWORKITEM WorkItem
 )
 {
-	NTSTATUS status = STATUS_NOT_FOUND;
+	NTSTATUS status;
+	PWSTR manufacturer = L"Nefarius Software Solutions e.U.";
 
-	FuncEntryArguments(
-		TRACE_BUSLOGIC,
-		"RemoteAddress=%012llX",
-		RemoteAddress
-	);
+	FuncEntry(TRACE_BUSLOGIC);
 
-    *PdoContext = NULL;
+	PAGED_CODE();
+
+	const WDFDEVICE device = WdfWorkItemGetParentObject(WorkItem);
+	const PBTHPS3_PDO_CONTEXT pPdoCtx = GetPdoContext(device);
 
-	WdfWaitLockAcquire(Context->Header.ClientsLock, NULL);
+	DECLARE_UNICODE_STRING_SIZE(remotenameWide, BTH_MAX_NAME_SIZE);
 
-	const ULONG itemCount = WdfCollectionGetCount(Context->Header.Clients);
+	//
+	// Convert remote name from narrow to wide
+	// 
+	if (!NT_SUCCESS(status = RtlUnicodeStringPrintf(
+		&remotenameWide,
+		L"%hs",
+		pPdoCtx->RemoteName
+	)))
+	{
+		TraceError(
+			TRACE_BUSLOGIC,
+			"RtlUnicodeStringPrintf failed with status %!STATUS!",
+			status
+		);
+	}
 
-	for (ULONG index = 0; index < itemCount; index++)
+	Pdo_DevicePropertyEntry entries[] =
 	{
-		const WDFDEVICE currentPdo = WdfCollectionGetItem(Context->Header.Clients, index);
-		const PBTHPS3_PDO_CONTEXT pPdoCtx = GetPdoContext(currentPdo);
+		{
+			{sizeof(WDF_DEVICE_PROPERTY_DATA), &DEVPKEY_Device_FriendlyName, LOCALE_NEUTRAL, PLUGPLAY_PROPERTY_PERSISTENT},
+			DEVPROP_TYPE_STRING,
+			remotenameWide.Buffer,
+			remotenameWide.Length + sizeof(L'\0'),
+			FALSE,
+			NULL
+		},
+		{
+			{sizeof(WDF_DEVICE_PROPERTY_DATA), &DEVPKEY_Bluetooth_DeviceManufacturer, LOCALE_NEUTRAL, PLUGPLAY_PROPERTY_PERSISTENT},
+			DEVPROP_TYPE_STRING,
+			manufacturer,
+			(ULONG)(wcslen(manufacturer) * sizeof(WCHAR)) + sizeof(L'\0'),
+			FALSE,
+			NULL
+		},
+		{
+			{sizeof(WDF_DEVICE_PROPERTY_DATA), &DEVPKEY_Bluetooth_LastConnectedTime, LOCALE_NEUTRAL, PLUGPLAY_PROPERTY_PERSISTENT},
+			DEVPROP_TYPE_FILETIME,
+			&pPdoCtx->LastConnectionTime,
+			sizeof(LARGE_INTEGER),
+			FALSE,
+			NULL
+		},
+	};
 
-		if (pPdoCtx->RemoteAddress == RemoteAddress)
+	//
+	// Skip the friendly name if it couldn't be converted, keep the description
+	// 
+	for (ULONG index = NT_SUCCESS(status) ? 0 : 1; index < ARRAYSIZE(entries); index++)
+	{
+		if (!NT_SUCCESS(status = WdfDeviceAssignProperty(
+			device,
+			&entries[index].DevicePropertyData,
+			entries[index].ValueType,
+			entries[index].ValueSize,
+			entries[index].ValueData
+		)))
 		{
-			TraceVerbose(
+			TraceError(
 				TRACE_BUSLOGIC,
-				"Found desired connection item in connection list"
+				"WdfDeviceAssignProperty (%u) failed with status %!STATUS!",
+				index,
+				status
 			);
-
-			status = STATUS_SUCCESS;
-			*PdoContext = pPdoCtx;
-			break;
 		}
 	}
 
-	WdfWaitLockRelease(Context->Header.ClientsLock);
-
-	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+	BthPS3_PDO_ConnectStage(pPdoCtx, L"PropertiesWritten");
 
-	return status;
+	FuncExitNoReturn(TRACE_BUSLOGIC);
 }
+#pragma code_seg()
 
 //
-// Unplugs the child device, frees context memory, frees allocated slot (serial number)
+// Drops one precondition of the deferred property writes
 // 
-_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
-BthPS3_PDO_Destroy(
-	_In_ PBTHPS3_DEVICE_CONTEXT_HEADER Context,
+BthPS3_PDO_DeferredPropertiesGateRelease(
 	_In_ PBTHPS3_PDO_CONTEXT PdoContext
 )
 {
-	FuncEntryArguments(
+	if (InterlockedDecrement(&PdoContext->DeferredPropertiesGates) == 0)
+	{
+		WdfWorkItemEnqueue(PdoContext->DeferredPropertiesWorkItem);
+	}
+}
+
+//
+// Reports a connection setup milestone relative to the incoming connect request
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_ConnectStage(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ PCWSTR Stage
+)
+{
+	LARGE_INTEGER frequency;
+	const LARGE_INTEGER now = KeQueryPerformanceCounter(&frequency);
+	const ULONGLONG elapsedUs =
+		(ULONGLONG)(now.QuadPart - PdoContext->ConnectStartTime.QuadPart) * 1000000 / (ULONGLONG)frequency.QuadPart;
+
+	TraceVerbose(
 		TRACE_BUSLOGIC,
-		"PdoContext=0x%p",
-		PdoContext
+		"Device %012llX reached stage %ws after %llu us",
+		PdoContext->RemoteAddress,
+		Stage,
+		elapsedUs
 	);
 
-	WdfWaitLockAcquire(Context->ClientsLock, NULL);
+	EventWriteConnectStage(NULL, PdoContext->RemoteAddress, Stage, elapsedUs);
+}
 
-	const WDFDEVICE device = WdfObjectContextGetObject(PdoContext);
-	const ULONG itemCount = WdfCollectionGetCount(Context->Clients);
+//
+// Keeps a PDO with both channels gone present for Timeout milliseconds so a 
+// reconnect can pick it up again, returns FALSE if it has to be destroyed now
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+BOOLEAN
+BthPS3_PDO_LingerStart(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ ULONG Timeout
+)
+{
+	FuncEntryArguments(TRACE_BUSLOGIC, "Timeout=%d", Timeout);
+
+	const PBTHPS3_PDO_CONNECTION pConnection = &PdoContext->Connection;
+	const WDFQUEUE queues[] =
+	{
+		PdoContext->Queues.HidControlReadRequests,
+		PdoContext->Queues.HidControlWriteRequests,
+		PdoContext->Queues.HidInterruptReadRequests,
+		PdoContext->Queues.HidInterruptReadBatchRequests,
+		PdoContext->Queues.HidInterruptWriteRequests
+	};
+
+	if (Timeout == 0)
+	{
+		FuncExitNoReturn(TRACE_BUSLOGIC);
+		return FALSE;
+	}
+
+	//
+	// Requests arriving meanwhile stay queued until the channels are back
+	// 
+	for (ULONG index = 0; index < ARRAYSIZE(queues); index++)
+	{
+		(void)WdfIoQueueReadyNotify(queues[index], NULL, NULL);
+	}
+
+	WdfSpinLockAcquire(pConnection->Lock);
+	pConnection->IsLingering = TRUE;
+	WdfSpinLockRelease(pConnection->Lock);
+
+	(void)WdfTimerStart(PdoContext->LingerTimer, WDF_REL_TIMEOUT_IN_MS(Timeout));
+
+	TraceInformation(
+		TRACE_BUSLOGIC,
+		"Device %012llX disconnected, keeping PDO for %d ms",
+		PdoContext->RemoteAddress,
+		Timeout
+	);
+
+	EventWriteChildDeviceLingering(NULL, PdoContext->RemoteAddress, Timeout);
+
+	FuncExitNoReturn(TRACE_BUSLOGIC);
+
+	return TRUE;
+}
+
+//
+// TRUE while the PDO awaits a reconnect with both channels gone
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+BthPS3_PDO_IsLingering(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	BOOLEAN isLingering;
+
+	WdfSpinLockAcquire(PdoContext->Connection.Lock);
+	isLingering = PdoContext->Connection.IsLingering;
+	WdfSpinLockRelease(PdoContext->Connection.Lock);
+
+	return isLingering;
+}
+
+//
+// Claims a lingering PDO for a new connection, returns FALSE if it isn't 
+// lingering (anymore) and the caller must not reuse it
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+BOOLEAN
+BthPS3_PDO_LingerReattach(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ LARGE_INTEGER ConnectStartTime
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	BOOLEAN isClaimed;
+	const PBTHPS3_PDO_CONNECTION pConnection = &PdoContext->Connection;
+
+	//
+	// A read that outlived the ring stop must not be re-submitted while still pending
+	// 
+	if (!BthPS3_PDO_InterruptReadRingIsIdle(PdoContext))
+	{
+		TraceError(
+			TRACE_BUSLOGIC,
+			"Device %012llX still has ring reads in flight, can't reattach",
+			PdoContext->RemoteAddress
+		);
+
+		FuncExitNoReturn(TRACE_BUSLOGIC);
+		return FALSE;
+	}
+
+	WdfSpinLockAcquire(pConnection->Lock);
+
+	isClaimed = pConnection->IsLingering;
+
+	if (isClaimed)
+	{
+		pConnection->IsLingering = FALSE;
+		pConnection->Flags = 0;
+		pConnection->State = PdoConnectStateIdle;
+		pConnection->StateEnteredTime = ConnectStartTime;
+		RtlZeroMemory(pConnection->StateMicroseconds, sizeof(pConnection->StateMicroseconds));
+	}
+
+	WdfSpinLockRelease(pConnection->Lock);
+
+	if (!isClaimed)
+	{
+		FuncExitNoReturn(TRACE_BUSLOGIC);
+		return FALSE;
+	}
+
+	//
+	// An already running expiry finds the PDO claimed and backs off
+	// 
+	(void)WdfTimerStop(PdoContext->LingerTimer, FALSE);
+
+	WdfSpinLockAcquire(PdoContext->HidControlChannel.ConnectionStateLock);
+	PdoContext->HidControlChannel.ConnectionState = ConnectionStateInitialized;
+	WdfSpinLockRelease(PdoContext->HidControlChannel.ConnectionStateLock);
+
+	WdfSpinLockAcquire(PdoContext->HidInterruptChannel.ConnectionStateLock);
+	PdoContext->HidInterruptChannel.ConnectionState = ConnectionStateInitialized;
+	WdfSpinLockRelease(PdoContext->HidInterruptChannel.ConnectionStateLock);
+
+	PdoContext->ConnectStartTime = ConnectStartTime;
+	KeQuerySystemTimePrecise(&PdoContext->LastConnectionTime);
+
+	//
+	// PnP start is long done, only HID Control acceptance gates the property update
+	// 
+	InterlockedExchange(&PdoContext->DeferredPropertiesGates, 1);
+
+	BthPS3_PDO_InterruptReadRingReset(PdoContext);
+
+	TraceInformation(
+		TRACE_BUSLOGIC,
+		"Device %012llX reconnected, reattaching to existing PDO",
+		PdoContext->RemoteAddress
+	);
+
+	EventWriteChildDeviceReattached(NULL, PdoContext->RemoteAddress);
+
+	FuncExitNoReturn(TRACE_BUSLOGIC);
+
+	return TRUE;
+}
+
+//
+// Linger period is over without a reconnect, unplug the PDO
+// 
+_Use_decl_annotations_
+VOID
+BthPS3_PDO_EvtLingerTimerFunc(
+	WDFTIMER Timer
+)
+{
+	FuncEntry(TRACE_BUSLOGIC);
+
+	BOOLEAN isExpired;
+	const WDFDEVICE device = WdfTimerGetParentObject(Timer);
+	const PBTHPS3_PDO_CONTEXT pPdoCtx = GetPdoContext(device);
+
+	WdfSpinLockAcquire(pPdoCtx->Connection.Lock);
 
-	for (ULONG index = 0; index < itemCount; index++)
+	isExpired = pPdoCtx->Connection.IsLingering;
+	pPdoCtx->Connection.IsLingering = FALSE;
+
+	WdfSpinLockRelease(pPdoCtx->Connection.Lock);
+
+	if (isExpired)
 	{
-		const WDFDEVICE currentPdo = WdfCollectionGetItem(Context->Clients, index);
+		TraceInformation(
+			TRACE_BUSLOGIC,
+			"Device %012llX didn't reconnect in time, removing PDO",
+			pPdoCtx->RemoteAddress
+		);
+
+		BthPS3_PDO_Destroy(pPdoCtx->DevCtxHdr, pPdoCtx);
+	}
 
-		if (currentPdo == device)
+	FuncExitNoReturn(TRACE_BUSLOGIC);
+}
+
+//
+// Maps a remote address to its home slot in the clients table
+// 
+ULONG
+BthPS3_PDO_ClientsTableHash(
+	_In_ BTH_ADDR RemoteAddress
+)
+{
+	//
+	// Fibonacci hashing, spreads the vendor-prefixed addresses evenly
+	// 
+	return (ULONG)((RemoteAddress * 0x9E3779B97F4A7C15ULL) >> (64 - BTHPS3_CLIENTS_TABLE_BITS));
+}
+
+//
+// Adds a child PDO to the clients table
+// 
+_IRQL_requires_max_(APC_LEVEL)
+NTSTATUS
+BthPS3_PDO_ClientsTableInsert(
+	_In_ PBTHPS3_DEVICE_CONTEXT_HEADER Context,
+	_In_ BTH_ADDR RemoteAddress,
+	_In_ WDFDEVICE Device
+)
+{
+	NTSTATUS status = STATUS_INSUFFICIENT_RESOURCES;
+	ULONG index = BthPS3_PDO_ClientsTableHash(RemoteAddress);
+
+	KeEnterCriticalRegion();
+	ExAcquirePushLockExclusive(&Context->ClientsLock);
+
+	//
+	// Never fill up completely so probing always hits a free slot
+	// 
+	if (Context->ClientsCount < BTHPS3_CLIENTS_TABLE_SIZE - 1)
+	{
+		for (;;)
 		{
-			const PBTHPS3_PDO_CONTEXT pPdoCtx = GetPdoContext(currentPdo);
-			const ULONG serial = pPdoCtx->SerialNumber;
-			WCHAR hardwareId[BTHPS3_MAX_DEVICE_ID_LEN];
+			const PBTHPS3_CLIENTS_TABLE_ENTRY pEntry = &Context->Clients[index];
 
-			//
-			// Make a copy for logging since the context memory gets destroyed on unplug
-			// 
-			wcscpy_s(
-				hardwareId,
-				sizeof(hardwareId) / sizeof(WCHAR),
-				(PWSTR)WdfMemoryGetBuffer(pPdoCtx->HardwareId, NULL)
-			);
+			if (pEntry->Device == NULL)
+			{
+				pEntry->RemoteAddress = RemoteAddress;
+				pEntry->Device = Device;
+				Context->ClientsCount++;
+				status = STATUS_SUCCESS;
+				break;
+			}
 
-			TraceVerbose(
-				TRACE_BUSLOGIC,
-				"Found desired connection item in connection list (serial: %d)",
-				serial
-			);
+			if (pEntry->RemoteAddress == RemoteAddress)
+			{
+				status = STATUS_OBJECT_NAME_COLLISION;
+				break;
+			}
 
-			//
-			// Do NOT use PBTHPS3_PDO_CONTEXT after this call as it gets destroyed!
-			// 
+			index = (index + 1) & (BTHPS3_CLIENTS_TABLE_SIZE - 1);
+		}
+	}
 
-			NTSTATUS status = DMF_Pdo_DeviceUnPlugEx(
-				Context->PdoModule,
-				hardwareId,
-				serial
-			);
+	ExReleasePushLockExclusive(&Context->ClientsLock);
+	KeLeaveCriticalRegion();
+
+	return status;
+}
+
+//
+// Looks up the child PDO of a remote address, STATUS_NOT_FOUND if not present 
+// and STATUS_DELETE_PENDING while it gets unplugged
+// 
+_IRQL_requires_max_(APC_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+BthPS3_PDO_ClientsTableLookup(
+	_In_ PBTHPS3_DEVICE_CONTEXT_HEADER Context,
+	_In_ BTH_ADDR RemoteAddress,
+	_Out_ WDFDEVICE* Device
+)
+{
+	NTSTATUS status = STATUS_NOT_FOUND;
+	ULONG index = BthPS3_PDO_ClientsTableHash(RemoteAddress);
+
+	*Device = NULL;
+
+	KeEnterCriticalRegion();
+	ExAcquirePushLockShared(&Context->ClientsLock);
+
+	for (;;)
+	{
+		const PBTHPS3_CLIENTS_TABLE_ENTRY pEntry = &Context->Clients[index];
 
-			if (!NT_SUCCESS(status))
+		if (pEntry->Device == NULL)
+		{
+			break;
+		}
+
+		if (pEntry->RemoteAddress == RemoteAddress)
+		{
+			if (pEntry->IsRemoving)
 			{
-				TraceError(
-					TRACE_BUSLOGIC,
-					"DMF_Pdo_DeviceUnPlugEx failed with status %!STATUS!",
-					status
-				);
-
-				EventWriteChildDeviceDestructionFailed(
-					NULL,
-					serial,
-					hardwareId,
-					status
-				);
+				status = STATUS_DELETE_PENDING;
 			}
 			else
 			{
-				EventWriteChildDeviceDestructionSuccessful(
-					NULL,
-					serial,
-					hardwareId,
-					status
-				);
+				*Device = pEntry->Device;
+				status = STATUS_SUCCESS;
 			}
+			break;
+		}
+
+		index = (index + 1) & (BTHPS3_CLIENTS_TABLE_SIZE - 1);
+	}
+
+	ExReleasePushLockShared(&Context->ClientsLock);
+	KeLeaveCriticalRegion();
+
+	return status;
+}
+
+//
+// Flags a child PDO as being unplugged, keeping its entry occupied so a reconnect 
+// of the same address can't plug a duplicate meanwhile; returns FALSE if it wasn't 
+// present or is already being unplugged
+// 
+_IRQL_requires_max_(APC_LEVEL)
+BOOLEAN
+BthPS3_PDO_ClientsTableMarkRemoving(
+	_In_ PBTHPS3_DEVICE_CONTEXT_HEADER Context,
+	_In_ BTH_ADDR RemoteAddress,
+	_In_ WDFDEVICE Device
+)
+{
+	BOOLEAN marked = FALSE;
+	ULONG index = BthPS3_PDO_ClientsTableHash(RemoteAddress);
+
+	KeEnterCriticalRegion();
+	ExAcquirePushLockExclusive(&Context->ClientsLock);
 
-			WdfCollectionRemoveItem(Context->Clients, index);
+	for (;;)
+	{
+		const PBTHPS3_CLIENTS_TABLE_ENTRY pEntry = &Context->Clients[index];
 
+		if (pEntry->Device == NULL)
+		{
 			break;
 		}
+
+		if (pEntry->RemoteAddress == RemoteAddress)
+		{
+			if (pEntry->Device == Device && !pEntry->IsRemoving)
+			{
+				pEntry->IsRemoving = TRUE;
+				marked = TRUE;
+			}
+			break;
+		}
+
+		index = (index + 1) & (BTHPS3_CLIENTS_TABLE_SIZE - 1);
+	}
+
+	ExReleasePushLockExclusive(&Context->ClientsLock);
+	KeLeaveCriticalRegion();
+
+	return marked;
+}
+
+//
+// Removes a child PDO from the clients table, returns FALSE if it wasn't present
+// 
+_IRQL_requires_max_(APC_LEVEL)
+BOOLEAN
+BthPS3_PDO_ClientsTableRemove(
+	_In_ PBTHPS3_DEVICE_CONTEXT_HEADER Context,
+	_In_ BTH_ADDR RemoteAddress,
+	_In_ WDFDEVICE Device
+)
+{
+	BOOLEAN removed = FALSE;
+	const ULONG mask = BTHPS3_CLIENTS_TABLE_SIZE - 1;
+	ULONG index = BthPS3_PDO_ClientsTableHash(RemoteAddress);
+
+	KeEnterCriticalRegion();
+	ExAcquirePushLockExclusive(&Context->ClientsLock);
+
+	for (;;)
+	{
+		const PBTHPS3_CLIENTS_TABLE_ENTRY pEntry = &Context->Clients[index];
+
+		if (pEntry->Device == NULL)
+		{
+			break;
+		}
+
+		if (pEntry->RemoteAddress == RemoteAddress)
+		{
+			removed = (pEntry->Device == Device);
+			break;
+		}
+
+		index = (index + 1) & mask;
+	}
+
+	if (removed)
+	{
+		ULONG hole = index;
+
+		//
+		// Backward-shift deletion, moves displaced successors into the hole 
+		// so lookups never stop early and no tombstones are needed
+		// 
+		for (ULONG next = (hole + 1) & mask; Context->Clients[next].Device != NULL; next = (next + 1) & mask)
+		{
+			const ULONG home = BthPS3_PDO_ClientsTableHash(Context->Clients[next].RemoteAddress);
+
+			//
+			// Entry may stay if its home slot lies cyclically within (hole, next]
+			// 
+			if (((next - home) & mask) < ((next - hole) & mask))
+			{
+				continue;
+			}
+
+			Context->Clients[hole] = Context->Clients[next];
+			hole = next;
+		}
+
+		Context->Clients[hole].RemoteAddress = 0;
+		Context->Clients[hole].Device = NULL;
+		Context->Clients[hole].IsRemoving = FALSE;
+		Context->ClientsCount--;
+	}
+
+	ExReleasePushLockExclusive(&Context->ClientsLock);
+	KeLeaveCriticalRegion();
+
+	return removed;
+}
+
+//
+// Retrieves an existing connection from connection list identified by BTH_ADDR
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+_Success_(return == STATUS_SUCCESS)
+NTSTATUS
+BthPS3_PDO_RetrieveByBthAddr(
+	_In_ PBTHPS3_SERVER_CONTEXT Context,
+	_In_ BTH_ADDR RemoteAddress,
+	_Outptr_result_maybenull_ PBTHPS3_PDO_CONTEXT* PdoContext
+)
+{
+	NTSTATUS status;
+	WDFDEVICE device;
+
+	FuncEntryArguments(
+		TRACE_BUSLOGIC,
+		"RemoteAddress=%012llX",
+		RemoteAddress
+	);
+
+    *PdoContext = NULL;
+
+	if (NT_SUCCESS(status = BthPS3_PDO_ClientsTableLookup(&Context->Header, RemoteAddress, &device)))
+	{
+		TraceVerbose(
+			TRACE_BUSLOGIC,
+			"Found desired connection item in connection list"
+		);
+
+		*PdoContext = GetPdoContext(device);
 	}
 
-	WdfWaitLockRelease(Context->ClientsLock);
+	FuncExit(TRACE_BUSLOGIC, "status=%!STATUS!", status);
+
+	return status;
+}
+
+//
+// Unplugs the child device, frees context memory, frees allocated slot (serial number)
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+BthPS3_PDO_Destroy(
+	_In_ PBTHPS3_DEVICE_CONTEXT_HEADER Context,
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	FuncEntryArguments(
+		TRACE_BUSLOGIC,
+		"PdoContext=0x%p",
+		PdoContext
+	);
+
+	const WDFDEVICE device = WdfObjectContextGetObject(PdoContext);
+
+	//
+	// Only the caller flagging the table entry may unplug, guards against double destruction
+	// 
+	if (!BthPS3_PDO_ClientsTableMarkRemoving(Context, PdoContext->RemoteAddress, device))
+	{
+		FuncExitNoReturn(TRACE_BUSLOGIC);
+		return;
+	}
+
+	const BTH_ADDR remoteAddress = PdoContext->RemoteAddress;
+	const ULONG serial = PdoContext->SerialNumber;
+
+	//
+	// Points into the template table, stays valid after the context memory is gone
+	// 
+	const PWSTR hardwareId = PdoContext->HardwareId;
+
+	//
+	// Device is gone for good, no more reports to expect
+	//
+	BthPS3_PDO_MailboxRelease(PdoContext, NULL, STATUS_DEVICE_NOT_CONNECTED);
+
+	TraceVerbose(
+		TRACE_BUSLOGIC,
+		"Found desired connection item in connection list (serial: %d)",
+		serial
+	);
+
+	//
+	// Do NOT use PBTHPS3_PDO_CONTEXT after this call as it gets destroyed!
+	// 
+
+	NTSTATUS status = DMF_Pdo_DeviceUnPlugEx(
+		Context->PdoModule,
+		hardwareId,
+		serial
+	);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceError(
+			TRACE_BUSLOGIC,
+			"DMF_Pdo_DeviceUnPlugEx failed with status %!STATUS!",
+			status
+		);
+
+		EventWriteChildDeviceDestructionFailed(
+			NULL,
+			serial,
+			hardwareId,
+			status
+		);
+	}
+	else
+	{
+		EventWriteChildDeviceDestructionSuccessful(
+			NULL,
+			serial,
+			hardwareId,
+			status
+		);
+	}
+
+	//
+	// Old PDO is gone, the address may connect again; the handle is only compared
+	// 
+	(void)BthPS3_PDO_ClientsTableRemove(Context, remoteAddress, device);
 
 	FuncExitNoReturn(TRACE_BUSLOGIC);
 }
@@ -894,5 +1355,9 @@ BthPS3_PDO_EvtContextCleanup(
 		pPdoCtx, Object
 	);
 
+	BthPS3_PDO_InterruptReadRingStop(pPdoCtx);
+
+	BthPS3_PDO_BrbPoolFree(pPdoCtx);
+
 	FuncExitNoReturn(TRACE_BUSLOGIC);
 }
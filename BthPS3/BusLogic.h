@@ -40,8 +40,12 @@
 
 #define MAX_DEVICE_ID_LEN				200
 #define BTH_ADDR_HEX_LEN				12
+#define REG_CACHED_DEVICES_KEY			L"Devices"
 #define REG_CACHED_DEVICE_KEY_FMT		L"Devices\\%012llX"
 #define REG_CACHED_DEVICE_KEY_FMT_LEN	(8 + BTHPS3_BTH_ADDR_MAX_CHARS)
+#define BTHPS3_PDO_BRB_POOL_SIZE		16
+#define BTHPS3_PDO_READ_RING_MAX_SIZE	64
+#define BTHPS3_PDO_READ_RING_MAX_ERRORS	8
 
 
 //
@@ -58,6 +62,78 @@ typedef enum _BTHPS3_CONNECTION_STATE {
 
 } BTHPS3_CONNECTION_STATE, *PBTHPS3_CONNECTION_STATE;
 
+//
+// Connection setup progress of a PDO, derived from the BTHPS3_PDO_CONNECT_* flags 
+// since HID Control and HID Interrupt acceptance may complete in any order
+// 
+typedef enum _BTHPS3_PDO_CONNECT_STATE
+{
+    //
+    // HID Control connection request not answered yet
+    // 
+    PdoConnectStateIdle = 0,
+
+    //
+    // HID Control accepted, awaiting the remote confirmation
+    // 
+    PdoConnectStateControlPending,
+
+    //
+    // HID Control up, awaiting the HID Interrupt connection request
+    // 
+    PdoConnectStateAwaitingInterrupt,
+
+    //
+    // HID Interrupt accepted, awaiting the remote confirmation
+    // 
+    PdoConnectStateInterruptPending,
+
+    //
+    // Both channels up
+    // 
+    PdoConnectStateOnline,
+
+    PdoConnectStateMax
+
+} BTHPS3_PDO_CONNECT_STATE, *PBTHPS3_PDO_CONNECT_STATE;
+
+#define BTHPS3_PDO_CONNECT_CONTROL_PENDING      0x01
+#define BTHPS3_PDO_CONNECT_CONTROL_UP           0x02
+#define BTHPS3_PDO_CONNECT_INTERRUPT_PENDING    0x04
+#define BTHPS3_PDO_CONNECT_INTERRUPT_UP         0x08
+//
+// HID Interrupt response BRB already prepared, only the channel handle is missing
+// 
+#define BTHPS3_PDO_CONNECT_INTERRUPT_STAGED     0x10
+
+typedef struct _BTHPS3_PDO_CONNECTION
+{
+    //
+    // Protects all fields and the pre-staged HID Interrupt BRB
+    // 
+    WDFSPINLOCK Lock;
+
+    ULONG Flags;
+
+    BTHPS3_PDO_CONNECT_STATE State;
+
+    //
+    // Performance counter value of the last state change
+    // 
+    LARGE_INTEGER StateEnteredTime;
+
+    //
+    // Time spent in each state while setting up the connection
+    // 
+    ULONG64 StateMicroseconds[PdoConnectStateMax];
+
+    //
+    // Both channels gone, PDO kept present until the linger timer expires or the remote reconnects
+    // 
+    BOOLEAN IsLingering;
+
+} BTHPS3_PDO_CONNECTION, *PBTHPS3_PDO_CONNECTION;
+
 //
 // State information for a single L2CAP channel
 // 
@@ -77,6 +153,185 @@ typedef struct _BTHPS3_CLIENT_L2CAP_CHANNEL
 
 } BTHPS3_CLIENT_L2CAP_CHANNEL, *PBTHPS3_CLIENT_L2CAP_CHANNEL;
 
+//
+// Pre-allocated ACL transfer BRBs recycled between HID channel transfers
+// 
+typedef struct _BTHPS3_BRB_POOL
+{
+	//
+	// Interface used to allocate, reuse and free BRBs
+	// 
+	PBTH_PROFILE_DRIVER_INTERFACE ProfileDrvInterface;
+
+	//
+	// Protects Entries and Count
+	// 
+	WDFSPINLOCK Lock;
+
+	//
+	// Stack of currently unused BRBs
+	// 
+	struct _BRB_L2CA_ACL_TRANSFER* Entries[BTHPS3_PDO_BRB_POOL_SIZE];
+
+	ULONG Count;
+
+	//
+	// Transfers served from the pool
+	// 
+	LONG64 Hits;
+
+	//
+	// Transfers which had to allocate a new BRB
+	// 
+	LONG64 Misses;
+
+} BTHPS3_BRB_POOL, *PBTHPS3_BRB_POOL;
+
+//
+// A single buffered HID Interrupt input report
+// 
+typedef struct _BTHPS3_HID_INPUT_REPORT_SLOT
+{
+	LARGE_INTEGER Timestamp;
+
+	ULONG Length;
+
+	UCHAR Data[BTHPS3_SIXAXIS_HID_INPUT_REPORT_SIZE];
+
+} BTHPS3_HID_INPUT_REPORT_SLOT, *PBTHPS3_HID_INPUT_REPORT_SLOT;
+
+//
+// Driver-owned HID Interrupt reads and the ring buffer they complete into
+// 
+typedef struct _BTHPS3_INTERRUPT_READ_RING
+{
+	//
+	// Number of slots and outstanding reads, 0 if disabled
+	// 
+	ULONG Size;
+
+	//
+	// Protects Slots, Head and Count
+	// 
+	WDFSPINLOCK Lock;
+
+	//
+	// Report slots
+	// 
+	PBTHPS3_HID_INPUT_REPORT_SLOT Slots;
+
+	//
+	// Oldest filled slot
+	// 
+	ULONG Head;
+
+	//
+	// Number of filled slots
+	// 
+	ULONG Count;
+
+	//
+	// Driver-owned read requests
+	// 
+	WDFREQUEST* Requests;
+
+	//
+	// Number of reads currently sent to the radio
+	// 
+	volatile LONG Outstanding;
+
+	//
+	// Signalled once no reads are outstanding
+	// 
+	KEVENT IdleEvent;
+
+	//
+	// Set on clean-up, stops reads from getting re-submitted
+	// 
+	volatile LONG IsStopping;
+
+	//
+	// Failed reads in a row, reads are retired once BTHPS3_PDO_READ_RING_MAX_ERRORS is reached
+	// 
+	volatile LONG ConsecutiveErrors;
+
+	//
+	// Reports dropped because the ring was full
+	// 
+	LONG64 Overruns;
+
+	//
+	// Only keep the most recent report
+	// 
+	BOOLEAN IsCoalescing;
+
+	//
+	// Reports replaced by a newer one in coalescing mode
+	// 
+	LONG64 Coalesced;
+
+} BTHPS3_INTERRUPT_READ_RING, *PBTHPS3_INTERRUPT_READ_RING;
+
+//
+// Input report mailbox shared with a user-mode consumer
+// 
+typedef struct _BTHPS3_REPORT_MAILBOX
+{
+	//
+	// Protects the members below and serializes writers
+	// 
+	WDFSPINLOCK Lock;
+
+	//
+	// System address of the locked consumer buffer, NULL if not registered
+	// 
+	PBTHPS3_HID_INPUT_REPORT_MAILBOX Shared;
+
+	//
+	// Optional event signalled on update
+	// 
+	PKEVENT Event;
+
+	//
+	// Pending request owning the consumer buffer
+	// 
+	WDFREQUEST Request;
+
+	//
+	// Handle the registration request was issued on, released on its clean-up
+	// 
+	WDFFILEOBJECT FileObject;
+
+} BTHPS3_REPORT_MAILBOX, *PBTHPS3_REPORT_MAILBOX;
+
+//
+// Identification of a child device type, see G_PDO_Templates
+// 
+typedef struct _BTHPS3_PDO_TEMPLATE
+{
+	//
+	// Bus GUID segment of the hardware ID
+	// 
+	const GUID* BusGuid;
+
+	//
+	// Setup class if exposed as RAW device
+	// 
+	const GUID* RawDeviceClassGuid;
+
+	PUSHORT VendorId;
+
+	PUSHORT ProductId;
+
+	PWSTR Description;
+
+	//
+	// Rendered once on driver load
+	// 
+	WCHAR HardwareId[BTHPS3_MAX_DEVICE_ID_LEN];
+
+} BTHPS3_PDO_TEMPLATE, * PBTHPS3_PDO_TEMPLATE;
+
 //
 // PDO context object holding all state information per child device
 // 
@@ -92,11 +347,46 @@ typedef struct _BTHPS3_PDO_CONTEXT
 
 	BTHPS3_CLIENT_L2CAP_CHANNEL HidInterruptChannel;
 
+	BTHPS3_PDO_CONNECTION Connection;
+
 	DMFMODULE DmfModuleIoctlHandler;
 
 	ULONG SerialNumber;
 
-	WDFMEMORY HardwareId;
+	PWSTR HardwareId;
+
+	BTHPS3_BRB_POOL BrbPool;
+
+	BTHPS3_INTERRUPT_READ_RING InterruptReadRing;
+
+	BTHPS3_REPORT_MAILBOX Mailbox;
+
+	//
+	// Reported remote name, applied as friendly name after the channels are up
+	// 
+	CHAR RemoteName[BTH_MAX_NAME_SIZE];
+
+	LARGE_INTEGER LastConnectionTime;
+
+	//
+	// Performance counter value of the incoming connect request, origin of the ConnectStage events
+	// 
+	LARGE_INTEGER ConnectStartTime;
+
+	//
+	// Writes the properties not needed for enumeration off the connect path
+	// 
+	WDFWORKITEM DeferredPropertiesWorkItem;
+
+	//
+	// Held by PnP start and control channel acceptance, last one out queues the work item
+	// 
+	volatile LONG DeferredPropertiesGates;
+
+	//
+	// Removes a disconnected PDO once its linger period is over
+	// 
+	WDFTIMER LingerTimer;
 
 	struct
 	{
@@ -106,6 +396,8 @@ typedef struct _BTHPS3_PDO_CONTEXT
 
 		WDFQUEUE HidInterruptReadRequests;
 
+		WDFQUEUE HidInterruptReadBatchRequests;
+
 		WDFQUEUE HidInterruptWriteRequests;
 
 	} Queues;
@@ -114,6 +406,37 @@ typedef struct _BTHPS3_PDO_CONTEXT
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(BTHPS3_PDO_CONTEXT, GetPdoContext)
 
+//
+// Context of a driver-owned HID Interrupt read request
+// 
+typedef struct _BTHPS3_RING_READ_CONTEXT
+{
+	PBTHPS3_PDO_CONTEXT PdoContext;
+
+	struct _BRB_L2CA_ACL_TRANSFER Brb;
+
+	WDFMEMORY BrbMemory;
+
+	UCHAR Buffer[BTHPS3_SIXAXIS_HID_INPUT_REPORT_SIZE];
+
+} BTHPS3_RING_READ_CONTEXT, *PBTHPS3_RING_READ_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(BTHPS3_RING_READ_CONTEXT, GetRingReadContext)
+
+//
+// Context of a mailbox registration request, filled in the caller's context
+// 
+typedef struct _BTHPS3_MAILBOX_REQUEST_CONTEXT
+{
+	//
+	// Referenced notification event, NULL once owned by the mailbox
+	// 
+	PKEVENT Event;
+
+} BTHPS3_MAILBOX_REQUEST_CONTEXT, *PBTHPS3_MAILBOX_REQUEST_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(BTHPS3_MAILBOX_REQUEST_CONTEXT, GetMailboxRequestContext)
+
 
 VOID
 FORCEINLINE
@@ -134,6 +457,18 @@ CLIENT_CONNECTION_REQUEST_REUSE(
 // PDO lifecycle
 // 
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_TemplatesInit(
+	VOID
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+PBTHPS3_PDO_TEMPLATE
+BthPS3_PDO_TemplateGet(
+	_In_ DS_DEVICE_TYPE DeviceType
+);
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 _Must_inspect_result_
 _Success_(return == STATUS_SUCCESS)
@@ -163,6 +498,81 @@ BthPS3_PDO_Destroy(
 	_In_ PBTHPS3_PDO_CONTEXT PdoContext
 );
 
+ULONG
+BthPS3_PDO_ClientsTableHash(
+	_In_ BTH_ADDR RemoteAddress
+);
+
+_IRQL_requires_max_(APC_LEVEL)
+NTSTATUS
+BthPS3_PDO_ClientsTableInsert(
+	_In_ PBTHPS3_DEVICE_CONTEXT_HEADER Context,
+	_In_ BTH_ADDR RemoteAddress,
+	_In_ WDFDEVICE Device
+);
+
+_IRQL_requires_max_(APC_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+BthPS3_PDO_ClientsTableLookup(
+	_In_ PBTHPS3_DEVICE_CONTEXT_HEADER Context,
+	_In_ BTH_ADDR RemoteAddress,
+	_Out_ WDFDEVICE* Device
+);
+
+_IRQL_requires_max_(APC_LEVEL)
+BOOLEAN
+BthPS3_PDO_ClientsTableMarkRemoving(
+	_In_ PBTHPS3_DEVICE_CONTEXT_HEADER Context,
+	_In_ BTH_ADDR RemoteAddress,
+	_In_ WDFDEVICE Device
+);
+
+_IRQL_requires_max_(APC_LEVEL)
+BOOLEAN
+BthPS3_PDO_ClientsTableRemove(
+	_In_ PBTHPS3_DEVICE_CONTEXT_HEADER Context,
+	_In_ BTH_ADDR RemoteAddress,
+	_In_ WDFDEVICE Device
+);
+
+EVT_WDF_WORKITEM BthPS3_PDO_EvtDeferredPropertiesWorkItem;
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_DeferredPropertiesGateRelease(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_ConnectStage(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ PCWSTR Stage
+);
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+BOOLEAN
+BthPS3_PDO_LingerStart(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ ULONG Timeout
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+BthPS3_PDO_IsLingering(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+);
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+BOOLEAN
+BthPS3_PDO_LingerReattach(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ LARGE_INTEGER ConnectStartTime
+);
+
+EVT_WDF_TIMER BthPS3_PDO_EvtLingerTimerFunc;
+
 //
 // Clean-up
 // 
@@ -195,12 +605,28 @@ EVT_DMF_IoctlHandler_Callback BthPS3_PDO_HandleHidInterruptRead;
 
 EVT_DMF_IoctlHandler_Callback BthPS3_PDO_HandleHidInterruptWrite;
 
+EVT_DMF_IoctlHandler_Callback BthPS3_PDO_HandleHidInterruptReadBatch;
+
+EVT_DMF_IoctlHandler_Callback BthPS3_PDO_HandleHidInterruptSetCoalescing;
+
+EVT_DMF_IoctlHandler_Callback BthPS3_PDO_HandleHidInterruptMapMailbox;
+
 EVT_DMF_IoctlHandler_Callback BthPS3_PDO_HandleBthDisconnect;
 
 //
 // Process requests once queued
 // 
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+BthPS3_PDO_RetrieveTransferBuffer(
+	_In_ WDFREQUEST Request,
+	_In_ BOOLEAN IsWrite,
+	_Outptr_result_maybenull_ PVOID* Buffer,
+	_Outptr_result_maybenull_ PMDL* Mdl,
+	_Out_ size_t* Length
+);
+
 EVT_WDF_IO_QUEUE_STATE BthPS3_PDO_DispatchHidControlRead;
 
 EVT_WDF_IO_QUEUE_STATE BthPS3_PDO_DispatchHidControlWrite;
@@ -209,22 +635,183 @@ EVT_WDF_IO_QUEUE_STATE BthPS3_PDO_DispatchHidInterruptRead;
 
 EVT_WDF_IO_QUEUE_STATE BthPS3_PDO_DispatchHidInterruptWrite;
 
+EVT_WDF_IO_QUEUE_STATE BthPS3_PDO_DispatchHidInterruptReadBatch;
+
 //
 // PNP/Power
 // 
 
 EVT_WDF_DEVICE_SELF_MANAGED_IO_INIT BthPS3_PDO_SelfManagedIoInit;
 
+EVT_WDF_DEVICE_SELF_MANAGED_IO_FLUSH BthPS3_PDO_SelfManagedIoFlush;
+
+EVT_WDF_FILE_CLEANUP BthPS3_PDO_EvtFileCleanup;
+
+EVT_WDF_IO_IN_CALLER_CONTEXT BthPS3_PDO_EvtIoInCallerContext;
+
 //
 // I/O completion
 // 
 
 EVT_WDF_REQUEST_COMPLETION_ROUTINE BthPS3_PDO_DisconnectRequestCompleted;
 
+//
+// BRB pool
+// 
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_BrbPoolInit(
+	_In_ WDFDEVICE Device,
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+struct _BRB_L2CA_ACL_TRANSFER*
+BthPS3_PDO_BrbPoolAcquire(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_BrbPoolRelease(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ struct _BRB_L2CA_ACL_TRANSFER* Brb
+);
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+BthPS3_PDO_BrbPoolFree(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+);
+
+//
+// HID Interrupt read ring
+// 
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_InterruptReadRingInit(
+	_In_ WDFDEVICE Device,
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ ULONG Size
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+BthPS3_PDO_InterruptReadRingSubmit(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ WDFREQUEST Request
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_InterruptReadRingStart(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+);
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+BthPS3_PDO_InterruptReadRingStop(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+BthPS3_PDO_InterruptReadRingIsIdle(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_InterruptReadRingReset(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_InterruptReadRingDrain(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+BthPS3_PDO_InterruptReadRingSetCoalescing(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ BOOLEAN IsEnabled
+);
+
+EVT_WDF_REQUEST_COMPLETION_ROUTINE BthPS3_PDO_InterruptReadRingCompleted;
+
+//
+// Input report mailbox
+// 
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_MailboxInit(
+	_In_ WDFDEVICE Device,
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+WDFREQUEST
+BthPS3_PDO_MailboxDetach(
+	_In_ PBTHPS3_REPORT_MAILBOX Mailbox,
+	_In_opt_ WDFREQUEST Request,
+	_In_opt_ WDFFILEOBJECT FileObject,
+	_Outptr_result_maybenull_ PKEVENT* Event
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_MailboxRelease(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_opt_ WDFFILEOBJECT FileObject,
+	_In_ NTSTATUS Status
+);
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_MailboxReferenceEvent(
+	_In_ WDFREQUEST Request
+);
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_MailboxRegister(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ WDFREQUEST Request,
+	_In_ PBTHPS3_HID_INTERRUPT_MAP_MAILBOX Parameters,
+	_In_ PBTHPS3_HID_INPUT_REPORT_MAILBOX Shared
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3_PDO_MailboxPublish(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext,
+	_In_ LARGE_INTEGER Timestamp,
+	_In_reads_bytes_(Length) PVOID Buffer,
+	_In_ ULONG Length
+);
+
+EVT_WDF_REQUEST_CANCEL BthPS3_PDO_MailboxRequestCancel;
+
+EVT_WDF_OBJECT_CONTEXT_CLEANUP BthPS3_PDO_MailboxRequestContextCleanup;
+
 //
 // Registry operations
 // 
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3_PDO_SlotCacheLoad(
+	PBTHPS3_DEVICE_CONTEXT_HEADER Header,
+	WDFKEY ParametersKey
+);
+
+EVT_WDF_WORKITEM BthPS3_PDO_EvtSlotCacheWriteBack;
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
 BthPS3_PDO_QuerySlot(
@@ -313,6 +313,22 @@ void BthPS3_EnablePatchEvtWdfTimer(
     }
 }
 
+//
+// Timed lift of per-device filter exclusions
+// 
+void BthPS3_ExclusionExpiryEvtWdfTimer(
+    WDFTIMER Timer
+)
+{
+    PBTHPS3_SERVER_CONTEXT devCtx = GetServerDeviceContext(WdfTimerGetParentObject(Timer));
+
+    TraceVerbose(TRACE_DEVICE,
+        "Lifting lapsed filter exclusions"
+    );
+
+    BthPS3PSM_ExpireExclusionsSync(devCtx);
+}
+
 //
 // Gets invoked on device power-up
 // 
@@ -347,10 +363,17 @@ BthPS3_EvtWdfDeviceSelfManagedIoInit(
             break;
         }
 
+        //
+        // Pick up registry changes without re-reading on every connection
+        // 
+        (void)BthPS3_SettingsNotifyStart(devCtx);
+
+        const PBTHPS3_SETTINGS pSettings = BthPS3_SettingsAcquire(devCtx);
+
         //
         // Attempt to enable, but ignore failure
         //
-        if (devCtx->Settings.AutoEnableFilter)
+        if (pSettings->AutoEnableFilter)
         {
             (void)BthPS3PSM_EnablePatchSync(
                 devCtx->PsmFilter.IoTarget,
@@ -358,6 +381,19 @@ BthPS3_EvtWdfDeviceSelfManagedIoInit(
             );
         }
 
+        //
+        // Drop exclusions left over from a previous instance, ignore failure
+        // 
+        (void)BthPS3PSM_SetPatchScopeSync(
+            devCtx->PsmFilter.IoTarget,
+            0,
+            BTHPS3PSM_PATCH_SCOPE_ALL,
+            NULL,
+            0
+        );
+
+        BthPS3_SettingsRelease(pSettings);
+
     } while (FALSE);
 
     FuncExit(TRACE_DEVICE, "status=%!STATUS!", status);
@@ -381,6 +417,8 @@ BthPS3_EvtWdfDeviceSelfManagedIoCleanup(
 
     FuncEntry(TRACE_DEVICE);
 
+    BthPS3_SettingsNotifyStop(devCtx);
+
     if (devCtx->PsmFilter.IoTarget != NULL)
     {
         WdfIoTargetClose(devCtx->PsmFilter.IoTarget);
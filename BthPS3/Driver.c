@@ -120,6 +120,20 @@ DriverEntry(
         return status;
     }
 
+    //
+    // Child device identification is static, render it once instead of on every connect
+    // 
+    if (!NT_SUCCESS(status = BthPS3_PDO_TemplatesInit()))
+    {
+        TraceError(
+            TRACE_DRIVER,
+            "BthPS3_PDO_TemplatesInit failed %!STATUS!",
+            status
+        );
+        WPP_CLEANUP(DriverObject);
+        return status;
+    }
+
     //
     // Dynamically check if WppRecorder::imp_WppRecorderReplay is available
     // 
@@ -51,11 +51,11 @@
 
 #include "device.h"
 #include "trace.h"
+#include "NameMatcher.h"
 #include "Bluetooth.h"
 #include "PSM.h"
 #include "L2CAP.h"
 #include "BusLogic.h"
-#include "Util.h"
 
 EXTERN_C_START
 
@@ -39,6 +39,23 @@
 #include "L2CAP.Connect.tmh"
 #include "BthPS3ETW.h"
 
+//
+// Samples the channel state under its lock
+// 
+static BOOLEAN
+L2CAP_PS3_IsChannelDisconnected(
+    _In_ PBTHPS3_CLIENT_L2CAP_CHANNEL Channel
+)
+{
+    BOOLEAN isDisconnected;
+
+    WdfSpinLockAcquire(Channel->ConnectionStateLock);
+    isDisconnected = (Channel->ConnectionState == ConnectionStateDisconnected);
+    WdfSpinLockRelease(Channel->ConnectionStateLock);
+
+    return isDisconnected;
+}
+
  //
  // Incoming connection request, prepare and send response
  // 
@@ -57,15 +74,13 @@ L2CAP_PS3_HandleRemoteConnect(
     WDFREQUEST brbAsyncRequest = NULL;
     CHAR remoteName[BTH_MAX_NAME_SIZE];
     DS_DEVICE_TYPE deviceType = DS_DEVICE_TYPE_UNKNOWN;
+    PBTHPS3_SETTINGS pSettings = NULL;
+    const LARGE_INTEGER connectStartTime = KeQueryPerformanceCounter(NULL);
+    ULONG previousFlags = 0;
 
 
     FuncEntry(TRACE_L2CAP);
 
-    //
-    // (Try to) refresh settings from registry
-    // 
-    (void)BthPS3_SettingsContextInit(DevCtx);
-
     //
     // Look for an existing connection object and reuse that
     // 
@@ -80,13 +95,15 @@ L2CAP_PS3_HandleRemoteConnect(
     // 
     if (status == STATUS_NOT_FOUND)
     {
+        EventWriteConnectStage(NULL, ConnectParams->BtAddress, L"ConnectRequested", 0);
+
         RtlZeroMemory(remoteName, BTH_MAX_NAME_SIZE);
 
         //
         // Request remote name from radio for device identification
         // 
-        if (NT_SUCCESS(status = BthPS3_GetDeviceName(
-            DevCtx->Header.IoTarget,
+        if (NT_SUCCESS(status = BthPS3_GetDeviceNameCached(
+            DevCtx,
             ConnectParams->BtAddress,
             remoteName
         )))
@@ -104,11 +121,11 @@ L2CAP_PS3_HandleRemoteConnect(
         {
             TraceError(
                 TRACE_L2CAP,
-                "BthPS3_GetDeviceName failed with status %!STATUS!, dropping connection",
+                "BthPS3_GetDeviceNameCached failed with status %!STATUS!, dropping connection",
                 status
             );
 
-            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"BthPS3_GetDeviceName", status);
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"BthPS3_GetDeviceNameCached", status);
 
             //
             // Name couldn't be resolved, drop connection
@@ -117,17 +134,23 @@ L2CAP_PS3_HandleRemoteConnect(
         }
 
         //
-        // Distinguish device type based on reported remote name
+        // Settings are kept current by registry change notification
         // 
+        pSettings = BthPS3_SettingsAcquire(DevCtx);
 
         //
-        // Check if PLAYSTATION(R)3 Controller
+        // Distinguish device type based on reported remote name
         // 
-        if (DevCtx->Settings.IsSIXAXISSupported
-            && StringUtil_BthNameIsInCollection(remoteName, DevCtx->Settings.SIXAXISSupportedNames)) 
-        {
-            deviceType = DS_DEVICE_TYPE_SIXAXIS;
+        deviceType = (DS_DEVICE_TYPE)NameMatcher_Match(
+            &pSettings->NameMatcher,
+            remoteName,
+            strnlen(remoteName, BTH_MAX_NAME_SIZE),
+            DS_DEVICE_TYPE_UNKNOWN
+        );
 
+        switch (deviceType)
+        {
+        case DS_DEVICE_TYPE_SIXAXIS:
             TraceInformation(
                 TRACE_L2CAP,
                 "Device %012llX identified as SIXAXIS compatible",
@@ -135,18 +158,8 @@ L2CAP_PS3_HandleRemoteConnect(
             );
 
             EventWriteRemoteDeviceIdentified(NULL, ConnectParams->BtAddress, L"SIXAXIS");
-
-            goto deviceIdentified;
-        }
-
-        //
-        // Check if Navigation Controller
-        // 
-        if (DevCtx->Settings.IsNAVIGATIONSupported
-            && StringUtil_BthNameIsInCollection(remoteName, DevCtx->Settings.NAVIGATIONSupportedNames)) 
-        {
-            deviceType = DS_DEVICE_TYPE_NAVIGATION;
-
+            break;
+        case DS_DEVICE_TYPE_NAVIGATION:
             TraceInformation(
                 TRACE_L2CAP,
                 "Device %012llX identified as NAVIGATION compatible",
@@ -154,18 +167,8 @@ L2CAP_PS3_HandleRemoteConnect(
             );
 
             EventWriteRemoteDeviceIdentified(NULL, ConnectParams->BtAddress, L"NAVIGATION");
-
-            goto deviceIdentified;
-        }
-
-        //
-        // Check if Motion Controller
-        // 
-        if (DevCtx->Settings.IsMOTIONSupported
-            && StringUtil_BthNameIsInCollection(remoteName, DevCtx->Settings.MOTIONSupportedNames)) 
-        {
-            deviceType = DS_DEVICE_TYPE_MOTION;
-
+            break;
+        case DS_DEVICE_TYPE_MOTION:
             TraceInformation(
                 TRACE_L2CAP,
                 "Device %012llX identified as MOTION compatible",
@@ -173,18 +176,8 @@ L2CAP_PS3_HandleRemoteConnect(
             );
 
             EventWriteRemoteDeviceIdentified(NULL, ConnectParams->BtAddress, L"MOTION");
-
-            goto deviceIdentified;
-        }
-
-        //
-        // Check if Wireless Controller
-        // 
-        if (DevCtx->Settings.IsWIRELESSSupported
-            && StringUtil_BthNameIsInCollection(remoteName, DevCtx->Settings.WIRELESSSupportedNames))
-        {
-            deviceType = DS_DEVICE_TYPE_WIRELESS;
-
+            break;
+        case DS_DEVICE_TYPE_WIRELESS:
             TraceInformation(
                 TRACE_L2CAP,
                 "Device %012llX identified as WIRELESS compatible",
@@ -192,12 +185,11 @@ L2CAP_PS3_HandleRemoteConnect(
             );
 
             EventWriteRemoteDeviceIdentified(NULL, ConnectParams->BtAddress, L"WIRELESS");
-
-            goto deviceIdentified;
+            break;
+        default:
+            break;
         }
 
-    deviceIdentified:
-
         //
         // We were not able to identify, drop it
         // 
@@ -212,11 +204,33 @@ L2CAP_PS3_HandleRemoteConnect(
             EventWriteRemoteDeviceNotIdentified(NULL, ConnectParams->BtAddress);
 
             //
-            // Filter re-routed potentially unsupported device, disable
+            // Don't keep a possibly outdated name of an unsupported device
             // 
-            if (DevCtx->Settings.AutoDisableFilter)
+            BthPS3_InvalidateDeviceName(DevCtx, ConnectParams->BtAddress);
+
+            //
+            // Filter re-routed unsupported device, stop patching for it only 
+            // so it can connect normally while PS3 peripherals stay unaffected
+            // 
+            if (pSettings->AutoDisableFilter)
             {
-                if (!NT_SUCCESS(status = BthPS3PSM_DisablePatchSync(
+                if (NT_SUCCESS(status = BthPS3PSM_ExcludeRemoteSync(
+                    DevCtx,
+                    0,
+                    ConnectParams->BtAddress,
+                    pSettings->AutoEnableFilter ? pSettings->AutoEnableFilterDelay : 0
+                )))
+                {
+                    TraceInformation(
+                        TRACE_L2CAP,
+                        "Filter patching disabled for device %012llX",
+                        ConnectParams->BtAddress
+                    );
+                }
+                //
+                // Filter doesn't support patch scope, fall back to disabling it globally
+                // 
+                else if (!NT_SUCCESS(status = BthPS3PSM_DisablePatchSync(
                     DevCtx->PsmFilter.IoTarget,
                     0
                 )))
@@ -239,30 +253,34 @@ L2CAP_PS3_HandleRemoteConnect(
                     //
                     // Fire off re-enable timer
                     // 
-                    if (DevCtx->Settings.AutoEnableFilter)
+                    if (pSettings->AutoEnableFilter)
                     {
                         TraceInformation(
                             TRACE_L2CAP,
                             "Filter disabled, re-enabling in %d seconds",
-                            DevCtx->Settings.AutoEnableFilterDelay
+                            pSettings->AutoEnableFilterDelay
                         );
 
-                        EventWriteAutoEnableFilter(NULL, DevCtx->Settings.AutoEnableFilterDelay);
+                        EventWriteAutoEnableFilter(NULL, pSettings->AutoEnableFilterDelay);
 
                         (void)WdfTimerStart(
                             DevCtx->PsmFilter.AutoResetTimer,
-                            WDF_REL_TIMEOUT_IN_SEC(DevCtx->Settings.AutoEnableFilterDelay)
+                            WDF_REL_TIMEOUT_IN_SEC(pSettings->AutoEnableFilterDelay)
                         );
                     }
                 }
             }
 
+            BthPS3_SettingsRelease(pSettings);
+
             //
             // Unsupported device, drop connection
             // 
             return L2CAP_PS3_DenyRemoteConnect(DevCtx, ConnectParams);
         }
 
+        BthPS3_SettingsRelease(pSettings);
+
         //
         // Allocate new connection object
         // 
@@ -281,6 +299,48 @@ L2CAP_PS3_HandleRemoteConnect(
             );
             goto exit;
         }
+
+        pPdoCtx->ConnectStartTime = connectStartTime;
+        pPdoCtx->Connection.StateEnteredTime = connectStartTime;
+
+        BthPS3_PDO_ConnectStage(pPdoCtx, L"PdoCreated");
+    }
+    //
+    // Previous PDO is still being unplugged, a new one would collide with it;
+    // the device retries and finds the address free again
+    //
+    else if (status == STATUS_DELETE_PENDING)
+    {
+        TraceEvents(TRACE_LEVEL_WARNING,
+            TRACE_L2CAP,
+            "Device %012llX PDO is being removed, dropping connection",
+            ConnectParams->BtAddress
+        );
+
+        return L2CAP_PS3_DenyRemoteConnect(DevCtx, ConnectParams);
+    }
+    //
+    // Both channels gone, only a lingering PDO may get new ones without PnP re-enumeration
+    // and only a HID Control request may start them, anything else would attach to the 
+    // channels of the previous connection
+    //
+    else if (BthPS3_PDO_IsLingering(pPdoCtx)
+        || (L2CAP_PS3_IsChannelDisconnected(&pPdoCtx->HidControlChannel)
+            && L2CAP_PS3_IsChannelDisconnected(&pPdoCtx->HidInterruptChannel)))
+    {
+        if (psm != PSM_DS3_HID_CONTROL || !BthPS3_PDO_LingerReattach(pPdoCtx, connectStartTime))
+        {
+            TraceEvents(TRACE_LEVEL_WARNING,
+                TRACE_L2CAP,
+                "Device %012llX PDO can't take PSM 0x%04X now, dropping connection",
+                ConnectParams->BtAddress,
+                psm
+            );
+
+            return L2CAP_PS3_DenyRemoteConnect(DevCtx, ConnectParams);
+        }
+
+        BthPS3_PDO_ConnectStage(pPdoCtx, L"PdoReattached");
     }
 
     if (pPdoCtx == NULL)
@@ -299,29 +359,99 @@ L2CAP_PS3_HandleRemoteConnect(
         pPdoCtx->HidControlChannel.ChannelHandle = ConnectParams->ConnectionHandle;
         brbAsyncRequest = pPdoCtx->HidControlChannel.ConnectDisconnectRequest;
         brb = (struct _BRB_L2CA_OPEN_CHANNEL*)&(pPdoCtx->HidControlChannel.ConnectDisconnectBrb);
+
+        (void)L2CAP_PS3_ConnectStateUpdate(pPdoCtx, BTHPS3_PDO_CONNECT_CONTROL_PENDING, 0, NULL);
+
+        L2CAP_PS3_PrepareConnectResponse(pPdoCtx, &pPdoCtx->HidControlChannel, psm);
         break;
     case PSM_DS3_HID_INTERRUPT:
         completionRoutine = L2CAP_PS3_InterruptConnectResponseCompleted;
         pPdoCtx->HidInterruptChannel.ChannelHandle = ConnectParams->ConnectionHandle;
         brbAsyncRequest = pPdoCtx->HidInterruptChannel.ConnectDisconnectRequest;
         brb = (struct _BRB_L2CA_OPEN_CHANNEL*)&(pPdoCtx->HidInterruptChannel.ConnectDisconnectBrb);
+
+        //
+        // Claims a response staged on HID Control acceptance, also keeps it from being staged now
+        // 
+        (void)L2CAP_PS3_ConnectStateUpdate(
+            pPdoCtx,
+            BTHPS3_PDO_CONNECT_INTERRUPT_PENDING,
+            BTHPS3_PDO_CONNECT_INTERRUPT_STAGED,
+            &previousFlags
+        );
+
+        if (!(previousFlags & BTHPS3_PDO_CONNECT_INTERRUPT_STAGED))
+        {
+            L2CAP_PS3_PrepareConnectResponse(pPdoCtx, &pPdoCtx->HidInterruptChannel, psm);
+        }
         break;
     default:
         status = STATUS_INVALID_PARAMETER;
         goto exit;
     }
 
-    CLIENT_CONNECTION_REQUEST_REUSE(brbAsyncRequest);
-    DevCtx->Header.ProfileDrvInterface.BthReuseBrb((PBRB)brb, BRB_L2CA_OPEN_CHANNEL_RESPONSE);
+    brb->BtAddress = ConnectParams->BtAddress;
+    brb->ChannelHandle = ConnectParams->ConnectionHandle;
+
+    //
+    // Submit response
+    // 
+    if (!NT_SUCCESS(status = BthPS3_SendBrbAsync(
+        DevCtx->Header.IoTarget,
+        brbAsyncRequest,
+        (PBRB)brb,
+        sizeof(*brb),
+        completionRoutine,
+        brb
+    )))
+    {
+        TraceError(
+            TRACE_L2CAP,
+            "BthPS3_SendBrbAsync failed with status %!STATUS!",
+            status
+        );
+    }
+
+exit:
+
+    if (!NT_SUCCESS(status) && pPdoCtx)
+    {
+        BthPS3_PDO_Destroy(&DevCtx->Header, pPdoCtx);
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        EventWriteL2CAPRemoteConnectFailed(NULL, psm, status);
+    }
+
+    FuncExit(TRACE_L2CAP, "status=%!STATUS!", status);
+
+    return status;
+}
+
+//
+// Fills in an open channel response BRB, except the remote channel handle
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+L2CAP_PS3_PrepareConnectResponse(
+    _In_ PBTHPS3_PDO_CONTEXT PdoContext,
+    _In_ PBTHPS3_CLIENT_L2CAP_CHANNEL Channel,
+    _In_ USHORT Psm
+)
+{
+    struct _BRB_L2CA_OPEN_CHANNEL* brb = (struct _BRB_L2CA_OPEN_CHANNEL*)&Channel->ConnectDisconnectBrb;
+
+    CLIENT_CONNECTION_REQUEST_REUSE(Channel->ConnectDisconnectRequest);
+    PdoContext->DevCtxHdr->ProfileDrvInterface.BthReuseBrb((PBRB)brb, BRB_L2CA_OPEN_CHANNEL_RESPONSE);
 
     //
     // Pass connection object along as context
     // 
-    brb->Hdr.ClientContext[0] = pPdoCtx;
+    brb->Hdr.ClientContext[0] = PdoContext;
 
-    brb->BtAddress = ConnectParams->BtAddress;
-    brb->Psm = psm;
-    brb->ChannelHandle = ConnectParams->ConnectionHandle;
+    brb->BtAddress = PdoContext->RemoteAddress;
+    brb->Psm = Psm;
     brb->Response = CONNECT_RSP_RESULT_SUCCESS;
 
     brb->ChannelFlags = CF_ROLE_EITHER;
@@ -362,41 +492,119 @@ L2CAP_PS3_HandleRemoteConnect(
     //
     brb->CallbackFlags = CALLBACK_DISCONNECT | CALLBACK_CONFIG_QOS;
     brb->Callback = &L2CAP_PS3_ConnectionIndicationCallback;
-    brb->CallbackContext = pPdoCtx;
-    brb->ReferenceObject = (PVOID)WdfDeviceWdmGetDeviceObject(DevCtx->Header.Device);
+    brb->CallbackContext = PdoContext;
+    brb->ReferenceObject = (PVOID)WdfDeviceWdmGetDeviceObject(PdoContext->DevCtxHdr->Device);
+}
 
-    //
-    // Submit response
-    // 
-    if (!NT_SUCCESS(status = BthPS3_SendBrbAsync(
-        DevCtx->Header.IoTarget,
-        brbAsyncRequest,
-        (PBRB)brb,
-        sizeof(*brb),
-        completionRoutine,
-        brb
-    )))
+//
+// Prepares the HID Interrupt response ahead of its connection request, 
+// skipped if the request already arrived
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+L2CAP_PS3_StageInterruptResponse(
+    _In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+    const ULONG busy = BTHPS3_PDO_CONNECT_INTERRUPT_PENDING
+        | BTHPS3_PDO_CONNECT_INTERRUPT_UP
+        | BTHPS3_PDO_CONNECT_INTERRUPT_STAGED;
+
+    WdfSpinLockAcquire(PdoContext->Connection.Lock);
+
+    if (!(PdoContext->Connection.Flags & busy))
     {
-        TraceError(
-            TRACE_L2CAP,
-            "BthPS3_SendBrbAsync failed with status %!STATUS!",
-            status
-        );
+        L2CAP_PS3_PrepareConnectResponse(PdoContext, &PdoContext->HidInterruptChannel, PSM_DS3_HID_INTERRUPT);
+
+        PdoContext->Connection.Flags |= BTHPS3_PDO_CONNECT_INTERRUPT_STAGED;
     }
 
-exit:
+    WdfSpinLockRelease(PdoContext->Connection.Lock);
+}
 
-    if (!NT_SUCCESS(status) && pPdoCtx)
+//
+// Derives the connection setup state from the channel progress flags
+// 
+static BTHPS3_PDO_CONNECT_STATE
+L2CAP_PS3_ConnectStateFromFlags(
+    _In_ ULONG Flags
+)
+{
+    const ULONG online = BTHPS3_PDO_CONNECT_CONTROL_UP | BTHPS3_PDO_CONNECT_INTERRUPT_UP;
+
+    if ((Flags & online) == online)
     {
-        BthPS3_PDO_Destroy(&DevCtx->Header, pPdoCtx);
+        return PdoConnectStateOnline;
     }
 
-    if (!NT_SUCCESS(status))
+    if (Flags & (BTHPS3_PDO_CONNECT_INTERRUPT_PENDING | BTHPS3_PDO_CONNECT_INTERRUPT_UP))
     {
-        EventWriteL2CAPRemoteConnectFailed(NULL, psm, status);
+        return PdoConnectStateInterruptPending;
     }
 
-    FuncExit(TRACE_L2CAP, "status=%!STATUS!", status);
+    if (Flags & BTHPS3_PDO_CONNECT_CONTROL_UP)
+    {
+        return PdoConnectStateAwaitingInterrupt;
+    }
 
-    return status;
+    if (Flags & BTHPS3_PDO_CONNECT_CONTROL_PENDING)
+    {
+        return PdoConnectStateControlPending;
+    }
+
+    return PdoConnectStateIdle;
+}
+
+//
+// Applies channel progress and accounts the time spent in the left state, 
+// returns TRUE to the one caller whose update brought both channels up
+// 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+L2CAP_PS3_ConnectStateUpdate(
+    _In_ PBTHPS3_PDO_CONTEXT PdoContext,
+    _In_ ULONG SetFlags,
+    _In_ ULONG ClearFlags,
+    _Out_opt_ PULONG PreviousFlags
+)
+{
+    LARGE_INTEGER frequency;
+    const LARGE_INTEGER now = KeQueryPerformanceCounter(&frequency);
+    const PBTHPS3_PDO_CONNECTION pConnection = &PdoContext->Connection;
+
+    WdfSpinLockAcquire(pConnection->Lock);
+
+    const BTHPS3_PDO_CONNECT_STATE previous = pConnection->State;
+
+    if (PreviousFlags)
+    {
+        *PreviousFlags = pConnection->Flags;
+    }
+
+    pConnection->Flags = (pConnection->Flags & ~ClearFlags) | SetFlags;
+
+    const BTHPS3_PDO_CONNECT_STATE current = L2CAP_PS3_ConnectStateFromFlags(pConnection->Flags);
+
+    if (current != previous)
+    {
+        pConnection->StateMicroseconds[previous] +=
+            (ULONG64)(now.QuadPart - pConnection->StateEnteredTime.QuadPart) * 1000000 / (ULONG64)frequency.QuadPart;
+        pConnection->StateEnteredTime = now;
+        pConnection->State = current;
+    }
+
+    WdfSpinLockRelease(pConnection->Lock);
+
+    if (current != previous)
+    {
+        TraceVerbose(
+            TRACE_L2CAP,
+            "Device %012llX connection state %d -> %d",
+            PdoContext->RemoteAddress,
+            previous,
+            current
+        );
+    }
+
+    return (current == PdoConnectStateOnline && previous != PdoConnectStateOnline);
 }
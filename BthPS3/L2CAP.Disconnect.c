@@ -49,6 +49,8 @@ L2CAP_PS3_HandleRemoteDisconnect(
 	NTSTATUS status = STATUS_UNSUCCESSFUL;
 	PBTHPS3_SERVER_CONTEXT pDevCtx = NULL;
 	PBTHPS3_PDO_CONTEXT pPdoCtx = Context;
+	PBTHPS3_SETTINGS pSettings = NULL;
+	ULONG lingerTimeout = 0;
 	LARGE_INTEGER timeout;
 	timeout.QuadPart = 0;
 
@@ -144,10 +146,21 @@ L2CAP_PS3_HandleRemoteDisconnect(
 		}
 
 		//
-		// TODO: old PDO destruction happened here
+		// Driver-owned reads failed with the channel, wait for them to return
 		// 
+		BthPS3_PDO_InterruptReadRingStop(pPdoCtx);
 
-		BthPS3_PDO_Destroy(&pDevCtx->Header, pPdoCtx);
+		pSettings = BthPS3_SettingsAcquire(pDevCtx);
+		lingerTimeout = pSettings->ChildLingerTimeout;
+		BthPS3_SettingsRelease(pSettings);
+
+		//
+		// Optionally keep the PDO around so a quick reconnect skips PnP enumeration
+		// 
+		if (!BthPS3_PDO_LingerStart(pPdoCtx, lingerTimeout))
+		{
+			BthPS3_PDO_Destroy(&pDevCtx->Header, pPdoCtx);
+		}
 	}
 
 	FuncExit(TRACE_L2CAP, "status=%!STATUS!", status);
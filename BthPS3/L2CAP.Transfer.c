@@ -48,6 +48,7 @@ L2CAP_PS3_SendControlTransferAsync(
     PBTHPS3_PDO_CONTEXT ClientConnection,
     WDFREQUEST Request,
     PVOID Buffer,
+    PMDL BufferMdl,
     size_t BufferLength,
     PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine
 )
@@ -56,13 +57,9 @@ L2CAP_PS3_SendControlTransferAsync(
     struct _BRB_L2CA_ACL_TRANSFER* brb = NULL;
 
     //
-    // Allocate BRB
+    // Get BRB from pool (or allocate, if exhausted)
     // 
-    brb = (struct _BRB_L2CA_ACL_TRANSFER*)
-        ClientConnection->DevCtxHdr->ProfileDrvInterface.BthAllocateBrb(
-            BRB_L2CA_ACL_TRANSFER,
-            POOLTAG_BTHPS3
-        );
+    brb = BthPS3_PDO_BrbPoolAcquire(ClientConnection);
 
     if (brb == NULL)
     {
@@ -70,9 +67,9 @@ L2CAP_PS3_SendControlTransferAsync(
     }
 
     //
-    // Used in completion routine to free BRB
+    // Used in completion routine to return BRB to pool
     // 
-    brb->Hdr.ClientContext[0] = ClientConnection->DevCtxHdr;
+    brb->Hdr.ClientContext[0] = ClientConnection;
 
     //
     // Set channel properties
@@ -80,7 +77,7 @@ L2CAP_PS3_SendControlTransferAsync(
     brb->BtAddress = ClientConnection->RemoteAddress;
     brb->ChannelHandle = ClientConnection->HidControlChannel.ChannelHandle;
     brb->TransferFlags = ACL_TRANSFER_DIRECTION_OUT;
-    brb->BufferMDL = NULL;
+    brb->BufferMDL = BufferMdl;
     brb->Buffer = Buffer;
     brb->BufferSize = (ULONG)BufferLength;
 
@@ -104,7 +101,7 @@ L2CAP_PS3_SendControlTransferAsync(
             status
         );
 
-        ClientConnection->DevCtxHdr->ProfileDrvInterface.BthFreeBrb((PBRB)brb);
+        BthPS3_PDO_BrbPoolRelease(ClientConnection, brb);
     }
 
     return status;
@@ -119,6 +116,7 @@ L2CAP_PS3_ReadControlTransferAsync(
     PBTHPS3_PDO_CONTEXT ClientConnection,
     WDFREQUEST Request,
     PVOID Buffer,
+    PMDL BufferMdl,
     size_t BufferLength,
     PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine
 )
@@ -127,13 +125,9 @@ L2CAP_PS3_ReadControlTransferAsync(
     struct _BRB_L2CA_ACL_TRANSFER* brb = NULL;
 
     //
-    // Allocate BRB
+    // Get BRB from pool (or allocate, if exhausted)
     // 
-    brb = (struct _BRB_L2CA_ACL_TRANSFER*)
-        ClientConnection->DevCtxHdr->ProfileDrvInterface.BthAllocateBrb(
-            BRB_L2CA_ACL_TRANSFER,
-            POOLTAG_BTHPS3
-        );
+    brb = BthPS3_PDO_BrbPoolAcquire(ClientConnection);
 
     if (brb == NULL)
     {
@@ -141,9 +135,9 @@ L2CAP_PS3_ReadControlTransferAsync(
     }
 
     //
-    // Used in completion routine to free BRB
+    // Used in completion routine to return BRB to pool
     // 
-    brb->Hdr.ClientContext[0] = ClientConnection->DevCtxHdr;
+    brb->Hdr.ClientContext[0] = ClientConnection;
 
     //
     // Set channel properties
@@ -151,7 +145,7 @@ L2CAP_PS3_ReadControlTransferAsync(
     brb->BtAddress = ClientConnection->RemoteAddress;
     brb->ChannelHandle = ClientConnection->HidControlChannel.ChannelHandle;
     brb->TransferFlags = ACL_TRANSFER_DIRECTION_IN | ACL_SHORT_TRANSFER_OK;
-    brb->BufferMDL = NULL;
+    brb->BufferMDL = BufferMdl;
     brb->Buffer = Buffer;
     brb->BufferSize = (ULONG)BufferLength;
 
@@ -175,7 +169,7 @@ L2CAP_PS3_ReadControlTransferAsync(
             status
         );
 
-        ClientConnection->DevCtxHdr->ProfileDrvInterface.BthFreeBrb((PBRB)brb);
+        BthPS3_PDO_BrbPoolRelease(ClientConnection, brb);
     }
 
     return status;
@@ -189,7 +183,8 @@ NTSTATUS
 L2CAP_PS3_ReadInterruptTransferAsync(
     _In_ PBTHPS3_PDO_CONTEXT ClientConnection,
     _In_ WDFREQUEST Request,
-    _In_ PVOID Buffer,
+    _In_opt_ PVOID Buffer,
+    _In_opt_ PMDL BufferMdl,
     _In_ size_t BufferLength,
     _In_ PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine
 )
@@ -198,13 +193,9 @@ L2CAP_PS3_ReadInterruptTransferAsync(
     struct _BRB_L2CA_ACL_TRANSFER* brb = NULL;
 
     //
-    // Allocate BRB
+    // Get BRB from pool (or allocate, if exhausted)
     // 
-    brb = (struct _BRB_L2CA_ACL_TRANSFER*)
-        ClientConnection->DevCtxHdr->ProfileDrvInterface.BthAllocateBrb(
-            BRB_L2CA_ACL_TRANSFER,
-            POOLTAG_BTHPS3
-        );
+    brb = BthPS3_PDO_BrbPoolAcquire(ClientConnection);
 
     if (brb == NULL)
     {
@@ -212,9 +203,9 @@ L2CAP_PS3_ReadInterruptTransferAsync(
     }
 
     //
-    // Used in completion routine to free BRB
+    // Used in completion routine to return BRB to pool
     // 
-    brb->Hdr.ClientContext[0] = ClientConnection->DevCtxHdr;
+    brb->Hdr.ClientContext[0] = ClientConnection;
 
     //
     // Set channel properties
@@ -222,7 +213,7 @@ L2CAP_PS3_ReadInterruptTransferAsync(
     brb->BtAddress = ClientConnection->RemoteAddress;
     brb->ChannelHandle = ClientConnection->HidInterruptChannel.ChannelHandle;
     brb->TransferFlags = ACL_TRANSFER_DIRECTION_IN;
-    brb->BufferMDL = NULL;
+    brb->BufferMDL = BufferMdl;
     brb->Buffer = Buffer;
     brb->BufferSize = (ULONG)BufferLength;
 
@@ -246,7 +237,7 @@ L2CAP_PS3_ReadInterruptTransferAsync(
             status
         );
 
-        ClientConnection->DevCtxHdr->ProfileDrvInterface.BthFreeBrb((PBRB)brb);
+        BthPS3_PDO_BrbPoolRelease(ClientConnection, brb);
     }
 
     return status;
@@ -260,7 +251,8 @@ NTSTATUS
 L2CAP_PS3_SendInterruptTransferAsync(
     _In_ PBTHPS3_PDO_CONTEXT ClientConnection,
     _In_ WDFREQUEST Request,
-    _In_ PVOID Buffer,
+    _In_opt_ PVOID Buffer,
+    _In_opt_ PMDL BufferMdl,
     _In_ size_t BufferLength,
     _In_ PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine
 )
@@ -269,13 +261,9 @@ L2CAP_PS3_SendInterruptTransferAsync(
     struct _BRB_L2CA_ACL_TRANSFER* brb = NULL;
 
     //
-    // Allocate BRB
+    // Get BRB from pool (or allocate, if exhausted)
     // 
-    brb = (struct _BRB_L2CA_ACL_TRANSFER*)
-        ClientConnection->DevCtxHdr->ProfileDrvInterface.BthAllocateBrb(
-            BRB_L2CA_ACL_TRANSFER,
-            POOLTAG_BTHPS3
-        );
+    brb = BthPS3_PDO_BrbPoolAcquire(ClientConnection);
 
     if (brb == NULL)
     {
@@ -283,9 +271,9 @@ L2CAP_PS3_SendInterruptTransferAsync(
     }
 
     //
-    // Used in completion routine to free BRB
+    // Used in completion routine to return BRB to pool
     // 
-    brb->Hdr.ClientContext[0] = ClientConnection->DevCtxHdr;
+    brb->Hdr.ClientContext[0] = ClientConnection;
 
     //
     // Set channel properties
@@ -293,7 +281,7 @@ L2CAP_PS3_SendInterruptTransferAsync(
     brb->BtAddress = ClientConnection->RemoteAddress;
     brb->ChannelHandle = ClientConnection->HidInterruptChannel.ChannelHandle;
     brb->TransferFlags = ACL_TRANSFER_DIRECTION_OUT;
-    brb->BufferMDL = NULL;
+    brb->BufferMDL = BufferMdl;
     brb->Buffer = Buffer;
     brb->BufferSize = (ULONG)BufferLength;
     brb->Timeout = 0;
@@ -319,7 +307,7 @@ L2CAP_PS3_SendInterruptTransferAsync(
             status
         );
 
-        ClientConnection->DevCtxHdr->ProfileDrvInterface.BthFreeBrb((PBRB)brb);
+        BthPS3_PDO_BrbPoolRelease(ClientConnection, brb);
     }
 
     return status;
@@ -338,8 +326,8 @@ L2CAP_PS3_AsyncSendControlTransferCompleted(
 {
     struct _BRB_L2CA_ACL_TRANSFER* brb =
         (struct _BRB_L2CA_ACL_TRANSFER*)Context;
-    PBTHPS3_DEVICE_CONTEXT_HEADER deviceCtxHdr =
-        (PBTHPS3_DEVICE_CONTEXT_HEADER)brb->Hdr.ClientContext[0];
+    const PBTHPS3_PDO_CONTEXT pPdoCtx =
+        (PBTHPS3_PDO_CONTEXT)brb->Hdr.ClientContext[0];
 
     UNREFERENCED_PARAMETER(Target);
 
@@ -349,7 +337,7 @@ L2CAP_PS3_AsyncSendControlTransferCompleted(
         Params->IoStatus.Status
     );
 
-    deviceCtxHdr->ProfileDrvInterface.BthFreeBrb((PBRB)brb);
+    BthPS3_PDO_BrbPoolRelease(pPdoCtx, brb);
     WdfRequestComplete(Request, Params->IoStatus.Status);
 }
 
@@ -367,8 +355,8 @@ L2CAP_PS3_AsyncReadControlTransferCompleted(
     size_t length = 0;
     struct _BRB_L2CA_ACL_TRANSFER* brb =
         (struct _BRB_L2CA_ACL_TRANSFER*)Context;
-    PBTHPS3_DEVICE_CONTEXT_HEADER deviceCtxHdr =
-        (PBTHPS3_DEVICE_CONTEXT_HEADER)brb->Hdr.ClientContext[0];
+    const PBTHPS3_PDO_CONTEXT pPdoCtx =
+        (PBTHPS3_PDO_CONTEXT)brb->Hdr.ClientContext[0];
 
     UNREFERENCED_PARAMETER(Target);
 
@@ -379,7 +367,7 @@ L2CAP_PS3_AsyncReadControlTransferCompleted(
     );
 
     length = brb->BufferSize;
-    deviceCtxHdr->ProfileDrvInterface.BthFreeBrb((PBRB)brb);
+    BthPS3_PDO_BrbPoolRelease(pPdoCtx, brb);
     WdfRequestCompleteWithInformation(
         Request,
         Params->IoStatus.Status,
@@ -401,8 +389,8 @@ L2CAP_PS3_AsyncReadInterruptTransferCompleted(
     size_t length = 0;
     struct _BRB_L2CA_ACL_TRANSFER* brb =
         (struct _BRB_L2CA_ACL_TRANSFER*)Context;
-    PBTHPS3_DEVICE_CONTEXT_HEADER deviceCtxHdr =
-        (PBTHPS3_DEVICE_CONTEXT_HEADER)brb->Hdr.ClientContext[0];
+    const PBTHPS3_PDO_CONTEXT pPdoCtx =
+        (PBTHPS3_PDO_CONTEXT)brb->Hdr.ClientContext[0];
 
     UNREFERENCED_PARAMETER(Target);
 
@@ -414,7 +402,27 @@ L2CAP_PS3_AsyncReadInterruptTransferCompleted(
     );
 
     length = brb->BufferSize;
-    deviceCtxHdr->ProfileDrvInterface.BthFreeBrb((PBRB)brb);
+
+    if (NT_SUCCESS(Params->IoStatus.Status) && pPdoCtx->Mailbox.Shared != NULL)
+    {
+        //
+        // Direct I/O requests carry the report in the MDL only
+        // 
+        const PVOID report = (brb->Buffer != NULL) ? brb->Buffer :
+            MmGetSystemAddressForMdlSafe(brb->BufferMDL, NormalPagePriority | MdlMappingNoExecute);
+
+        if (report != NULL)
+        {
+            BthPS3_PDO_MailboxPublish(
+                pPdoCtx,
+                KeQueryPerformanceCounter(NULL),
+                report,
+                brb->BufferSize
+            );
+        }
+    }
+
+    BthPS3_PDO_BrbPoolRelease(pPdoCtx, brb);
     WdfRequestCompleteWithInformation(
         Request,
         Params->IoStatus.Status,
@@ -435,8 +443,8 @@ L2CAP_PS3_AsyncSendInterruptTransferCompleted(
 {
     struct _BRB_L2CA_ACL_TRANSFER* brb =
         (struct _BRB_L2CA_ACL_TRANSFER*)Context;
-    PBTHPS3_DEVICE_CONTEXT_HEADER deviceCtxHdr =
-        (PBTHPS3_DEVICE_CONTEXT_HEADER)brb->Hdr.ClientContext[0];
+    const PBTHPS3_PDO_CONTEXT pPdoCtx =
+        (PBTHPS3_PDO_CONTEXT)brb->Hdr.ClientContext[0];
 
     UNREFERENCED_PARAMETER(Target);
 
@@ -446,6 +454,6 @@ L2CAP_PS3_AsyncSendInterruptTransferCompleted(
         Params->IoStatus.Status
     );
 
-    deviceCtxHdr->ProfileDrvInterface.BthFreeBrb((PBRB)brb);
+    BthPS3_PDO_BrbPoolRelease(pPdoCtx, brb);
     WdfRequestComplete(Request, Params->IoStatus.Status);
 }
@@ -42,6 +42,97 @@
 
 #pragma region L2CAP remote connection handling
 
+//
+// Both channels are up, start serving HID Interrupt traffic
+// 
+static VOID
+L2CAP_PS3_ConnectionOnline(
+	_In_ PBTHPS3_PDO_CONTEXT PdoContext
+)
+{
+	NTSTATUS status;
+	const PBTHPS3_PDO_CONNECTION pConnection = &PdoContext->Connection;
+
+	FuncEntry(TRACE_L2CAP);
+
+	//
+	// Channel connected, queues ready to start processing
+	// 
+
+	if (!NT_SUCCESS(status = WdfIoQueueReadyNotify(
+		PdoContext->Queues.HidInterruptReadRequests,
+		BthPS3_PDO_DispatchHidInterruptRead,
+		PdoContext
+	)))
+	{
+		TraceError(
+			TRACE_L2CAP,
+			"WdfIoQueueReadyNotify (HidInterruptReadRequests) failed with status %!STATUS!",
+			status
+		);
+
+		EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfIoQueueReadyNotify (HidInterruptReadRequests)", status);
+	}
+
+	if (!NT_SUCCESS(status = WdfIoQueueReadyNotify(
+		PdoContext->Queues.HidInterruptWriteRequests,
+		BthPS3_PDO_DispatchHidInterruptWrite,
+		PdoContext
+	)))
+	{
+		TraceError(
+			TRACE_L2CAP,
+			"WdfIoQueueReadyNotify (HidInterruptWriteRequests) failed with status %!STATUS!",
+			status
+		);
+
+		EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfIoQueueReadyNotify (HidInterruptWriteRequests)", status);
+	}
+
+	if (!NT_SUCCESS(status = WdfIoQueueReadyNotify(
+		PdoContext->Queues.HidInterruptReadBatchRequests,
+		BthPS3_PDO_DispatchHidInterruptReadBatch,
+		PdoContext
+	)))
+	{
+		TraceError(
+			TRACE_L2CAP,
+			"WdfIoQueueReadyNotify (HidInterruptReadBatchRequests) failed with status %!STATUS!",
+			status
+		);
+
+		EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfIoQueueReadyNotify (HidInterruptReadBatchRequests)", status);
+	}
+
+	//
+	// Driver-owned reads (if enabled) start filling the ring now
+	// 
+	BthPS3_PDO_InterruptReadRingStart(PdoContext);
+
+	TraceInformation(
+		TRACE_L2CAP,
+		"Device %012llX online, %llu us to answer HID Control, %llu us awaiting its confirmation, %llu us awaiting the HID Interrupt request, %llu us awaiting its confirmation",
+		PdoContext->RemoteAddress,
+		pConnection->StateMicroseconds[PdoConnectStateIdle],
+		pConnection->StateMicroseconds[PdoConnectStateControlPending],
+		pConnection->StateMicroseconds[PdoConnectStateAwaitingInterrupt],
+		pConnection->StateMicroseconds[PdoConnectStateInterruptPending]
+	);
+
+	EventWriteConnectStateTimes(
+		NULL,
+		PdoContext->RemoteAddress,
+		pConnection->StateMicroseconds[PdoConnectStateIdle],
+		pConnection->StateMicroseconds[PdoConnectStateControlPending],
+		pConnection->StateMicroseconds[PdoConnectStateAwaitingInterrupt],
+		pConnection->StateMicroseconds[PdoConnectStateInterruptPending]
+	);
+
+	EventWriteRemoteDeviceOnline(NULL, PdoContext->RemoteAddress);
+
+	FuncExitNoReturn(TRACE_L2CAP);
+}
+
 //
 // Control channel connection result
 // 
@@ -91,6 +182,30 @@ L2CAP_PS3_ControlConnectResponseCompleted(
 
 		EventWriteHidControlChannelConnected(NULL);
 
+		BthPS3_PDO_ConnectStage(pPdoCtx, L"ControlChannelAccepted");
+
+		//
+		// Friendly name and friends were held back to get here sooner
+		// 
+		BthPS3_PDO_DeferredPropertiesGateRelease(pPdoCtx);
+
+		//
+		// HID Interrupt confirmation may have raced ahead, otherwise get its response ready
+		// 
+		if (L2CAP_PS3_ConnectStateUpdate(
+			pPdoCtx,
+			BTHPS3_PDO_CONNECT_CONTROL_UP,
+			BTHPS3_PDO_CONNECT_CONTROL_PENDING,
+			NULL
+		))
+		{
+			L2CAP_PS3_ConnectionOnline(pPdoCtx);
+		}
+		else
+		{
+			L2CAP_PS3_StageInterruptResponse(pPdoCtx);
+		}
+
 		//
 		// Channel connected, queues ready to start processing
 		// 
@@ -155,7 +270,6 @@ L2CAP_PS3_InterruptConnectResponseCompleted(
 	NTSTATUS status;
 	struct _BRB_L2CA_OPEN_CHANNEL* brb = NULL;
 	PBTHPS3_PDO_CONTEXT pPdoCtx = NULL;
-	BTHPS3_CONNECTION_STATE controlState;
 
 	UNREFERENCED_PARAMETER(Request);
 	UNREFERENCED_PARAMETER(Target);
@@ -191,59 +305,20 @@ L2CAP_PS3_InterruptConnectResponseCompleted(
 
 		EventWriteHidInterruptChannelConnected(NULL);
 
-		//
-		// Control channel is expected to be established by now
-		// 
-		WdfSpinLockAcquire(pPdoCtx->HidControlChannel.ConnectionStateLock);
-		controlState = pPdoCtx->HidInterruptChannel.ConnectionState;
-		WdfSpinLockRelease(pPdoCtx->HidControlChannel.ConnectionStateLock);
-
-		if (controlState != ConnectionStateConnected)
-		{
-			TraceError(
-				TRACE_L2CAP,
-				"HID Control Channel in invalid state (0x%02X), dropping connection",
-				controlState
-			);
-
-			goto failedDrop;
-		}
+		BthPS3_PDO_ConnectStage(pPdoCtx, L"InterruptChannelAccepted");
 
 		//
-		// Channel connected, queues ready to start processing
+		// HID Control may still be awaiting its confirmation, whoever completes last goes online
 		// 
-
-		if (!NT_SUCCESS(status = WdfIoQueueReadyNotify(
-			pPdoCtx->Queues.HidInterruptReadRequests,
-			BthPS3_PDO_DispatchHidInterruptRead,
-			pPdoCtx
-		)))
+		if (L2CAP_PS3_ConnectStateUpdate(
+			pPdoCtx,
+			BTHPS3_PDO_CONNECT_INTERRUPT_UP,
+			BTHPS3_PDO_CONNECT_INTERRUPT_PENDING,
+			NULL
+		))
 		{
-			TraceError(
-				TRACE_L2CAP,
-				"WdfIoQueueReadyNotify (HidInterruptReadRequests) failed with status %!STATUS!",
-				status
-			);
-
-			EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfIoQueueReadyNotify (HidInterruptReadRequests)", status);
+			L2CAP_PS3_ConnectionOnline(pPdoCtx);
 		}
-
-		if (!NT_SUCCESS(status = WdfIoQueueReadyNotify(
-			pPdoCtx->Queues.HidInterruptWriteRequests,
-			BthPS3_PDO_DispatchHidInterruptWrite,
-			pPdoCtx
-		)))
-		{
-			TraceError(
-				TRACE_L2CAP,
-				"WdfIoQueueReadyNotify (HidInterruptWriteRequests) failed with status %!STATUS!",
-				status
-			);
-
-			EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfIoQueueReadyNotify (HidInterruptWriteRequests)", status);
-		}
-
-		EventWriteRemoteDeviceOnline(NULL, pPdoCtx->RemoteAddress);
 	}
 	else
 	{
@@ -55,6 +55,29 @@ L2CAP_PS3_HandleRemoteDisconnect(
     _In_ PINDICATION_PARAMETERS DisconnectParams
 );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+L2CAP_PS3_PrepareConnectResponse(
+    _In_ PBTHPS3_PDO_CONTEXT PdoContext,
+    _In_ PBTHPS3_CLIENT_L2CAP_CHANNEL Channel,
+    _In_ USHORT Psm
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+L2CAP_PS3_StageInterruptResponse(
+    _In_ PBTHPS3_PDO_CONTEXT PdoContext
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+L2CAP_PS3_ConnectStateUpdate(
+    _In_ PBTHPS3_PDO_CONTEXT PdoContext,
+    _In_ ULONG SetFlags,
+    _In_ ULONG ClearFlags,
+    _Out_opt_ PULONG PreviousFlags
+);
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 NTSTATUS
 L2CAP_PS3_DenyRemoteConnect(
@@ -83,6 +106,7 @@ L2CAP_PS3_SendControlTransferAsync(
     PBTHPS3_PDO_CONTEXT ClientConnection,
     WDFREQUEST Request,
     PVOID Buffer,
+    PMDL BufferMdl,
     size_t BufferLength,
     PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine
 );
@@ -93,6 +117,7 @@ L2CAP_PS3_ReadControlTransferAsync(
     PBTHPS3_PDO_CONTEXT ClientConnection,
     WDFREQUEST Request,
     PVOID Buffer,
+    PMDL BufferMdl,
     size_t BufferLength,
     PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine
 );
@@ -102,7 +127,8 @@ NTSTATUS
 L2CAP_PS3_ReadInterruptTransferAsync(
     _In_ PBTHPS3_PDO_CONTEXT ClientConnection,
     _In_ WDFREQUEST Request,
-    _In_ PVOID Buffer,
+    _In_opt_ PVOID Buffer,
+    _In_opt_ PMDL BufferMdl,
     _In_ size_t BufferLength,
     _In_ PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine
 );
@@ -112,7 +138,8 @@ NTSTATUS
 L2CAP_PS3_SendInterruptTransferAsync(
     _In_ PBTHPS3_PDO_CONTEXT ClientConnection,
     _In_ WDFREQUEST Request,
-    _In_ PVOID Buffer,
+    _In_opt_ PVOID Buffer,
+    _In_opt_ PMDL BufferMdl,
     _In_ size_t BufferLength,
     _In_ PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine
 );
@@ -0,0 +1,230 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3 - Windows kernel-mode Bluetooth profile and bus driver                  *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+//
+// User-mode known-answer tests for the portable name matcher, not part of the driver build:
+//   cc -o namematcher NameMatcher.c NameMatcher.Harness.c && ./namematcher
+// 
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "NameMatcher.h"
+
+//
+// Same as BTH_MAX_NAME_SIZE, the size of the buffer remote names are read into
+// 
+#define HARNESS_MAX_NAME_SIZE   248
+
+enum
+{
+    HarnessUnknown = 0,
+    HarnessSixaxis,
+    HarnessNavigation,
+    HarnessMotion,
+    HarnessWireless
+};
+
+static int G_Failures = 0;
+
+#define HARNESS_EXPECT(_cond_)                                              \
+    do {                                                                    \
+        if (!(_cond_)) {                                                    \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #_cond_); \
+            G_Failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+//
+// Adds a NUL-terminated pattern the way settings are loaded, without the terminator
+// 
+static void
+Harness_Add(
+    PNAME_MATCHER Matcher,
+    const char* Pattern,
+    int Value
+)
+{
+    HARNESS_EXPECT(NameMatcher_Add(Matcher, Pattern, strlen(Pattern), Value));
+}
+
+//
+// Matches a remote name the way L2CAP_PS3_HandleRemoteConnect does, from a 
+// fixed size buffer whose unused tail is zeroed
+// 
+static int
+Harness_Match(
+    const NAME_MATCHER* Matcher,
+    const char* Name
+)
+{
+    char buffer[HARNESS_MAX_NAME_SIZE];
+
+    memset(buffer, 0, sizeof(buffer));
+    memcpy(buffer, Name, strlen(Name));
+
+    return NameMatcher_Match(Matcher, buffer, strnlen(buffer, sizeof(buffer)), HarnessUnknown);
+}
+
+//
+// Exact names match regardless of ASCII case and nothing else
+// 
+static void
+Harness_TestExact(void)
+{
+    NAME_MATCHER matcher;
+
+    NameMatcher_Init(&matcher);
+    Harness_Add(&matcher, "PLAYSTATION(R)3 Controller", HarnessSixaxis);
+    Harness_Add(&matcher, "Navigation Controller", HarnessNavigation);
+    Harness_Add(&matcher, "Motion Controller", HarnessMotion);
+
+    HARNESS_EXPECT(Harness_Match(&matcher, "PLAYSTATION(R)3 Controller") == HarnessSixaxis);
+    HARNESS_EXPECT(Harness_Match(&matcher, "playstation(r)3 controller") == HarnessSixaxis);
+    HARNESS_EXPECT(Harness_Match(&matcher, "Navigation Controller") == HarnessNavigation);
+    HARNESS_EXPECT(Harness_Match(&matcher, "Motion Controller") == HarnessMotion);
+
+    //
+    // A pattern is not a prefix, neither is a name
+    // 
+    HARNESS_EXPECT(Harness_Match(&matcher, "PLAYSTATION(R)3") == HarnessUnknown);
+    HARNESS_EXPECT(Harness_Match(&matcher, "PLAYSTATION(R)3 Controller 2") == HarnessUnknown);
+    HARNESS_EXPECT(Harness_Match(&matcher, "") == HarnessUnknown);
+}
+
+//
+// Prefix matching needs an explicit trailing star
+// 
+static void
+Harness_TestPrefix(void)
+{
+    NAME_MATCHER matcher;
+
+    NameMatcher_Init(&matcher);
+    Harness_Add(&matcher, "PLAYSTATION(R)3*", HarnessSixaxis);
+    Harness_Add(&matcher, "Wireless Controller", HarnessWireless);
+
+    HARNESS_EXPECT(Harness_Match(&matcher, "PLAYSTATION(R)3") == HarnessSixaxis);
+    HARNESS_EXPECT(Harness_Match(&matcher, "PLAYSTATION(R)3 Controller") == HarnessSixaxis);
+    HARNESS_EXPECT(Harness_Match(&matcher, "PlayStation(R)3Controller") == HarnessSixaxis);
+    HARNESS_EXPECT(Harness_Match(&matcher, "PLAYSTATION(R)") == HarnessUnknown);
+    HARNESS_EXPECT(Harness_Match(&matcher, "Wireless Controller") == HarnessWireless);
+
+    //
+    // Earlier patterns win, wildcard or not
+    // 
+    NameMatcher_Init(&matcher);
+    Harness_Add(&matcher, "Motion Controller", HarnessMotion);
+    Harness_Add(&matcher, "*Controller", HarnessSixaxis);
+    Harness_Add(&matcher, "Navigation Controller", HarnessNavigation);
+
+    HARNESS_EXPECT(Harness_Match(&matcher, "Motion Controller") == HarnessMotion);
+    HARNESS_EXPECT(Harness_Match(&matcher, "Navigation Controller") == HarnessSixaxis);
+    HARNESS_EXPECT(Harness_Match(&matcher, "Nav?gation Controller") == HarnessSixaxis);
+}
+
+//
+// Whatever follows the first NUL of the name buffer is ignored, padding 
+// before it is part of the name
+// 
+static void
+Harness_TestPadding(void)
+{
+    NAME_MATCHER matcher;
+    char buffer[HARNESS_MAX_NAME_SIZE];
+
+    NameMatcher_Init(&matcher);
+    Harness_Add(&matcher, "Motion Controller", HarnessMotion);
+
+    memset(buffer, 0, sizeof(buffer));
+    strcpy(buffer, "Motion Controller");
+    strcpy(buffer + strlen(buffer) + 1, "garbage");
+
+    HARNESS_EXPECT(NameMatcher_Match(&matcher, buffer, strnlen(buffer, sizeof(buffer)), HarnessUnknown) == HarnessMotion);
+
+    //
+    // Length including the terminator is a different name
+    // 
+    HARNESS_EXPECT(NameMatcher_Match(&matcher, buffer, strlen(buffer) + 1, HarnessUnknown) == HarnessUnknown);
+
+    HARNESS_EXPECT(Harness_Match(&matcher, "Motion Controller ") == HarnessUnknown);
+    HARNESS_EXPECT(Harness_Match(&matcher, " Motion Controller") == HarnessUnknown);
+
+    //
+    // Unterminated name filling the whole buffer
+    // 
+    memset(buffer, 'A', sizeof(buffer));
+    HARNESS_EXPECT(NameMatcher_Match(&matcher, buffer, strnlen(buffer, sizeof(buffer)), HarnessUnknown) == HarnessUnknown);
+
+    Harness_Add(&matcher, "A*", HarnessNavigation);
+    HARNESS_EXPECT(NameMatcher_Match(&matcher, buffer, strnlen(buffer, sizeof(buffer)), HarnessUnknown) == HarnessNavigation);
+}
+
+//
+// Non-ASCII bytes are compared as-is
+// 
+static void
+Harness_TestUtf8(void)
+{
+    NAME_MATCHER matcher;
+
+    NameMatcher_Init(&matcher);
+    Harness_Add(&matcher, "Contr\xC3\xB4leur", HarnessSixaxis);
+
+    HARNESS_EXPECT(Harness_Match(&matcher, "CONTR\xC3\xB4LEUR") == HarnessSixaxis);
+    HARNESS_EXPECT(Harness_Match(&matcher, "CONTR\xC3\x94LEUR") == HarnessUnknown);
+}
+
+int
+main(void)
+{
+    Harness_TestExact();
+    Harness_TestPrefix();
+    Harness_TestPadding();
+    Harness_TestUtf8();
+
+    if (G_Failures != 0)
+    {
+        fprintf(stderr, "%d expectation(s) failed\n", G_Failures);
+        return EXIT_FAILURE;
+    }
+
+    printf("All tests passed\n");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,286 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3 - Windows kernel-mode Bluetooth profile and bus driver                  *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#include "NameMatcher.h"
+
+#define NAME_MATCHER_FNV_OFFSET     2166136261u
+#define NAME_MATCHER_FNV_PRIME      16777619u
+#define NAME_MATCHER_NO_MATCH       ((unsigned int)-1)
+
+//
+// Upper-cases ASCII characters, leaves everything else untouched
+// 
+char
+NameMatcher_ToUpper(
+    char Character
+)
+{
+    return (Character >= 'a' && Character <= 'z') ? (char)(Character - ('a' - 'A')) : Character;
+}
+
+//
+// FNV-1a hash of the upper-cased input
+// 
+unsigned int
+NameMatcher_Hash(
+    const char* Text,
+    size_t Length
+)
+{
+    unsigned int hash = NAME_MATCHER_FNV_OFFSET;
+
+    for (size_t index = 0; index < Length; index++)
+    {
+        hash ^= (unsigned char)NameMatcher_ToUpper(Text[index]);
+        hash *= NAME_MATCHER_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+//
+// Matches a name against an upper-cased pattern supporting '*' and '?'
+// 
+int
+NameMatcher_GlobMatch(
+    const char* Pattern,
+    size_t PatternLength,
+    const char* Name,
+    size_t NameLength
+)
+{
+    size_t p = 0, n = 0;
+    size_t starPattern = (size_t)-1, starName = 0;
+
+    while (n < NameLength)
+    {
+        if (p < PatternLength && (Pattern[p] == '?' || Pattern[p] == NameMatcher_ToUpper(Name[n])))
+        {
+            p++;
+            n++;
+        }
+        else if (p < PatternLength && Pattern[p] == '*')
+        {
+            //
+            // Remember position, initially let the star match nothing
+            // 
+            starPattern = p++;
+            starName = n;
+        }
+        else if (starPattern != (size_t)-1)
+        {
+            //
+            // Mismatch, let the last star swallow one more character
+            // 
+            p = starPattern + 1;
+            n = ++starName;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+    while (p < PatternLength && Pattern[p] == '*')
+    {
+        p++;
+    }
+
+    return p == PatternLength;
+}
+
+//
+// Resets the matcher to contain no patterns
+// 
+void
+NameMatcher_Init(
+    PNAME_MATCHER Matcher
+)
+{
+    Matcher->PatternCount = 0;
+    Matcher->WildcardCount = 0;
+    Matcher->TextLength = 0;
+
+    for (unsigned int index = 0; index < NAME_MATCHER_BUCKET_COUNT; index++)
+    {
+        Matcher->Buckets[index] = 0;
+    }
+}
+
+//
+// Compiles a pattern, returns non-zero on success and zero if out of space.
+// 
+// Duplicate exact patterns are accepted but the first one added wins.
+// 
+int
+NameMatcher_Add(
+    PNAME_MATCHER Matcher,
+    const char* Pattern,
+    size_t Length,
+    int Value
+)
+{
+    int isWildcard = 0;
+
+    if (Matcher->PatternCount >= NAME_MATCHER_MAX_PATTERNS
+        || Length > NAME_MATCHER_MAX_TEXT - Matcher->TextLength)
+    {
+        return 0;
+    }
+
+    const unsigned int patternIndex = Matcher->PatternCount;
+    const PNAME_MATCHER_PATTERN pPattern = &Matcher->Patterns[patternIndex];
+    char* text = &Matcher->Text[Matcher->TextLength];
+
+    for (size_t index = 0; index < Length; index++)
+    {
+        text[index] = NameMatcher_ToUpper(Pattern[index]);
+
+        if (text[index] == '*' || text[index] == '?')
+        {
+            isWildcard = 1;
+        }
+    }
+
+    pPattern->Offset = (unsigned short)Matcher->TextLength;
+    pPattern->Length = (unsigned short)Length;
+    pPattern->Value = Value;
+    pPattern->Hash = NameMatcher_Hash(text, Length);
+
+    if (isWildcard)
+    {
+        Matcher->Wildcards[Matcher->WildcardCount++] = (unsigned char)patternIndex;
+    }
+    else
+    {
+        unsigned int bucket = pPattern->Hash & (NAME_MATCHER_BUCKET_COUNT - 1);
+
+        while (Matcher->Buckets[bucket] != 0)
+        {
+            const PNAME_MATCHER_PATTERN pExisting = &Matcher->Patterns[Matcher->Buckets[bucket] - 1];
+
+            if (pExisting->Hash == pPattern->Hash && pExisting->Length == pPattern->Length)
+            {
+                size_t index = 0;
+
+                while (index < Length && Matcher->Text[pExisting->Offset + index] == text[index])
+                {
+                    index++;
+                }
+
+                //
+                // Already present with higher precedence, nothing to store
+                // 
+                if (index == Length)
+                {
+                    return 1;
+                }
+            }
+
+            bucket = (bucket + 1) & (NAME_MATCHER_BUCKET_COUNT - 1);
+        }
+
+        Matcher->Buckets[bucket] = (unsigned char)(patternIndex + 1);
+    }
+
+    Matcher->TextLength += (unsigned int)Length;
+    Matcher->PatternCount++;
+
+    return 1;
+}
+
+//
+// Returns the value of the earliest added pattern matching the name, DefaultValue if none
+// 
+int
+NameMatcher_Match(
+    const NAME_MATCHER* Matcher,
+    const char* Name,
+    size_t Length,
+    int DefaultValue
+)
+{
+    unsigned int exactIndex = NAME_MATCHER_NO_MATCH;
+    const unsigned int hash = NameMatcher_Hash(Name, Length);
+    unsigned int bucket = hash & (NAME_MATCHER_BUCKET_COUNT - 1);
+
+    while (Matcher->Buckets[bucket] != 0)
+    {
+        const unsigned int patternIndex = Matcher->Buckets[bucket] - 1u;
+        const NAME_MATCHER_PATTERN* pPattern = &Matcher->Patterns[patternIndex];
+
+        if (pPattern->Hash == hash && pPattern->Length == Length)
+        {
+            size_t index = 0;
+
+            while (index < Length
+                && Matcher->Text[pPattern->Offset + index] == NameMatcher_ToUpper(Name[index]))
+            {
+                index++;
+            }
+
+            if (index == Length)
+            {
+                exactIndex = patternIndex;
+                break;
+            }
+        }
+
+        bucket = (bucket + 1) & (NAME_MATCHER_BUCKET_COUNT - 1);
+    }
+
+    //
+    // Wildcard patterns added before the exact hit take precedence
+    // 
+    for (unsigned int index = 0; index < Matcher->WildcardCount; index++)
+    {
+        const unsigned int patternIndex = Matcher->Wildcards[index];
+        const NAME_MATCHER_PATTERN* pPattern = &Matcher->Patterns[patternIndex];
+
+        if (patternIndex > exactIndex)
+        {
+            break;
+        }
+
+        if (NameMatcher_GlobMatch(&Matcher->Text[pPattern->Offset], pPattern->Length, Name, Length))
+        {
+            return pPattern->Value;
+        }
+    }
+
+    return (exactIndex != NAME_MATCHER_NO_MATCH) ? Matcher->Patterns[exactIndex].Value : DefaultValue;
+}
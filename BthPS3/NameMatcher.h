@@ -37,14 +37,112 @@
 
 #pragma once
 
-BOOLEAN
-StringUtil_BthNameIsEqual(
-    PCHAR Lhs,
-    WDFSTRING Rhs
+//
+// Portable (no kernel or WDF dependencies) matcher for remote device names.
+// 
+// Patterns are compiled once when settings load, lookups then cost one hash 
+// probe plus a scan of the (typically empty) wildcard pattern list.
+// 
+// Comparison is case-insensitive for ASCII characters, the rest of the 
+// UTF-8 input is compared byte by byte.
+// 
+
+#include <stddef.h>
+
+#define NAME_MATCHER_MAX_PATTERNS       64
+#define NAME_MATCHER_MAX_TEXT           4096
+#define NAME_MATCHER_BUCKET_COUNT       128 /* power of two, at least twice NAME_MATCHER_MAX_PATTERNS */
+
+typedef struct _NAME_MATCHER_PATTERN
+{
+    //
+    // Offset of upper-cased pattern text in Text
+    // 
+    unsigned short Offset;
+
+    //
+    // Pattern text length in bytes
+    // 
+    unsigned short Length;
+
+    //
+    // Value returned on match
+    // 
+    int Value;
+
+    //
+    // Upper-cased FNV-1a hash, only used by exact patterns
+    // 
+    unsigned int Hash;
+
+} NAME_MATCHER_PATTERN, *PNAME_MATCHER_PATTERN;
+
+typedef struct _NAME_MATCHER
+{
+    //
+    // Patterns in insertion order, earlier ones take precedence
+    // 
+    NAME_MATCHER_PATTERN Patterns[NAME_MATCHER_MAX_PATTERNS];
+
+    unsigned int PatternCount;
+
+    //
+    // Indexes (in insertion order) of patterns containing '*' or '?'
+    // 
+    unsigned char Wildcards[NAME_MATCHER_MAX_PATTERNS];
+
+    unsigned int WildcardCount;
+
+    //
+    // Open-addressed table of exact patterns, holds index + 1, 0 if free
+    // 
+    unsigned char Buckets[NAME_MATCHER_BUCKET_COUNT];
+
+    //
+    // Upper-cased pattern text storage
+    // 
+    char Text[NAME_MATCHER_MAX_TEXT];
+
+    unsigned int TextLength;
+
+} NAME_MATCHER, *PNAME_MATCHER;
+
+char
+NameMatcher_ToUpper(
+    char Character
+);
+
+unsigned int
+NameMatcher_Hash(
+    const char* Text,
+    size_t Length
+);
+
+int
+NameMatcher_GlobMatch(
+    const char* Pattern,
+    size_t PatternLength,
+    const char* Name,
+    size_t NameLength
+);
+
+void
+NameMatcher_Init(
+    PNAME_MATCHER Matcher
+);
+
+int
+NameMatcher_Add(
+    PNAME_MATCHER Matcher,
+    const char* Pattern,
+    size_t Length,
+    int Value
 );
 
-BOOLEAN
-StringUtil_BthNameIsInCollection(
-    PCHAR Entry,
-    WDFCOLLECTION Array
+int
+NameMatcher_Match(
+    const NAME_MATCHER* Matcher,
+    const char* Name,
+    size_t Length,
+    int DefaultValue
 );
@@ -37,6 +37,7 @@
 
 #include "Driver.h"
 #include "psm.tmh"
+#include "BthPS3ETW.h"
 
 
  //
@@ -103,6 +104,234 @@ BthPS3PSM_EnablePatchSync(
 	);
 }
 
+//
+// Request filter driver to restrict PSM patching to or exclude remote addresses (PASSIVE_LEVEL only)
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3PSM_SetPatchScopeSync(
+	WDFIOTARGET IoTarget,
+	ULONG DeviceIndex,
+	BTHPS3PSM_PATCH_SCOPE Scope,
+	const BTH_ADDR* Addresses,
+	ULONG Count
+)
+{
+	WDF_MEMORY_DESCRIPTOR MemoryDescriptor;
+	BTHPS3PSM_SET_PATCH_SCOPE payload;
+
+	if (Count > BTHPS3PSM_MAX_SCOPE_ADDRESSES)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	RtlZeroMemory(&payload, sizeof(payload));
+
+	payload.DeviceIndex = DeviceIndex;
+	payload.Scope = Scope;
+	payload.Count = Count;
+
+	for (ULONG index = 0; index < Count; index++)
+	{
+		payload.Addresses[index] = Addresses[index];
+	}
+
+	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+		&MemoryDescriptor,
+		(PVOID)&payload,
+		sizeof(payload)
+	);
+
+	return WdfIoTargetSendIoctlSynchronously(
+		IoTarget,
+		NULL,
+		IOCTL_BTHPS3PSM_SET_PATCH_SCOPE,
+		&MemoryDescriptor,
+		NULL,
+		NULL,
+		NULL
+	);
+}
+
+//
+// Schedules the expiry timer for the earliest lapsing exclusion, caller holds ExcludedLock
+// 
+static VOID
+BthPS3PSM_ArmExclusionExpiry(
+	PBTHPS3_SERVER_CONTEXT Context
+)
+{
+	const ULONGLONG now = KeQueryInterruptTime();
+	ULONGLONG earliest = 0;
+
+	for (ULONG index = 0; index < Context->PsmFilter.ExcludedCount; index++)
+	{
+		const ULONGLONG until = Context->PsmFilter.ExcludedUntil[index];
+
+		if (until != 0 && (earliest == 0 || until < earliest))
+		{
+			earliest = until;
+		}
+	}
+
+	if (earliest == 0)
+	{
+		(void)WdfTimerStop(Context->PsmFilter.ExclusionExpiryTimer, FALSE);
+		return;
+	}
+
+	//
+	// Relative due time, already lapsed entries get lifted right away
+	// 
+	(void)WdfTimerStart(
+		Context->PsmFilter.ExclusionExpiryTimer,
+		-(LONGLONG)((earliest > now) ? (earliest - now) : 1)
+	);
+}
+
+//
+// Stop the filter from patching connections of an unsupported remote device (PASSIVE_LEVEL only)
+// 
+// The exclusion is lifted again after ExpirySeconds (0 keeps it until the driver unloads).
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3PSM_ExcludeRemoteSync(
+	PBTHPS3_SERVER_CONTEXT Context,
+	ULONG DeviceIndex,
+	BTH_ADDR RemoteAddress,
+	ULONG ExpirySeconds
+)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+	BOOLEAN isExcluded = FALSE;
+	BTH_ADDR addresses[BTHPS3PSM_MAX_SCOPE_ADDRESSES];
+	ULONG count;
+	ULONG slot = 0;
+	const ULONGLONG now = KeQueryInterruptTime();
+
+	WdfWaitLockAcquire(Context->PsmFilter.ExcludedLock, NULL);
+
+	count = Context->PsmFilter.ExcludedCount;
+
+	for (ULONG index = 0; index < count; index++)
+	{
+		if (Context->PsmFilter.ExcludedAddresses[index] == RemoteAddress)
+		{
+			isExcluded = TRUE;
+			break;
+		}
+	}
+
+	if (!isExcluded)
+	{
+		RtlCopyMemory(addresses, Context->PsmFilter.ExcludedAddresses, sizeof(addresses));
+
+		//
+		// Oldest exclusion makes room once full
+		// 
+		if (count < BTHPS3PSM_MAX_SCOPE_ADDRESSES)
+		{
+			slot = count++;
+		}
+		else
+		{
+			for (ULONG index = 1; index < count; index++)
+			{
+				if (Context->PsmFilter.ExcludedSince[index] < Context->PsmFilter.ExcludedSince[slot])
+				{
+					slot = index;
+				}
+			}
+		}
+
+		addresses[slot] = RemoteAddress;
+
+		status = BthPS3PSM_SetPatchScopeSync(
+			Context->PsmFilter.IoTarget,
+			DeviceIndex,
+			BTHPS3PSM_PATCH_SCOPE_DENY_LIST,
+			addresses,
+			count
+		);
+
+		//
+		// Only remember what the filter accepted, a rejecting filter gets asked again next time
+		// 
+		if (NT_SUCCESS(status))
+		{
+			RtlCopyMemory(Context->PsmFilter.ExcludedAddresses, addresses, sizeof(addresses));
+			Context->PsmFilter.ExcludedSince[slot] = now;
+			Context->PsmFilter.ExcludedUntil[slot] = (ExpirySeconds != 0)
+				? now + (ULONGLONG)ExpirySeconds * 10000000
+				: 0;
+			Context->PsmFilter.ExcludedCount = count;
+			Context->PsmFilter.ExcludedDeviceIndex = DeviceIndex;
+
+			BthPS3PSM_ArmExclusionExpiry(Context);
+		}
+	}
+
+	WdfWaitLockRelease(Context->PsmFilter.ExcludedLock);
+
+	return status;
+}
+
+//
+// Lifts lapsed exclusions and hands the remaining ones to the filter (PASSIVE_LEVEL only)
+// 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+BthPS3PSM_ExpireExclusionsSync(
+	PBTHPS3_SERVER_CONTEXT Context
+)
+{
+	NTSTATUS status;
+	ULONG kept = 0;
+	const ULONGLONG now = KeQueryInterruptTime();
+
+	WdfWaitLockAcquire(Context->PsmFilter.ExcludedLock, NULL);
+
+	for (ULONG index = 0; index < Context->PsmFilter.ExcludedCount; index++)
+	{
+		const ULONGLONG until = Context->PsmFilter.ExcludedUntil[index];
+
+		if (until != 0 && until <= now)
+		{
+			continue;
+		}
+
+		Context->PsmFilter.ExcludedAddresses[kept] = Context->PsmFilter.ExcludedAddresses[index];
+		Context->PsmFilter.ExcludedSince[kept] = Context->PsmFilter.ExcludedSince[index];
+		Context->PsmFilter.ExcludedUntil[kept] = until;
+		kept++;
+	}
+
+	if (kept != Context->PsmFilter.ExcludedCount)
+	{
+		Context->PsmFilter.ExcludedCount = kept;
+
+		if (!NT_SUCCESS(status = BthPS3PSM_SetPatchScopeSync(
+			Context->PsmFilter.IoTarget,
+			Context->PsmFilter.ExcludedDeviceIndex,
+			BTHPS3PSM_PATCH_SCOPE_DENY_LIST,
+			Context->PsmFilter.ExcludedAddresses,
+			kept
+		)))
+		{
+			EventWriteFilterAutoEnabledFailed(NULL, status);
+		}
+		else
+		{
+			EventWriteFilterAutoEnabledSuccessfully(NULL);
+		}
+	}
+
+	BthPS3PSM_ArmExclusionExpiry(Context);
+
+	WdfWaitLockRelease(Context->PsmFilter.ExcludedLock);
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 NTSTATUS
 BthPS3PSM_EnablePatchAsync(
@@ -51,6 +51,31 @@ BthPS3PSM_EnablePatchSync(
 	ULONG DeviceIndex
 );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3PSM_SetPatchScopeSync(
+	WDFIOTARGET IoTarget,
+	ULONG DeviceIndex,
+	BTHPS3PSM_PATCH_SCOPE Scope,
+	const BTH_ADDR* Addresses,
+	ULONG Count
+);
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3PSM_ExcludeRemoteSync(
+	PBTHPS3_SERVER_CONTEXT Context,
+	ULONG DeviceIndex,
+	BTH_ADDR RemoteAddress,
+	ULONG ExpirySeconds
+);
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+BthPS3PSM_ExpireExclusionsSync(
+	PBTHPS3_SERVER_CONTEXT Context
+);
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 NTSTATUS
 BthPS3PSM_EnablePatchAsync(
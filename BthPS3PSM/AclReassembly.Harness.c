@@ -0,0 +1,520 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3PSM - Windows kernel-mode BTHUSB lower filter driver                     *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+//
+// User-mode harness for the portable ACL reassembly parser, not part of the driver build.
+//
+// Known-answer tests and a throughput benchmark:
+//   cc -O2 -o aclreassembly AclReassembly.c AclReassembly.Harness.c && ./aclreassembly [MiB]
+//
+// libFuzzer target, splits every input into transfers and checks that the split
+// doesn't change what the parser sees:
+//   clang -g -O1 -fsanitize=fuzzer,address,undefined -DACL_REASSEMBLY_FUZZ -o aclreassembly_fuzz AclReassembly.c AclReassembly.Harness.c
+// 
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "AclReassembly.h"
+
+#define HARNESS_PSM_HID_CONTROL     0x0011
+#define HARNESS_PSM_HID_INTERRUPT   0x0013
+#define HARNESS_PSM_PATCHED_CONTROL 0x5053
+
+//
+// Observations of one parser run
+// 
+typedef struct _HARNESS_RESULT
+{
+    unsigned long long Commands;
+
+    unsigned long long ConnectionRequests;
+
+    //
+    // Sum over completed command codes, identifiers and lengths
+    // 
+    unsigned long long CommandChecksum;
+
+} HARNESS_RESULT, *PHARNESS_RESULT;
+
+//
+// Same mapping the driver applies by default for HID Control
+// 
+static unsigned short
+Harness_PatchPsm(
+    void* Context,
+    unsigned short ConnectionHandle,
+    unsigned short Psm
+)
+{
+    const PHARNESS_RESULT pResult = (PHARNESS_RESULT)Context;
+
+    (void)ConnectionHandle;
+
+    pResult->ConnectionRequests++;
+
+    return (Psm == HARNESS_PSM_HID_CONTROL) ? HARNESS_PSM_PATCHED_CONTROL : Psm;
+}
+
+static void
+Harness_CommandCompleted(
+    void* Context,
+    const ACL_REASSEMBLY_COMMAND* Command
+)
+{
+    const PHARNESS_RESULT pResult = (PHARNESS_RESULT)Context;
+
+    pResult->Commands++;
+    pResult->CommandChecksum += Command->Code + (Command->Identifier << 8) + ((unsigned long long)Command->Length << 16);
+}
+
+//
+// Appends an HCI ACL header, returns bytes written
+// 
+static size_t
+Harness_PutHci(
+    unsigned char* Buffer,
+    unsigned short Handle,
+    unsigned int PacketBoundary,
+    unsigned short Length
+)
+{
+    Buffer[0] = (unsigned char)(Handle & 0xFF);
+    Buffer[1] = (unsigned char)(((Handle >> 8) & 0x0F) | (PacketBoundary << 4));
+    Buffer[2] = (unsigned char)(Length & 0xFF);
+    Buffer[3] = (unsigned char)(Length >> 8);
+
+    return ACL_REASSEMBLY_HCI_HEADER_LENGTH;
+}
+
+//
+// Appends a complete ACL packet carrying an L2CAP Connection Request, returns bytes written
+// 
+static size_t
+Harness_PutConnectionRequest(
+    unsigned char* Buffer,
+    unsigned short Handle,
+    unsigned char Identifier,
+    unsigned short Psm,
+    unsigned short SourceCid
+)
+{
+    static const unsigned short pduLength = ACL_REASSEMBLY_COMMAND_HEADER_LENGTH + 4;
+    size_t length = Harness_PutHci(Buffer, Handle, 0x02, ACL_REASSEMBLY_L2CAP_HEADER_LENGTH + pduLength);
+    unsigned char* p = Buffer + length;
+
+    *p++ = (unsigned char)pduLength;
+    *p++ = 0;
+    *p++ = ACL_REASSEMBLY_SIGNALLING_CID;
+    *p++ = 0;
+    *p++ = ACL_REASSEMBLY_CONNECTION_REQUEST;
+    *p++ = Identifier;
+    *p++ = 4;
+    *p++ = 0;
+    *p++ = (unsigned char)(Psm & 0xFF);
+    *p++ = (unsigned char)(Psm >> 8);
+    *p++ = (unsigned char)(SourceCid & 0xFF);
+    *p++ = (unsigned char)(SourceCid >> 8);
+
+    return (size_t)(p - Buffer);
+}
+
+//
+// Appends a complete ACL packet on a data channel, returns bytes written
+// 
+static size_t
+Harness_PutData(
+    unsigned char* Buffer,
+    unsigned short Handle,
+    unsigned short Cid,
+    unsigned short PayloadLength
+)
+{
+    size_t length = Harness_PutHci(Buffer, Handle, 0x02, ACL_REASSEMBLY_L2CAP_HEADER_LENGTH + PayloadLength);
+    unsigned char* p = Buffer + length;
+
+    *p++ = (unsigned char)(PayloadLength & 0xFF);
+    *p++ = (unsigned char)(PayloadLength >> 8);
+    *p++ = (unsigned char)(Cid & 0xFF);
+    *p++ = (unsigned char)(Cid >> 8);
+
+    memset(p, 0xA1, PayloadLength);
+
+    return (size_t)(p - Buffer) + PayloadLength;
+}
+
+static unsigned short
+Harness_GetPsm(
+    const unsigned char* Packet
+)
+{
+    return (unsigned short)(Packet[12] | (Packet[13] << 8));
+}
+
+#ifdef ACL_REASSEMBLY_FUZZ
+
+//
+// Runs the input as one transfer and again split at offsets taken from its
+// first bytes; reported commands must not depend on transfer boundaries
+// 
+int
+LLVMFuzzerTestOneInput(
+    const unsigned char* Data,
+    size_t Size
+)
+{
+    static ACL_REASSEMBLY whole, split;
+    HARNESS_RESULT wholeResult = { 0 };
+    HARNESS_RESULT splitResult = { 0 };
+    unsigned char* copy;
+    size_t position = 0;
+    size_t splitIndex = 0;
+
+    if (Size < 4)
+    {
+        return 0;
+    }
+
+    copy = (unsigned char*)malloc(Size);
+
+    if (copy == NULL)
+    {
+        return 0;
+    }
+
+    AclReassembly_Init(&whole, Harness_PatchPsm, Harness_CommandCompleted, &wholeResult);
+    AclReassembly_Init(&split, Harness_PatchPsm, Harness_CommandCompleted, &splitResult);
+
+    memcpy(copy, Data + 4, Size - 4);
+    AclReassembly_Process(&whole, copy, Size - 4);
+
+    memcpy(copy, Data + 4, Size - 4);
+
+    while (position < Size - 4)
+    {
+        size_t chunk = (size_t)Data[splitIndex++ % 4] + 1;
+
+        if (chunk > Size - 4 - position)
+        {
+            chunk = Size - 4 - position;
+        }
+
+        AclReassembly_Process(&split, copy + position, chunk);
+        position += chunk;
+    }
+
+    if (wholeResult.Commands != splitResult.Commands
+        || wholeResult.ConnectionRequests != splitResult.ConnectionRequests
+        || wholeResult.CommandChecksum != splitResult.CommandChecksum
+        || whole.Patched != split.Patched + split.Unpatchable
+        || whole.Unpatchable != 0)
+    {
+        abort();
+    }
+
+    free(copy);
+
+    return 0;
+}
+
+#else
+
+static int G_Failures = 0;
+
+#define HARNESS_EXPECT(_cond_)                                              \
+    do {                                                                    \
+        if (!(_cond_)) {                                                    \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #_cond_); \
+            G_Failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+//
+// Connection Request in a single transfer gets patched in place
+// 
+static void
+Harness_TestSingle(void)
+{
+    ACL_REASSEMBLY reassembly;
+    HARNESS_RESULT result = { 0 };
+    unsigned char buffer[64];
+    const size_t length = Harness_PutConnectionRequest(buffer, 0x0040, 1, HARNESS_PSM_HID_CONTROL, 0x0070);
+
+    AclReassembly_Init(&reassembly, Harness_PatchPsm, Harness_CommandCompleted, &result);
+    AclReassembly_Process(&reassembly, buffer, length);
+
+    HARNESS_EXPECT(result.Commands == 1);
+    HARNESS_EXPECT(reassembly.Patched == 1);
+    HARNESS_EXPECT(Harness_GetPsm(buffer) == HARNESS_PSM_PATCHED_CONTROL);
+}
+
+//
+// Request behind a data packet of another handle in the same transfer
+// 
+static void
+Harness_TestCoalesced(void)
+{
+    ACL_REASSEMBLY reassembly;
+    HARNESS_RESULT result = { 0 };
+    unsigned char buffer[256];
+    size_t length = Harness_PutData(buffer, 0x0041, 0x0040, 100);
+    const size_t request = length;
+
+    length += Harness_PutConnectionRequest(buffer + length, 0x0040, 2, HARNESS_PSM_HID_CONTROL, 0x0071);
+
+    AclReassembly_Init(&reassembly, Harness_PatchPsm, Harness_CommandCompleted, &result);
+    AclReassembly_Process(&reassembly, buffer, length);
+
+    HARNESS_EXPECT(result.Commands == 1);
+    HARNESS_EXPECT(Harness_GetPsm(buffer + request) == HARNESS_PSM_PATCHED_CONTROL);
+}
+
+//
+// Request split into an HCI start and continuation fragment, each its own transfer
+// 
+static void
+Harness_TestContinuation(void)
+{
+    ACL_REASSEMBLY reassembly;
+    HARNESS_RESULT result = { 0 };
+    unsigned char packet[64];
+    unsigned char first[64];
+    unsigned char second[64];
+    size_t firstLength;
+    size_t secondLength;
+
+    (void)Harness_PutConnectionRequest(packet, 0x0040, 3, HARNESS_PSM_HID_CONTROL, 0x0072);
+
+    //
+    // L2CAP header, command header and PSM in the first, source CID in the second fragment
+    // 
+    firstLength = Harness_PutHci(first, 0x0040, 0x02, 10);
+    memcpy(first + firstLength, packet + ACL_REASSEMBLY_HCI_HEADER_LENGTH, 10);
+    firstLength += 10;
+
+    secondLength = Harness_PutHci(second, 0x0040, ACL_REASSEMBLY_PB_CONTINUING_FRAGMENT, 2);
+    memcpy(second + secondLength, packet + ACL_REASSEMBLY_HCI_HEADER_LENGTH + 10, 2);
+    secondLength += 2;
+
+    AclReassembly_Init(&reassembly, Harness_PatchPsm, Harness_CommandCompleted, &result);
+    AclReassembly_Process(&reassembly, first, firstLength);
+
+    HARNESS_EXPECT(result.Commands == 0);
+
+    AclReassembly_Process(&reassembly, second, secondLength);
+
+    HARNESS_EXPECT(result.Commands == 1);
+    HARNESS_EXPECT(reassembly.Fragments == 1);
+    HARNESS_EXPECT(Harness_GetPsm(first) == HARNESS_PSM_PATCHED_CONTROL);
+}
+
+//
+// PSM bytes in different transfers can't be patched, only counted
+// 
+static void
+Harness_TestSplitPsm(void)
+{
+    ACL_REASSEMBLY reassembly;
+    HARNESS_RESULT result = { 0 };
+    unsigned char buffer[64];
+    const size_t length = Harness_PutConnectionRequest(buffer, 0x0040, 4, HARNESS_PSM_HID_CONTROL, 0x0073);
+
+    AclReassembly_Init(&reassembly, Harness_PatchPsm, Harness_CommandCompleted, &result);
+    AclReassembly_Process(&reassembly, buffer, 13);
+    AclReassembly_Process(&reassembly, buffer + 13, length - 13);
+
+    HARNESS_EXPECT(result.Commands == 1);
+    HARNESS_EXPECT(reassembly.Patched == 0);
+    HARNESS_EXPECT(reassembly.Unpatchable == 1);
+    HARNESS_EXPECT(Harness_GetPsm(buffer) == HARNESS_PSM_HID_CONTROL);
+}
+
+//
+// Continuation of a PDU whose start was never seen is discarded
+// 
+static void
+Harness_TestOrphanContinuation(void)
+{
+    ACL_REASSEMBLY reassembly;
+    HARNESS_RESULT result = { 0 };
+    unsigned char buffer[64];
+    size_t length = Harness_PutHci(buffer, 0x0042, ACL_REASSEMBLY_PB_CONTINUING_FRAGMENT, 8);
+
+    memset(buffer + length, 0x02, 8);
+    length += 8;
+    length += Harness_PutConnectionRequest(buffer + length, 0x0042, 5, HARNESS_PSM_HID_INTERRUPT, 0x0074);
+
+    AclReassembly_Init(&reassembly, Harness_PatchPsm, Harness_CommandCompleted, &result);
+    AclReassembly_Process(&reassembly, buffer, length);
+
+    HARNESS_EXPECT(reassembly.Discarded == 1);
+    HARNESS_EXPECT(result.Commands == 1);
+    HARNESS_EXPECT(result.ConnectionRequests == 1);
+}
+
+//
+// Transfers completing out of submission order, each parsed on its own from a
+// reset state the way the filter handles them, still get their requests patched
+// 
+static void
+Harness_TestOutOfOrder(void)
+{
+    ACL_REASSEMBLY reassembly;
+    HARNESS_RESULT result = { 0 };
+    unsigned char partial[64];
+    unsigned char earlier[64];
+    unsigned char later[64];
+    size_t partialLength = Harness_PutHci(partial, 0x0042, 0x02, 20);
+    const size_t earlierLength = Harness_PutConnectionRequest(earlier, 0x0040, 6, HARNESS_PSM_HID_CONTROL, 0x0075);
+    const size_t laterLength = Harness_PutConnectionRequest(later, 0x0041, 7, HARNESS_PSM_HID_CONTROL, 0x0076);
+
+    //
+    // Leaves the parser expecting the rest of an HCI packet
+    // 
+    memset(partial + partialLength, 0xA1, 8);
+    partialLength += 8;
+
+    AclReassembly_Init(&reassembly, Harness_PatchPsm, Harness_CommandCompleted, &result);
+    AclReassembly_Process(&reassembly, partial, partialLength);
+
+    //
+    // Later transfer completes first
+    // 
+    AclReassembly_Reset(&reassembly);
+    AclReassembly_Process(&reassembly, later, laterLength);
+
+    HARNESS_EXPECT(Harness_GetPsm(later) == HARNESS_PSM_PATCHED_CONTROL);
+
+    //
+    // Earlier transfer finds the stream stale
+    // 
+    AclReassembly_Reset(&reassembly);
+    AclReassembly_Process(&reassembly, earlier, earlierLength);
+
+    HARNESS_EXPECT(Harness_GetPsm(earlier) == HARNESS_PSM_PATCHED_CONTROL);
+    HARNESS_EXPECT(result.Commands == 2);
+    HARNESS_EXPECT(reassembly.Patched == 2);
+}
+
+//
+// Feeds a synthetic stream of mostly data packets with the odd Connection
+// Request in 4 KiB transfers, the way BTHUSB reads the bulk pipe
+// 
+static void
+Harness_Benchmark(
+    unsigned int MiB
+)
+{
+    ACL_REASSEMBLY reassembly;
+    HARNESS_RESULT result = { 0 };
+    static unsigned char stream[1024 * 1024];
+    size_t streamLength = 0;
+    unsigned int packet = 0;
+    clock_t start;
+    double seconds;
+
+    while (streamLength + 1100 < sizeof(stream))
+    {
+        if (packet++ % 64 == 0)
+        {
+            streamLength += Harness_PutConnectionRequest(
+                stream + streamLength, 0x0040, (unsigned char)packet, HARNESS_PSM_HID_INTERRUPT, 0x0040);
+        }
+        else
+        {
+            streamLength += Harness_PutData(
+                stream + streamLength, (unsigned short)(0x0040 + packet % 4), 0x0041, (unsigned short)(packet % 1000));
+        }
+    }
+
+    AclReassembly_Init(&reassembly, Harness_PatchPsm, Harness_CommandCompleted, &result);
+
+    start = clock();
+
+    for (unsigned int round = 0; round < MiB; round++)
+    {
+        for (size_t position = 0; position < streamLength; position += 4096)
+        {
+            const size_t chunk = (streamLength - position < 4096) ? streamLength - position : 4096;
+
+            AclReassembly_Process(&reassembly, stream + position, chunk);
+        }
+    }
+
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%u MiB in %.3f s, %.1f MiB/s, %llu packets, %llu commands\n",
+        MiB,
+        seconds,
+        (seconds > 0) ? MiB / seconds : 0.0,
+        reassembly.Packets,
+        result.Commands
+    );
+}
+
+int
+main(
+    int argc,
+    char* argv[]
+)
+{
+    Harness_TestSingle();
+    Harness_TestCoalesced();
+    Harness_TestContinuation();
+    Harness_TestSplitPsm();
+    Harness_TestOrphanContinuation();
+    Harness_TestOutOfOrder();
+
+    if (G_Failures != 0)
+    {
+        fprintf(stderr, "%d expectation(s) failed\n", G_Failures);
+        return EXIT_FAILURE;
+    }
+
+    printf("All tests passed\n");
+
+    if (argc > 1)
+    {
+        Harness_Benchmark((unsigned int)strtoul(argv[1], NULL, 10));
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif
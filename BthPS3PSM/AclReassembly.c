@@ -0,0 +1,418 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3PSM - Windows kernel-mode BTHUSB lower filter driver                     *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#include "AclReassembly.h"
+
+//
+// Resets a channel to not carry any PDU
+// 
+void
+AclReassembly_ResetChannel(
+    PACL_REASSEMBLY_CHANNEL Channel,
+    unsigned short ConnectionHandle
+)
+{
+    Channel->ConnectionHandle = ConnectionHandle;
+    Channel->IsInPdu = 0;
+    Channel->PduHeaderLength = 0;
+    Channel->PduRemaining = 0;
+    Channel->IsSignalling = 0;
+    Channel->CommandHeaderLength = 0;
+    Channel->CommandRemaining = 0;
+    Channel->CommandOffset = 0;
+    Channel->PsmLocation[0] = NULL;
+    Channel->PsmLocation[1] = NULL;
+}
+
+//
+// Initializes reassembly state and statistics
+// 
+void
+AclReassembly_Init(
+    PACL_REASSEMBLY Reassembly,
+    PFN_ACL_REASSEMBLY_PATCH_PSM PatchPsm,
+    PFN_ACL_REASSEMBLY_COMMAND CommandCompleted,
+    void* Context
+)
+{
+    Reassembly->PatchPsm = PatchPsm;
+    Reassembly->CommandCompleted = CommandCompleted;
+    Reassembly->Context = Context;
+
+    Reassembly->Packets = 0;
+    Reassembly->Fragments = 0;
+    Reassembly->ConnectionRequests = 0;
+    Reassembly->Patched = 0;
+    Reassembly->Unpatchable = 0;
+    Reassembly->Discarded = 0;
+
+    AclReassembly_Reset(Reassembly);
+}
+
+//
+// Drops all partially received data, next byte is expected to start an HCI packet
+// 
+void
+AclReassembly_Reset(
+    PACL_REASSEMBLY Reassembly
+)
+{
+    Reassembly->HciHeaderLength = 0;
+    Reassembly->HciRemaining = 0;
+    Reassembly->Current = NULL;
+    Reassembly->NextVictim = 0;
+
+    for (unsigned int index = 0; index < ACL_REASSEMBLY_MAX_CHANNELS; index++)
+    {
+        AclReassembly_ResetChannel(&Reassembly->Channels[index], ACL_REASSEMBLY_INVALID_HANDLE);
+    }
+}
+
+//
+// Looks up the channel of a connection handle, optionally claims one if not found
+// 
+PACL_REASSEMBLY_CHANNEL
+AclReassembly_GetChannel(
+    PACL_REASSEMBLY Reassembly,
+    unsigned short ConnectionHandle,
+    int Allocate
+)
+{
+    PACL_REASSEMBLY_CHANNEL pFree = NULL;
+
+    for (unsigned int index = 0; index < ACL_REASSEMBLY_MAX_CHANNELS; index++)
+    {
+        const PACL_REASSEMBLY_CHANNEL pChannel = &Reassembly->Channels[index];
+
+        if (pChannel->ConnectionHandle == ConnectionHandle)
+        {
+            return pChannel;
+        }
+
+        if (pFree == NULL && pChannel->ConnectionHandle == ACL_REASSEMBLY_INVALID_HANDLE)
+        {
+            pFree = pChannel;
+        }
+    }
+
+    if (!Allocate)
+    {
+        return NULL;
+    }
+
+    //
+    // Connection handles are never announced on this pipe, recycle the oldest claimed one
+    // 
+    if (pFree == NULL)
+    {
+        pFree = &Reassembly->Channels[Reassembly->NextVictim];
+        Reassembly->NextVictim = (Reassembly->NextVictim + 1) % ACL_REASSEMBLY_MAX_CHANNELS;
+    }
+
+    AclReassembly_ResetChannel(pFree, ConnectionHandle);
+
+    return pFree;
+}
+
+//
+// Reports the current command of a channel and expects the next one
+// 
+void
+AclReassembly_CompleteCommand(
+    PACL_REASSEMBLY Reassembly,
+    PACL_REASSEMBLY_CHANNEL Channel
+)
+{
+    Channel->CommandHeaderLength = 0;
+
+    if (Reassembly->CommandCompleted != NULL)
+    {
+        Reassembly->CommandCompleted(Reassembly->Context, &Channel->Command);
+    }
+}
+
+//
+// Feeds one byte of signalling channel payload
+// 
+void
+AclReassembly_ConsumeSignalling(
+    PACL_REASSEMBLY Reassembly,
+    PACL_REASSEMBLY_CHANNEL Channel,
+    unsigned char* Byte
+)
+{
+    //
+    // Command header: code, identifier, length (LE)
+    // 
+    if (Channel->CommandHeaderLength < ACL_REASSEMBLY_COMMAND_HEADER_LENGTH)
+    {
+        Channel->CommandHeader[Channel->CommandHeaderLength++] = *Byte;
+
+        if (Channel->CommandHeaderLength == ACL_REASSEMBLY_COMMAND_HEADER_LENGTH)
+        {
+            Channel->CommandRemaining = Channel->CommandHeader[2] | (Channel->CommandHeader[3] << 8);
+            Channel->CommandOffset = 0;
+
+            Channel->Command.ConnectionHandle = Channel->ConnectionHandle;
+            Channel->Command.Code = Channel->CommandHeader[0];
+            Channel->Command.Identifier = Channel->CommandHeader[1];
+            Channel->Command.Length = (unsigned short)Channel->CommandRemaining;
+            Channel->Command.DataLength = 0;
+            Channel->Command.IsPatched = 0;
+            Channel->Command.PatchedPsm = 0;
+
+            if (Channel->CommandRemaining == 0)
+            {
+                AclReassembly_CompleteCommand(Reassembly, Channel);
+            }
+        }
+
+        return;
+    }
+
+    if (Channel->Command.DataLength < ACL_REASSEMBLY_MAX_COMMAND_DATA)
+    {
+        Channel->Command.Data[Channel->Command.DataLength++] = *Byte;
+    }
+
+    //
+    // Connection Request data starts with the PSM (LE)
+    // 
+    if (Channel->CommandHeader[0] == ACL_REASSEMBLY_CONNECTION_REQUEST && Channel->CommandOffset < 2)
+    {
+        Channel->Psm[Channel->CommandOffset] = *Byte;
+        Channel->PsmLocation[Channel->CommandOffset] = Byte;
+
+        if (Channel->CommandOffset == 1)
+        {
+            const unsigned short psm = (unsigned short)(Channel->Psm[0] | (Channel->Psm[1] << 8));
+            const unsigned short newPsm = (Reassembly->PatchPsm != NULL)
+                ? Reassembly->PatchPsm(Reassembly->Context, Channel->ConnectionHandle, psm)
+                : psm;
+
+            Reassembly->ConnectionRequests++;
+
+            if (newPsm != psm)
+            {
+                //
+                // Low byte may have arrived with an already completed transfer
+                // 
+                if (Channel->PsmLocation[0] != NULL && Channel->PsmLocation[1] != NULL)
+                {
+                    *Channel->PsmLocation[0] = (unsigned char)(newPsm & 0xFF);
+                    *Channel->PsmLocation[1] = (unsigned char)(newPsm >> 8);
+                    Reassembly->Patched++;
+                    Channel->Command.IsPatched = 1;
+                    Channel->Command.PatchedPsm = newPsm;
+                }
+                else
+                {
+                    Reassembly->Unpatchable++;
+                }
+            }
+        }
+    }
+
+    Channel->CommandOffset++;
+
+    if (--Channel->CommandRemaining == 0)
+    {
+        AclReassembly_CompleteCommand(Reassembly, Channel);
+    }
+}
+
+//
+// Feeds HCI payload bytes belonging to the current PDU of a channel, returns bytes used
+// 
+size_t
+AclReassembly_ConsumePdu(
+    PACL_REASSEMBLY Reassembly,
+    PACL_REASSEMBLY_CHANNEL Channel,
+    unsigned char* Buffer,
+    size_t Length
+)
+{
+    size_t position = 0;
+
+    while (position < Length && Channel->IsInPdu)
+    {
+        //
+        // Basic header: length (LE), channel ID (LE)
+        // 
+        if (Channel->PduHeaderLength < ACL_REASSEMBLY_L2CAP_HEADER_LENGTH)
+        {
+            Channel->PduHeader[Channel->PduHeaderLength++] = Buffer[position++];
+
+            if (Channel->PduHeaderLength == ACL_REASSEMBLY_L2CAP_HEADER_LENGTH)
+            {
+                Channel->PduRemaining = Channel->PduHeader[0] | (Channel->PduHeader[1] << 8);
+                Channel->IsSignalling = (Channel->PduHeader[2] | (Channel->PduHeader[3] << 8))
+                    == ACL_REASSEMBLY_SIGNALLING_CID;
+                Channel->CommandHeaderLength = 0;
+
+                if (Channel->PduRemaining == 0)
+                {
+                    Channel->IsInPdu = 0;
+                }
+            }
+
+            continue;
+        }
+
+        if (Channel->IsSignalling)
+        {
+            AclReassembly_ConsumeSignalling(Reassembly, Channel, &Buffer[position]);
+            position++;
+            Channel->PduRemaining--;
+        }
+        else
+        {
+            //
+            // Not interested in data channels, skip in one go
+            // 
+            const size_t available = Length - position;
+            const size_t skip = (available < Channel->PduRemaining) ? available : Channel->PduRemaining;
+
+            position += skip;
+            Channel->PduRemaining -= (unsigned int)skip;
+        }
+
+        if (Channel->PduRemaining == 0)
+        {
+            Channel->IsInPdu = 0;
+        }
+    }
+
+    return position;
+}
+
+//
+// Feeds the content of a completed bulk IN transfer
+// 
+void
+AclReassembly_Process(
+    PACL_REASSEMBLY Reassembly,
+    unsigned char* Buffer,
+    size_t Length
+)
+{
+    size_t position = 0;
+
+    while (position < Length)
+    {
+        //
+        // Header: handle (12 bits) and flags (LE), data length (LE)
+        // 
+        if (Reassembly->HciRemaining == 0)
+        {
+            Reassembly->HciHeader[Reassembly->HciHeaderLength++] = Buffer[position++];
+
+            if (Reassembly->HciHeaderLength < ACL_REASSEMBLY_HCI_HEADER_LENGTH)
+            {
+                continue;
+            }
+
+            Reassembly->HciHeaderLength = 0;
+
+            const unsigned short handle = (unsigned short)
+                ((Reassembly->HciHeader[0] | (Reassembly->HciHeader[1] << 8)) & 0x0FFF);
+            const unsigned int packetBoundary = (Reassembly->HciHeader[1] >> 4) & 0x03;
+
+            Reassembly->HciRemaining = Reassembly->HciHeader[2] | (Reassembly->HciHeader[3] << 8);
+            Reassembly->Packets++;
+
+            if (packetBoundary == ACL_REASSEMBLY_PB_CONTINUING_FRAGMENT)
+            {
+                Reassembly->Fragments++;
+                Reassembly->Current = AclReassembly_GetChannel(Reassembly, handle, 0);
+
+                //
+                // Start of PDU was missed (or PDU already complete), can't interpret
+                // 
+                if (Reassembly->Current != NULL && !Reassembly->Current->IsInPdu)
+                {
+                    Reassembly->Current = NULL;
+                }
+            }
+            else
+            {
+                Reassembly->Current = AclReassembly_GetChannel(Reassembly, handle, 1);
+
+                //
+                // Previous PDU never completed, drop it
+                // 
+                if (Reassembly->Current->IsInPdu)
+                {
+                    Reassembly->Discarded++;
+                }
+
+                AclReassembly_ResetChannel(Reassembly->Current, handle);
+                Reassembly->Current->IsInPdu = 1;
+            }
+
+            if (Reassembly->Current == NULL && Reassembly->HciRemaining > 0)
+            {
+                Reassembly->Discarded++;
+            }
+
+            continue;
+        }
+
+        const size_t available = Length - position;
+        const size_t chunk = (available < Reassembly->HciRemaining) ? available : Reassembly->HciRemaining;
+
+        if (Reassembly->Current != NULL)
+        {
+            //
+            // Bytes beyond the end of the PDU are ignored
+            // 
+            (void)AclReassembly_ConsumePdu(Reassembly, Reassembly->Current, &Buffer[position], chunk);
+        }
+
+        position += chunk;
+        Reassembly->HciRemaining -= (unsigned int)chunk;
+    }
+
+    //
+    // Buffer is handed back to the caller, forget locations pointing into it
+    // 
+    for (unsigned int index = 0; index < ACL_REASSEMBLY_MAX_CHANNELS; index++)
+    {
+        Reassembly->Channels[index].PsmLocation[0] = NULL;
+        Reassembly->Channels[index].PsmLocation[1] = NULL;
+    }
+}
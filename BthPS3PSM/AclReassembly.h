@@ -0,0 +1,279 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3PSM - Windows kernel-mode BTHUSB lower filter driver                     *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#pragma once
+
+//
+// Portable (no kernel or WDF dependencies) streaming parser for HCI ACL data 
+// as received on the bulk IN pipe.
+// 
+// Reassembles L2CAP PDUs per connection handle across coalesced transfers, 
+// HCI continuation fragments and transfer boundaries and walks every command 
+// on the signalling channel, handing each Connection Request PSM to a callback 
+// which may replace it in place and reporting every completed command.
+// 
+
+#include <stddef.h>
+
+#define ACL_REASSEMBLY_MAX_CHANNELS             16
+#define ACL_REASSEMBLY_INVALID_HANDLE           0xFFFF
+
+#define ACL_REASSEMBLY_HCI_HEADER_LENGTH        4
+#define ACL_REASSEMBLY_L2CAP_HEADER_LENGTH      4
+#define ACL_REASSEMBLY_COMMAND_HEADER_LENGTH    4
+
+//
+// Leading command data bytes reported to PFN_ACL_REASSEMBLY_COMMAND
+// 
+#define ACL_REASSEMBLY_MAX_COMMAND_DATA         12
+
+#define ACL_REASSEMBLY_PB_CONTINUING_FRAGMENT   0x01
+#define ACL_REASSEMBLY_SIGNALLING_CID           0x0001
+#define ACL_REASSEMBLY_CONNECTION_REQUEST       0x02
+
+//
+// Invoked for every Connection Request, returns the PSM to put in its place
+// 
+typedef unsigned short (*PFN_ACL_REASSEMBLY_PATCH_PSM)(
+    void* Context,
+    unsigned short ConnectionHandle,
+    unsigned short Psm
+    );
+
+//
+// Signalling command as received (before patching)
+// 
+typedef struct _ACL_REASSEMBLY_COMMAND
+{
+    unsigned short ConnectionHandle;
+
+    unsigned char Code;
+
+    unsigned char Identifier;
+
+    //
+    // Length of command data as announced in the command header
+    // 
+    unsigned short Length;
+
+    //
+    // Leading bytes of command data
+    // 
+    unsigned char Data[ACL_REASSEMBLY_MAX_COMMAND_DATA];
+
+    unsigned int DataLength;
+
+    //
+    // Non-zero if the PSM of a Connection Request got replaced by PatchedPsm
+    // 
+    int IsPatched;
+
+    unsigned short PatchedPsm;
+
+} ACL_REASSEMBLY_COMMAND, *PACL_REASSEMBLY_COMMAND;
+
+//
+// Invoked for every completely received signalling command
+// 
+typedef void (*PFN_ACL_REASSEMBLY_COMMAND)(
+    void* Context,
+    const ACL_REASSEMBLY_COMMAND* Command
+    );
+
+//
+// Reassembly state of one ACL connection handle
+// 
+typedef struct _ACL_REASSEMBLY_CHANNEL
+{
+    //
+    // HCI connection handle, ACL_REASSEMBLY_INVALID_HANDLE if unused
+    // 
+    unsigned short ConnectionHandle;
+
+    //
+    // Non-zero while an L2CAP PDU is being received
+    // 
+    int IsInPdu;
+
+    //
+    // L2CAP basic header bytes collected so far
+    // 
+    unsigned char PduHeader[ACL_REASSEMBLY_L2CAP_HEADER_LENGTH];
+
+    unsigned int PduHeaderLength;
+
+    //
+    // L2CAP payload bytes still expected
+    // 
+    unsigned int PduRemaining;
+
+    //
+    // Non-zero if the PDU is addressed to the signalling channel
+    // 
+    int IsSignalling;
+
+    //
+    // Signalling command header bytes collected so far
+    // 
+    unsigned char CommandHeader[ACL_REASSEMBLY_COMMAND_HEADER_LENGTH];
+
+    unsigned int CommandHeaderLength;
+
+    //
+    // Signalling command data bytes still expected and consumed
+    // 
+    unsigned int CommandRemaining;
+
+    unsigned int CommandOffset;
+
+    //
+    // PSM bytes of a Connection Request and their location, pointers are 
+    // only valid within the AclReassembly_Process call that set them
+    // 
+    unsigned char Psm[2];
+
+    unsigned char* PsmLocation[2];
+
+    //
+    // Current command as reported once complete
+    // 
+    ACL_REASSEMBLY_COMMAND Command;
+
+} ACL_REASSEMBLY_CHANNEL, *PACL_REASSEMBLY_CHANNEL;
+
+//
+// Reassembly state of a bulk IN pipe
+// 
+typedef struct _ACL_REASSEMBLY
+{
+    //
+    // HCI ACL header bytes collected so far
+    // 
+    unsigned char HciHeader[ACL_REASSEMBLY_HCI_HEADER_LENGTH];
+
+    unsigned int HciHeaderLength;
+
+    //
+    // HCI ACL payload bytes still expected
+    // 
+    unsigned int HciRemaining;
+
+    //
+    // Channel receiving the current HCI payload, NULL if discarded
+    // 
+    PACL_REASSEMBLY_CHANNEL Current;
+
+    ACL_REASSEMBLY_CHANNEL Channels[ACL_REASSEMBLY_MAX_CHANNELS];
+
+    //
+    // Channel to reuse once all are occupied
+    // 
+    unsigned int NextVictim;
+
+    PFN_ACL_REASSEMBLY_PATCH_PSM PatchPsm;
+
+    //
+    // Optional, may be NULL
+    // 
+    PFN_ACL_REASSEMBLY_COMMAND CommandCompleted;
+
+    void* Context;
+
+    //
+    // Statistics
+    // 
+    unsigned long long Packets;
+
+    unsigned long long Fragments;
+
+    unsigned long long ConnectionRequests;
+
+    unsigned long long Patched;
+
+    unsigned long long Unpatchable;
+
+    unsigned long long Discarded;
+
+} ACL_REASSEMBLY, *PACL_REASSEMBLY;
+
+void
+AclReassembly_Init(
+    PACL_REASSEMBLY Reassembly,
+    PFN_ACL_REASSEMBLY_PATCH_PSM PatchPsm,
+    PFN_ACL_REASSEMBLY_COMMAND CommandCompleted,
+    void* Context
+);
+
+void
+AclReassembly_Reset(
+    PACL_REASSEMBLY Reassembly
+);
+
+PACL_REASSEMBLY_CHANNEL
+AclReassembly_GetChannel(
+    PACL_REASSEMBLY Reassembly,
+    unsigned short ConnectionHandle,
+    int Allocate
+);
+
+void
+AclReassembly_CompleteCommand(
+    PACL_REASSEMBLY Reassembly,
+    PACL_REASSEMBLY_CHANNEL Channel
+);
+
+void
+AclReassembly_ConsumeSignalling(
+    PACL_REASSEMBLY Reassembly,
+    PACL_REASSEMBLY_CHANNEL Channel,
+    unsigned char* Byte
+);
+
+size_t
+AclReassembly_ConsumePdu(
+    PACL_REASSEMBLY Reassembly,
+    PACL_REASSEMBLY_CHANNEL Channel,
+    unsigned char* Buffer,
+    size_t Length
+);
+
+void
+AclReassembly_Process(
+    PACL_REASSEMBLY Reassembly,
+    unsigned char* Buffer,
+    size_t Length
+);
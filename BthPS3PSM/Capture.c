@@ -0,0 +1,376 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3PSM - Windows kernel-mode BTHUSB lower filter driver                     *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#include "Driver.h"
+#include "Capture.tmh"
+
+
+#define PCAP_MAGIC                      0xA1B2C3D4
+#define PCAP_VERSION_MAJOR              2
+#define PCAP_VERSION_MINOR              4
+#define PCAP_SNAPLEN                    0xFFFF
+#define PCAP_LINKTYPE_BLUETOOTH_HCI_H4  187
+
+#define HCI_H4_ACL_DATA                 0x02
+#define HCI_ACL_PB_FIRST_FLUSHABLE      0x2000
+#define L2CAP_SIGNALLING_CID            0x0001
+
+//
+// 100ns intervals between 1601-01-01 and 1970-01-01
+// 
+#define SYSTEM_TIME_UNIX_EPOCH          116444736000000000LL
+
+#include <pshpack1.h>
+
+typedef struct _PCAP_FILE_HEADER
+{
+    ULONG Magic;
+    USHORT VersionMajor;
+    USHORT VersionMinor;
+    LONG ThisZone;
+    ULONG SigFigs;
+    ULONG SnapLen;
+    ULONG LinkType;
+
+} PCAP_FILE_HEADER, *PPCAP_FILE_HEADER;
+
+typedef struct _PCAP_RECORD_HEADER
+{
+    ULONG Seconds;
+    ULONG Microseconds;
+    ULONG CapturedLength;
+    ULONG OriginalLength;
+
+} PCAP_RECORD_HEADER, *PPCAP_RECORD_HEADER;
+
+//
+// Synthesized H4 ACL packet carrying a single signalling command
+// 
+typedef struct _PCAP_SIGNALLING_PACKET
+{
+    UCHAR PacketType;
+    USHORT HandleAndFlags;
+    USHORT AclLength;
+    USHORT L2capLength;
+    USHORT L2capCid;
+    UCHAR Code;
+    UCHAR Identifier;
+    USHORT CommandLength;
+    UCHAR Data[BTHPS3PSM_CAPTURE_MAX_DATA];
+
+} PCAP_SIGNALLING_PACKET, *PPCAP_SIGNALLING_PACKET;
+
+#include <poppack.h>
+
+#define PCAP_PACKET_HEADER_LENGTH       FIELD_OFFSET(PCAP_SIGNALLING_PACKET, Data)
+
+
+//
+// Starts out empty
+// 
+_Use_decl_annotations_
+VOID
+BthPS3PSM_CaptureInit(
+    PBTHPS3PSM_CAPTURE Capture
+)
+{
+    RtlZeroMemory(Capture, sizeof(BTHPS3PSM_CAPTURE));
+}
+
+//
+// Reads a little endian USHORT from command data, 0 if not captured
+// 
+static USHORT
+BthPS3PSM_CaptureDataUShort(
+    _In_ const ACL_REASSEMBLY_COMMAND* Command,
+    _In_ ULONG Offset
+)
+{
+    if (Command->DataLength < Offset + sizeof(USHORT))
+    {
+        return 0;
+    }
+
+    return (USHORT)(Command->Data[Offset] | (Command->Data[Offset + 1] << 8));
+}
+
+//
+// Records a signalling command, caller serializes writers (AclReassemblyLock)
+// 
+_Use_decl_annotations_
+VOID
+BthPS3PSM_CaptureAdd(
+    PBTHPS3PSM_CAPTURE Capture,
+    const ACL_REASSEMBLY_COMMAND* Command
+)
+{
+    const LONG64 sequence = Capture->Head;
+    const PBTHPS3PSM_CAPTURE_SLOT pSlot = &Capture->Slots[sequence % BTHPS3PSM_CAPTURE_RING_SIZE];
+    const PBTHPS3PSM_SIGNALLING_CAPTURE_ENTRY pEntry = &pSlot->Entry;
+
+    InterlockedIncrement(&pSlot->SeqLock);
+
+    pEntry->Sequence = (ULONG64)sequence;
+    KeQuerySystemTimePrecise(&pEntry->Timestamp);
+    pEntry->ConnectionHandle = Command->ConnectionHandle;
+    pEntry->Code = Command->Code;
+    pEntry->Identifier = Command->Identifier;
+    pEntry->Length = Command->Length;
+    pEntry->Psm = 0;
+    pEntry->PatchedPsm = Command->PatchedPsm;
+    pEntry->DestinationCid = 0;
+    pEntry->SourceCid = 0;
+    pEntry->IsPatched = (UCHAR)(Command->IsPatched != 0);
+    pEntry->DataLength = (UCHAR)Command->DataLength;
+    RtlCopyMemory(pEntry->Data, Command->Data, Command->DataLength);
+
+    switch (Command->Code)
+    {
+    case L2CAP_Connection_Request:
+        pEntry->Psm = BthPS3PSM_CaptureDataUShort(Command, 0);
+        pEntry->SourceCid = BthPS3PSM_CaptureDataUShort(Command, 2);
+        break;
+    case L2CAP_Connection_Response:
+    case L2CAP_Disconnection_Request:
+    case L2CAP_Disconnection_Response:
+        pEntry->DestinationCid = BthPS3PSM_CaptureDataUShort(Command, 0);
+        pEntry->SourceCid = BthPS3PSM_CaptureDataUShort(Command, 2);
+        break;
+    case L2CAP_Configuration_Request:
+        pEntry->DestinationCid = BthPS3PSM_CaptureDataUShort(Command, 0);
+        break;
+    case L2CAP_Configuration_Response:
+        pEntry->SourceCid = BthPS3PSM_CaptureDataUShort(Command, 0);
+        break;
+    default:
+        break;
+    }
+
+    InterlockedIncrement(&pSlot->SeqLock);
+
+    InterlockedExchange64(&Capture->Head, sequence + 1);
+}
+
+//
+// Takes a consistent copy of a slot, FALSE if it no longer holds Sequence
+// 
+static BOOLEAN
+BthPS3PSM_CaptureRead(
+    _In_ const BTHPS3PSM_CAPTURE* Capture,
+    _In_ ULONG64 Sequence,
+    _Out_ PBTHPS3PSM_SIGNALLING_CAPTURE_ENTRY Entry
+)
+{
+    const BTHPS3PSM_CAPTURE_SLOT* pSlot = &Capture->Slots[Sequence % BTHPS3PSM_CAPTURE_RING_SIZE];
+    LONG seqLock;
+
+    do
+    {
+        while ((seqLock = ReadAcquire(&pSlot->SeqLock)) & 1)
+        {
+            YieldProcessor();
+        }
+
+        RtlCopyMemory(Entry, (const void*)&pSlot->Entry, sizeof(BTHPS3PSM_SIGNALLING_CAPTURE_ENTRY));
+
+        KeMemoryBarrier();
+
+    } while (ReadAcquire(&pSlot->SeqLock) != seqLock);
+
+    return (Entry->Sequence == Sequence);
+}
+
+//
+// Writes an entry as pcap record, returns bytes written or 0 if it doesn't fit
+// 
+static ULONG
+BthPS3PSM_CaptureWritePcapRecord(
+    _In_ const BTHPS3PSM_SIGNALLING_CAPTURE_ENTRY* Entry,
+    _Out_writes_bytes_(BufferLength) PUCHAR Buffer,
+    _In_ ULONG BufferLength
+)
+{
+    PCAP_RECORD_HEADER record;
+    PCAP_SIGNALLING_PACKET packet;
+    const ULONG capturedLength = PCAP_PACKET_HEADER_LENGTH + Entry->DataLength;
+    const LONG64 unixTime = Entry->Timestamp.QuadPart - SYSTEM_TIME_UNIX_EPOCH;
+
+    if (BufferLength < sizeof(PCAP_RECORD_HEADER) + capturedLength)
+    {
+        return 0;
+    }
+
+    record.Seconds = (ULONG)(unixTime / 10000000);
+    record.Microseconds = (ULONG)((unixTime % 10000000) / 10);
+    record.CapturedLength = capturedLength;
+    record.OriginalLength = PCAP_PACKET_HEADER_LENGTH + Entry->Length;
+
+    packet.PacketType = HCI_H4_ACL_DATA;
+    packet.HandleAndFlags = (USHORT)(Entry->ConnectionHandle | HCI_ACL_PB_FIRST_FLUSHABLE);
+    packet.AclLength = (USHORT)(PCAP_PACKET_HEADER_LENGTH - FIELD_OFFSET(PCAP_SIGNALLING_PACKET, L2capLength) + Entry->Length);
+    packet.L2capLength = (USHORT)(PCAP_PACKET_HEADER_LENGTH - FIELD_OFFSET(PCAP_SIGNALLING_PACKET, Code) + Entry->Length);
+    packet.L2capCid = L2CAP_SIGNALLING_CID;
+    packet.Code = Entry->Code;
+    packet.Identifier = Entry->Identifier;
+    packet.CommandLength = Entry->Length;
+    RtlCopyMemory(packet.Data, Entry->Data, Entry->DataLength);
+
+    //
+    // Show what BTHUSB got to see
+    // 
+    if (Entry->IsPatched && Entry->DataLength >= sizeof(USHORT))
+    {
+        packet.Data[0] = (UCHAR)(Entry->PatchedPsm & 0xFF);
+        packet.Data[1] = (UCHAR)(Entry->PatchedPsm >> 8);
+    }
+
+    RtlCopyMemory(Buffer, &record, sizeof(PCAP_RECORD_HEADER));
+    RtlCopyMemory(Buffer + sizeof(PCAP_RECORD_HEADER), &packet, capturedLength);
+
+    return sizeof(PCAP_RECORD_HEADER) + capturedLength;
+}
+
+//
+// Copies captured commands starting at StartSequence until Buffer is full
+// 
+_Use_decl_annotations_
+NTSTATUS
+BthPS3PSM_CaptureExport(
+    const BTHPS3PSM_CAPTURE* Capture,
+    BTHPS3PSM_CAPTURE_FORMAT Format,
+    ULONG64 StartSequence,
+    PUCHAR Buffer,
+    ULONG BufferLength,
+    PULONG Length,
+    PULONG64 NextSequence,
+    PULONG64 LostEntries
+)
+{
+    BTHPS3PSM_SIGNALLING_CAPTURE_ENTRY entry;
+    const ULONG64 head = (ULONG64)ReadAcquire64(&Capture->Head);
+    ULONG64 sequence = StartSequence;
+    ULONG written = 0;
+
+    *Length = 0;
+    *LostEntries = 0;
+
+    if (Format != BTHPS3PSM_CAPTURE_FORMAT_RAW && Format != BTHPS3PSM_CAPTURE_FORMAT_PCAP)
+    {
+        *NextSequence = StartSequence;
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (Format == BTHPS3PSM_CAPTURE_FORMAT_PCAP)
+    {
+        PCAP_FILE_HEADER header;
+
+        if (BufferLength < sizeof(PCAP_FILE_HEADER))
+        {
+            *NextSequence = StartSequence;
+            return STATUS_BUFFER_TOO_SMALL;
+        }
+
+        header.Magic = PCAP_MAGIC;
+        header.VersionMajor = PCAP_VERSION_MAJOR;
+        header.VersionMinor = PCAP_VERSION_MINOR;
+        header.ThisZone = 0;
+        header.SigFigs = 0;
+        header.SnapLen = PCAP_SNAPLEN;
+        header.LinkType = PCAP_LINKTYPE_BLUETOOTH_HCI_H4;
+
+        RtlCopyMemory(Buffer, &header, sizeof(PCAP_FILE_HEADER));
+        written = sizeof(PCAP_FILE_HEADER);
+    }
+
+    //
+    // Caller is behind (or ahead after a restart), resume at what's still there
+    // 
+    if (sequence > head)
+    {
+        sequence = head;
+    }
+
+    if (head - sequence > BTHPS3PSM_CAPTURE_RING_SIZE)
+    {
+        *LostEntries = head - sequence - BTHPS3PSM_CAPTURE_RING_SIZE;
+        sequence = head - BTHPS3PSM_CAPTURE_RING_SIZE;
+    }
+
+    for (; sequence < head; sequence++)
+    {
+        ULONG recordLength;
+
+        //
+        // Overwritten while we were busy copying
+        // 
+        if (!BthPS3PSM_CaptureRead(Capture, sequence, &entry))
+        {
+            (*LostEntries)++;
+            continue;
+        }
+
+        if (Format == BTHPS3PSM_CAPTURE_FORMAT_PCAP)
+        {
+            recordLength = BthPS3PSM_CaptureWritePcapRecord(
+                &entry,
+                Buffer + written,
+                BufferLength - written
+            );
+        }
+        else if (BufferLength - written >= sizeof(BTHPS3PSM_SIGNALLING_CAPTURE_ENTRY))
+        {
+            RtlCopyMemory(Buffer + written, &entry, sizeof(BTHPS3PSM_SIGNALLING_CAPTURE_ENTRY));
+            recordLength = sizeof(BTHPS3PSM_SIGNALLING_CAPTURE_ENTRY);
+        }
+        else
+        {
+            recordLength = 0;
+        }
+
+        if (recordLength == 0)
+        {
+            break;
+        }
+
+        written += recordLength;
+    }
+
+    *Length = written;
+    *NextSequence = sequence;
+
+    return STATUS_SUCCESS;
+}
@@ -1,6 +1,6 @@
 /**********************************************************************************
  *                                                                                *
- * BthPS3 - Windows kernel-mode Bluetooth profile and bus driver                  *
+ * BthPS3PSM - Windows kernel-mode BTHUSB lower filter driver                     *
  *                                                                                *
  * BSD 3-Clause License                                                           *
  *                                                                                *
@@ -35,71 +35,60 @@
  **********************************************************************************/
 
 
-#include "Driver.h"
-#include <ntstrsafe.h>
-#include "util.tmh"
+#pragma once
+
+#define BTHPS3PSM_CAPTURE_RING_SIZE             256
 
 //
-// Compares a remote name (UTF8 char*) to a WDFSTRING
+// Capture ring slot
 // 
-BOOLEAN
-StringUtil_BthNameIsEqual(
-    PCHAR Lhs,
-    WDFSTRING Rhs
-)
+typedef struct _BTHPS3PSM_CAPTURE_SLOT
 {
-    NTSTATUS status;
-    UNICODE_STRING usRhs;
-    DECLARE_UNICODE_STRING_SIZE(usLhs, BTH_MAX_NAME_SIZE);
-
-    //
-    // WDFSTRING to UNICODE_STRING
-    // 
-    WdfStringGetUnicodeString(
-        Rhs,
-        &usRhs
-    );
-
     //
-    // CHAR to UNICODE_STRING
+    // Odd while the slot is being written, bumped twice per write
     // 
-    if (!NT_SUCCESS(status = RtlUnicodeStringPrintf(&usLhs, L"%hs", Lhs))) 
-    {
-        TraceError(
-            TRACE_UTIL,
-            "RtlUnicodeStringPrintf failed with status %!STATUS!",
-            status
-        );
-    }
+    volatile LONG SeqLock;
 
-    TraceVerbose(
-        TRACE_UTIL,
-        "LHS: \"%wZ\" RHS: \"%wZ\"",
-        &usLhs, &usRhs
-    );
+    BTHPS3PSM_SIGNALLING_CAPTURE_ENTRY Entry;
 
-    //
-    // Compare case-insensitive
-    // 
-    return RtlEqualUnicodeString(&usLhs, &usRhs, TRUE);
-}
+} BTHPS3PSM_CAPTURE_SLOT, *PBTHPS3PSM_CAPTURE_SLOT;
 
 //
-// Checks if a remote name (UTF8 char*) is within a WDFCOLLECTION
+// Most recent L2CAP signalling commands of a radio, single writer, lock-free readers
 // 
-BOOLEAN
-StringUtil_BthNameIsInCollection(
-    PCHAR Entry,
-    WDFCOLLECTION Array
-)
+typedef struct _BTHPS3PSM_CAPTURE
 {
-    ULONG i;
+    //
+    // Sequence of the next command to capture
+    // 
+    volatile LONG64 Head;
+
+    BTHPS3PSM_CAPTURE_SLOT Slots[BTHPS3PSM_CAPTURE_RING_SIZE];
+
+} BTHPS3PSM_CAPTURE, *PBTHPS3PSM_CAPTURE;
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3PSM_CaptureInit(
+    _Out_ PBTHPS3PSM_CAPTURE Capture
+);
 
-    for (i = 0; i < WdfCollectionGetCount(Array); i++)
-    {
-        if (StringUtil_BthNameIsEqual(Entry, WdfCollectionGetItem(Array, i)))
-            return TRUE;
-    }
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3PSM_CaptureAdd(
+    _Inout_ PBTHPS3PSM_CAPTURE Capture,
+    _In_ const ACL_REASSEMBLY_COMMAND* Command
+);
 
-    return FALSE;
-}
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+BthPS3PSM_CaptureExport(
+    _In_ const BTHPS3PSM_CAPTURE* Capture,
+    _In_ BTHPS3PSM_CAPTURE_FORMAT Format,
+    _In_ ULONG64 StartSequence,
+    _Out_writes_bytes_to_(BufferLength, *Length) PUCHAR Buffer,
+    _In_ ULONG BufferLength,
+    _Out_ PULONG Length,
+    _Out_ PULONG64 NextSequence,
+    _Out_ PULONG64 LostEntries
+);
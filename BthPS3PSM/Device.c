@@ -68,11 +68,18 @@ BthPS3PSM_CreateDevice(
     WDFDEVICE device;
     NTSTATUS status;
     WDF_OBJECT_ATTRIBUTES stringAttributes;
+    WDF_OBJECT_ATTRIBUTES lockAttributes;
     BOOLEAN isUsb = FALSE;
     BOOLEAN ret = FALSE;
     WDFMEMORY instanceId = NULL;
+    ULONG isPsmPatchingEnabled = 0;
 
     DECLARE_CONST_UNICODE_STRING(patchPSMRegValue, G_PatchPSMRegValue);
+    DECLARE_CONST_UNICODE_STRING(interceptArmedOnlyRegValue, G_InterceptArmedOnlyRegValue);
+#ifdef BTHPS3PSM_WITH_WDM_FAST_PATH
+    DECLARE_CONST_UNICODE_STRING(wdmFastPathRegValue, G_WdmFastPathRegValue);
+    UCHAR removeDeviceMinorFunction = IRP_MN_REMOVE_DEVICE;
+#endif
     DECLARE_CONST_UNICODE_STRING(linkNameRegValue, G_SymbolicLinkName);
 
 
@@ -123,6 +130,50 @@ BthPS3PSM_CreateDevice(
 
         WdfFdoInitSetFilter(DeviceInit);
 
+#ifdef BTHPS3PSM_WITH_WDM_FAST_PATH
+
+        //
+        // Gets first pick at internal IOCTLs, see BthPS3PSM_EvtWdmIrpPreprocessInternalDeviceControl
+        // 
+        if (!NT_SUCCESS(status = WdfDeviceInitAssignWdmIrpPreprocessCallback(
+            DeviceInit,
+            BthPS3PSM_EvtWdmIrpPreprocessInternalDeviceControl,
+            IRP_MJ_INTERNAL_DEVICE_CONTROL,
+            NULL,
+            0
+        )))
+        {
+            TraceError(
+                TRACE_DEVICE,
+                "WdfDeviceInitAssignWdmIrpPreprocessCallback failed with status %!STATUS!",
+                status
+            );
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfDeviceInitAssignWdmIrpPreprocessCallback", status);
+            break;
+        }
+
+        //
+        // Keeps the device from being removed while a fast path IRP is in flight
+        // 
+        if (!NT_SUCCESS(status = WdfDeviceInitAssignWdmIrpPreprocessCallback(
+            DeviceInit,
+            BthPS3PSM_EvtWdmIrpPreprocessRemoveDevice,
+            IRP_MJ_PNP,
+            &removeDeviceMinorFunction,
+            1
+        )))
+        {
+            TraceError(
+                TRACE_DEVICE,
+                "WdfDeviceInitAssignWdmIrpPreprocessCallback failed with status %!STATUS!",
+                status
+            );
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfDeviceInitAssignWdmIrpPreprocessCallback", status);
+            break;
+        }
+
+#endif
+
         //
         // Device object attributes
         // 
@@ -148,6 +199,38 @@ BthPS3PSM_CreateDevice(
 
         deviceContext->InstanceId = instanceId;
 
+#ifdef BTHPS3PSM_WITH_WDM_FAST_PATH
+        IoInitializeRemoveLock(&deviceContext->FastPathRemoveLock, BTHPS3PSM_REMOVE_LOCK_TAG, 0, 0);
+#endif
+
+        AclReassembly_Init(
+            &deviceContext->AclReassembly,
+            BthPS3PSM_PatchPsm,
+            BthPS3PSM_CommandCompleted,
+            deviceContext
+        );
+
+        HciEvents_Init(&deviceContext->HciEvents);
+
+        BthPS3PSM_CaptureInit(&deviceContext->Capture);
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&lockAttributes);
+        lockAttributes.ParentObject = device;
+
+        if (!NT_SUCCESS(status = WdfSpinLockCreate(
+            &lockAttributes,
+            &deviceContext->AclReassemblyLock
+        )))
+        {
+            TraceError(
+                TRACE_DEVICE,
+                "WdfSpinLockCreate failed with status %!STATUS!",
+                status
+            );
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfSpinLockCreate", status);
+            break;
+        }
+
 #pragma region Add this device to global collection
 
 #ifdef BTHPS3PSM_WITH_CONTROL_DEVICE
@@ -224,7 +307,7 @@ BthPS3PSM_CreateDevice(
         if (!NT_SUCCESS(status = WdfRegistryQueryULong(
             deviceContext->RegKeyDeviceNode,
             &patchPSMRegValue,
-            &deviceContext->IsPsmPatchingEnabled
+            &isPsmPatchingEnabled
         )))
         {
             //
@@ -251,11 +334,31 @@ BthPS3PSM_CreateDevice(
 
             EventWriteGetPatchStatusForDeviceInstance(
                 NULL,
-                deviceContext->IsPsmPatchingEnabled,
+                isPsmPatchingEnabled,
                 instanceIdString
             );
         }
 
+        //
+        // Don't care, if it fails, keep default value
+        // 
+        (void)WdfRegistryQueryULong(
+            deviceContext->RegKeyDeviceNode,
+            &interceptArmedOnlyRegValue,
+            &deviceContext->IsInterceptArmedOnly
+        );
+
+#ifdef BTHPS3PSM_WITH_WDM_FAST_PATH
+        //
+        // Don't care, if it fails, keep default value
+        // 
+        (void)WdfRegistryQueryULong(
+            deviceContext->RegKeyDeviceNode,
+            &wdmFastPathRegValue,
+            &deviceContext->IsWdmFastPath
+        );
+#endif
+
         WDF_OBJECT_ATTRIBUTES_INIT(&stringAttributes);
         stringAttributes.ParentObject = device;
 
@@ -296,8 +399,33 @@ BthPS3PSM_CreateDevice(
         }
 
 #ifndef BTHPS3PSM_WITH_CONTROL_DEVICE
-        deviceContext->IsPsmPatchingEnabled = TRUE;
-#else
+        isPsmPatchingEnabled = TRUE;
+#endif
+
+        if (!NT_SUCCESS(status = BthPS3PSM_PolicyInit(
+            device,
+            isPsmPatchingEnabled
+        )))
+        {
+            TraceError(
+                TRACE_DEVICE,
+                "BthPS3PSM_PolicyInit failed with status %!STATUS!",
+                status
+            );
+            break;
+        }
+
+        if (!NT_SUCCESS(status = BthPS3PSM_StatsInit(device)))
+        {
+            TraceError(
+                TRACE_DEVICE,
+                "BthPS3PSM_StatsInit failed with status %!STATUS!",
+                status
+            );
+            break;
+        }
+
+#ifdef BTHPS3PSM_WITH_CONTROL_DEVICE
 
 #pragma region Create control device
 
@@ -429,6 +557,20 @@ BthPS3PSM_EvtDeviceContextCleanup(
 
     const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(Device);
 
+    //
+    // Don't lose a change still waiting to be persisted
+    //
+    if (pDevCtx->SaveConfigTimer != NULL
+        && WdfTimerStop(pDevCtx->SaveConfigTimer, TRUE))
+    {
+        BthPS3PSM_EvtSaveConfigTimer(pDevCtx->SaveConfigTimer);
+    }
+
+    if (pDevCtx->Stats.Timer != NULL)
+    {
+        WdfTimerStop(pDevCtx->Stats.Timer, TRUE);
+    }
+
 #ifdef BTHPS3PSM_WITH_CONTROL_DEVICE
 
     NTSTATUS status;
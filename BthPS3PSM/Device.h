@@ -39,9 +39,24 @@
 
 #include "BthPS3.h"
 #include <usb.h>
+#include "AclReassembly.h"
+#include "HciEvents.h"
+#include "Policy.h"
+#include "Capture.h"
+#include "Stats.h"
 
 EXTERN_C_START
 
+//
+// Bulk IN transfers tracked in submission order, any beyond are not parsed
+// 
+#define BTHPS3PSM_MAX_PENDING_BULK_IN   32
+
+//
+// Pool tag of FastPathRemoveLock
+// 
+#define BTHPS3PSM_REMOVE_LOCK_TAG       'LRSP'
+
 #pragma region Registry key/value names
 
 //
@@ -49,6 +64,16 @@ EXTERN_C_START
 // 
 #define G_PatchPSMRegValue  L"BthPS3PSMPatchEnabled"
 
+//
+// Bulk IN transfers are only intercepted while patching is enabled if value > 0
+// 
+#define G_InterceptArmedOnlyRegValue  L"BthPS3PSMInterceptArmedOnly"
+
+//
+// Bulk IN transfers are intercepted bypassing the framework if value > 0
+// 
+#define G_WdmFastPathRegValue  L"BthPS3PSMWdmFastPath"
+
 //
 // Symbolic link name of the radio the filter is currently loaded on
 // 
@@ -69,9 +94,38 @@ typedef struct _DEVICE_CONTEXT
 	USBD_PIPE_HANDLE BulkReadPipe;
 
 	//
-	// Patches PSM values if TRUE
+	// USB Interrupt Read (in) handle, carries HCI events
+	// 
+	USBD_PIPE_HANDLE InterruptReadPipe;
+
+	//
+	// Endpoint addresses of the pipes above, preferred when pipes get re-resolved
+	// 
+	UCHAR BulkInEndpointAddress;
+
+	UCHAR InterruptInEndpointAddress;
+
+	//
+	// Patch state and PSM remap table, read lock-free on the hot path
+	// 
+	BTHPS3PSM_POLICY Policy;
+
+	//
+	// Forward bulk IN transfers untouched while patching is disabled if TRUE
+	// 
+	ULONG IsInterceptArmedOnly;
+
+	//
+	// Intercept bulk IN transfers in the WDM preprocess callback if TRUE
+	// 
+	ULONG IsWdmFastPath;
+
+#ifdef BTHPS3PSM_WITH_WDM_FAST_PATH
+	//
+	// Held by every fast path IRP in flight, the framework doesn't know about them
 	// 
-	ULONG IsPsmPatchingEnabled;
+	IO_REMOVE_LOCK FastPathRemoveLock;
+#endif
 
 	//
 	// Symbolic link name of host radio we're loaded onto
@@ -88,6 +142,67 @@ typedef struct _DEVICE_CONTEXT
     // 
     WDFKEY RegKeyDeviceNode;
 
+    //
+    // L2CAP reassembly state of the bulk IN pipe
+    // 
+    ACL_REASSEMBLY AclReassembly;
+
+    //
+    // Connection handles and remote addresses seen on the interrupt IN pipe
+    // 
+    HCI_EVENTS HciEvents;
+
+    //
+    // Recent signalling commands, written with AclReassemblyLock held
+    // 
+    BTHPS3PSM_CAPTURE Capture;
+
+    //
+    // Lock protecting AclReassembly and HciEvents
+    // 
+    WDFSPINLOCK AclReassemblyLock;
+
+    //
+    // Set if bulk IN transfers bypassed the filter and reassembly lost track
+    // 
+    volatile LONG IsAclReassemblyStale;
+
+    //
+    // Bulk IN URBs in the order they were sent down, protected by AclReassemblyLock. 
+    // The controller fills them in this order but completion routines may run 
+    // concurrently, so a transfer is only parsed once all preceding ones were.
+    // 
+    PURB PendingBulkIn[BTHPS3PSM_MAX_PENDING_BULK_IN];
+
+    ULONG PendingBulkInHead;
+
+    ULONG PendingBulkInCount;
+
+    //
+    // Policy copy used by the current completion, protected by AclReassemblyLock
+    // 
+    BTHPS3PSM_POLICY ActivePolicy;
+
+    //
+    // Serializes Policy writers
+    // 
+    WDFSPINLOCK PolicyLock;
+
+    //
+    // Debounces persisting Policy changes to the registry
+    // 
+    WDFTIMER SaveConfigTimer;
+
+    //
+    // Patch state last written to or read from the registry
+    // 
+    ULONG PersistedPsmPatchingEnabled;
+
+    //
+    // Hot path counters
+    // 
+    BTHPS3PSM_STATS Stats;
+
 } DEVICE_CONTEXT, * PDEVICE_CONTEXT;
 
 //
@@ -45,6 +45,12 @@
 // 
 #define BTHPS3PSM_WITH_CONTROL_DEVICE
 
+//
+// Comment out to build without the WDM bulk IN interception path
+// > If enabled, still needs to be opted into per radio via registry
+// 
+#define BTHPS3PSM_WITH_WDM_FAST_PATH
+
 #include "device.h"
 #include "queue.h"
 #include "trace.h"
@@ -42,6 +42,108 @@
 #include <BthPS3PSMETW.h>
 
 
+//
+// Looks for the bulk IN and interrupt IN pipes of an interface
+// 
+// Pipes matching the endpoint addresses remembered from a previous start win
+// over the first pipe of the right type and direction, so the same endpoint
+// gets hooked on every start, even on radios exposing more than one.
+// 
+static VOID
+BthPS3PSM_FindPipes(
+    _In_ PDEVICE_CONTEXT DeviceContext,
+    _In_ const USBD_INTERFACE_INFORMATION* Interface,
+    _Inout_ USBD_PIPE_HANDLE* BulkReadPipe,
+    _Inout_ PUCHAR BulkInEndpointAddress,
+    _Inout_ USBD_PIPE_HANDLE* InterruptReadPipe,
+    _Inout_ PUCHAR InterruptInEndpointAddress
+)
+{
+    TraceVerbose(
+        TRACE_FILTER,
+        "Enumerating %d pipes of interface %d",
+        Interface->NumberOfPipes,
+        Interface->InterfaceNumber
+    );
+
+    for (ULONG i = 0; i < Interface->NumberOfPipes; i++)
+    {
+        const USBD_PIPE_INFORMATION* pipeInfo = &Interface->Pipes[i];
+
+        TraceVerbose(
+            TRACE_FILTER,
+            "Enumerating pipe %d with type 0x%X and address 0x%02X (handle 0x%p)",
+            i, pipeInfo->PipeType, pipeInfo->EndpointAddress, pipeInfo->PipeHandle
+        );
+
+        if (!USB_ENDPOINT_DIRECTION_IN(pipeInfo->EndpointAddress))
+        {
+            continue;
+        }
+
+        if (pipeInfo->PipeType == UsbdPipeTypeBulk)
+        {
+            if (*BulkReadPipe == NULL
+                || pipeInfo->EndpointAddress == DeviceContext->BulkInEndpointAddress)
+            {
+                TraceInformation(
+                    TRACE_FILTER,
+                    "Found Bulk IN pipe handle 0x%p for endpoint 0x%02X",
+                    pipeInfo->PipeHandle, pipeInfo->EndpointAddress
+                );
+                // store handle so we later only hook the relevant transfer
+                *BulkReadPipe = pipeInfo->PipeHandle;
+                *BulkInEndpointAddress = pipeInfo->EndpointAddress;
+            }
+        }
+        else if (pipeInfo->PipeType == UsbdPipeTypeInterrupt)
+        {
+            if (*InterruptReadPipe == NULL
+                || pipeInfo->EndpointAddress == DeviceContext->InterruptInEndpointAddress)
+            {
+                TraceInformation(
+                    TRACE_FILTER,
+                    "Found Interrupt IN pipe handle 0x%p for endpoint 0x%02X",
+                    pipeInfo->PipeHandle, pipeInfo->EndpointAddress
+                );
+                // HCI events tell which remote device a connection handle belongs to
+                *InterruptReadPipe = pipeInfo->PipeHandle;
+                *InterruptInEndpointAddress = pipeInfo->EndpointAddress;
+            }
+        }
+    }
+}
+
+//
+// Adopts newly found pipes
+// 
+static VOID
+BthPS3PSM_SetPipes(
+    _In_ PDEVICE_CONTEXT DeviceContext,
+    _In_ USBD_PIPE_HANDLE BulkReadPipe,
+    _In_ UCHAR BulkInEndpointAddress,
+    _In_ USBD_PIPE_HANDLE InterruptReadPipe,
+    _In_ UCHAR InterruptInEndpointAddress
+)
+{
+    if (BulkReadPipe != NULL && BulkReadPipe != DeviceContext->BulkReadPipe)
+    {
+        DeviceContext->BulkReadPipe = BulkReadPipe;
+        DeviceContext->BulkInEndpointAddress = BulkInEndpointAddress;
+
+        //
+        // Whatever arrived on the old pipe is unrelated to the new one
+        // 
+        InterlockedExchange(&DeviceContext->IsAclReassemblyStale, TRUE);
+    }
+
+    if (InterruptReadPipe != NULL)
+    {
+        DeviceContext->InterruptReadPipe = InterruptReadPipe;
+        DeviceContext->InterruptInEndpointAddress = InterruptInEndpointAddress;
+    }
+}
+
 //
 // Gets called when URB_FUNCTION_SELECT_CONFIGURATION got completed
 // 
@@ -54,6 +156,11 @@ UrbSelectConfigurationCompleted(
     IN WDFCONTEXT Context
 )
 {
+    USBD_PIPE_HANDLE bulkReadPipe = NULL;
+    USBD_PIPE_HANDLE interruptReadPipe = NULL;
+    UCHAR bulkInEndpointAddress = 0;
+    UCHAR interruptInEndpointAddress = 0;
+
     UNREFERENCED_PARAMETER(Target);
 
     FuncEntry(TRACE_FILTER);
@@ -63,41 +170,60 @@ UrbSelectConfigurationCompleted(
     const PIRP pIrp = WdfRequestWdmGetIrp(Request);
     const PURB pUrb = (PURB)URB_FROM_IRP(pIrp);
 
-    const PUSBD_INTERFACE_INFORMATION interfaceInfo = &pUrb->UrbSelectConfiguration.Interface;
-
-    TraceVerbose(
-        TRACE_FILTER,
-        "Enumerating %d pipes",
-        interfaceInfo->NumberOfPipes
-    );
-
-    for (ULONG i = 0; i < interfaceInfo->NumberOfPipes; i++)
+    //
+    // Failed or un-configured (NULL descriptor), the interface list is not valid
+    // 
+    if (!NT_SUCCESS(Params->IoStatus.Status)
+        || pUrb->UrbSelectConfiguration.ConfigurationDescriptor == NULL)
     {
-        const PUSBD_PIPE_INFORMATION pipeInfo = &interfaceInfo->Pipes[i];
-
         TraceVerbose(
             TRACE_FILTER,
-            "Enumerating pipe %d with type 0x%X and address 0x%02X (handle 0x%p)",
-            i, pipeInfo->PipeType, pipeInfo->EndpointAddress, pipeInfo->PipeHandle
+            "No configuration selected (status: %!STATUS!)",
+            Params->IoStatus.Status
         );
 
-        if (pipeInfo->PipeType == UsbdPipeTypeBulk)
+        WdfRequestComplete(Request, Params->IoStatus.Status);
+
+        FuncExitNoReturn(TRACE_FILTER);
+        return;
+    }
+
+    //
+    // One variable length entry per interface follows the URB header
+    // 
+    const PUCHAR urbEnd = (PUCHAR)pUrb + pUrb->UrbHeader.Length;
+    PUSBD_INTERFACE_INFORMATION interfaceInfo = &pUrb->UrbSelectConfiguration.Interface;
+
+    for (ULONG i = 0; i < pUrb->UrbSelectConfiguration.ConfigurationDescriptor->bNumInterfaces; i++)
+    {
+        if ((PUCHAR)interfaceInfo + FIELD_OFFSET(USBD_INTERFACE_INFORMATION, Pipes) > urbEnd
+            || interfaceInfo->Length == 0
+            || (PUCHAR)interfaceInfo + interfaceInfo->Length > urbEnd)
         {
-            if (USB_ENDPOINT_DIRECTION_IN(pipeInfo->EndpointAddress))
-            {
-                TraceInformation(
-                    TRACE_FILTER,
-                    "Found Bulk IN pipe handle 0x%p for endpoint 0x%02X",
-                    pipeInfo->PipeHandle, pipeInfo->EndpointAddress
-                );
-                // store handle so we later only hook the relevant transfer
-                pDevCtx->BulkReadPipe = pipeInfo->PipeHandle;
-                break;
-            }
+            break;
         }
+
+        BthPS3PSM_FindPipes(
+            pDevCtx,
+            interfaceInfo,
+            &bulkReadPipe,
+            &bulkInEndpointAddress,
+            &interruptReadPipe,
+            &interruptInEndpointAddress
+        );
+
+        interfaceInfo = (PUSBD_INTERFACE_INFORMATION)((PUCHAR)interfaceInfo + interfaceInfo->Length);
     }
 
-    if (pDevCtx->BulkReadPipe == NULL)
+    BthPS3PSM_SetPipes(
+        pDevCtx,
+        bulkReadPipe,
+        bulkInEndpointAddress,
+        interruptReadPipe,
+        interruptInEndpointAddress
+    );
+
+    if (bulkReadPipe == NULL)
     {
         TraceError(
             TRACE_QUEUE,
@@ -111,6 +237,258 @@ UrbSelectConfigurationCompleted(
     FuncExitNoReturn(TRACE_FILTER);
 }
 
+//
+// Gets called when URB_FUNCTION_SELECT_INTERFACE got completed
+// 
+// Selecting an alternate setting hands out new pipe handles for that
+// interface; without picking them up the filter would silently go blind.
+// 
+_Use_decl_annotations_
+VOID
+UrbSelectInterfaceCompleted(
+    IN WDFREQUEST Request,
+    IN WDFIOTARGET Target,
+    IN PWDF_REQUEST_COMPLETION_PARAMS Params,
+    IN WDFCONTEXT Context
+)
+{
+    USBD_PIPE_HANDLE bulkReadPipe = NULL;
+    USBD_PIPE_HANDLE interruptReadPipe = NULL;
+    UCHAR bulkInEndpointAddress = 0;
+    UCHAR interruptInEndpointAddress = 0;
+
+    UNREFERENCED_PARAMETER(Target);
+
+    FuncEntry(TRACE_FILTER);
+
+    const WDFDEVICE device = (WDFDEVICE)Context;
+    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(device);
+    const PIRP pIrp = WdfRequestWdmGetIrp(Request);
+    const PURB pUrb = (PURB)URB_FROM_IRP(pIrp);
+
+    if (NT_SUCCESS(Params->IoStatus.Status))
+    {
+        //
+        // Typically the SCO interface, which has neither pipe and changes nothing
+        // 
+        BthPS3PSM_FindPipes(
+            pDevCtx,
+            &pUrb->UrbSelectInterface.Interface,
+            &bulkReadPipe,
+            &bulkInEndpointAddress,
+            &interruptReadPipe,
+            &interruptInEndpointAddress
+        );
+
+        BthPS3PSM_SetPipes(
+            pDevCtx,
+            bulkReadPipe,
+            bulkInEndpointAddress,
+            interruptReadPipe,
+            interruptInEndpointAddress
+        );
+    }
+
+    WdfRequestComplete(Request, Params->IoStatus.Status);
+
+    FuncExitNoReturn(TRACE_FILTER);
+}
+
+//
+// Remembers the submission order of an intercepted bulk IN transfer
+// 
+_Use_decl_annotations_
+VOID
+BthPS3PSM_BulkInSent(
+    PDEVICE_CONTEXT DeviceContext,
+    PURB Urb
+)
+{
+    WdfSpinLockAcquire(DeviceContext->AclReassemblyLock);
+
+    if (DeviceContext->PendingBulkInCount < BTHPS3PSM_MAX_PENDING_BULK_IN)
+    {
+        DeviceContext->PendingBulkIn[
+            (DeviceContext->PendingBulkInHead + DeviceContext->PendingBulkInCount) % BTHPS3PSM_MAX_PENDING_BULK_IN
+        ] = Urb;
+        DeviceContext->PendingBulkInCount++;
+    }
+    else
+    {
+        //
+        // Untracked, it will be parsed on its own once it completes
+        // 
+        InterlockedExchange(&DeviceContext->IsAclReassemblyStale, TRUE);
+    }
+
+    WdfSpinLockRelease(DeviceContext->AclReassemblyLock);
+}
+
+//
+// Locates a tracked bulk IN transfer, returns its distance from the oldest
+// pending one or MAXULONG if it isn't tracked
+// 
+static ULONG
+BthPS3PSM_BulkInFind(
+    _In_ PDEVICE_CONTEXT DeviceContext,
+    _In_ PURB Urb
+)
+{
+    for (ULONG offset = 0; offset < DeviceContext->PendingBulkInCount; offset++)
+    {
+        if (DeviceContext->PendingBulkIn[
+            (DeviceContext->PendingBulkInHead + offset) % BTHPS3PSM_MAX_PENDING_BULK_IN
+        ] == Urb)
+        {
+            return offset;
+        }
+    }
+
+    return MAXULONG;
+}
+
+//
+// Drops gap markers of transfers parsed out of order at the front, the next 
+// transfer then has to resume after the gap
+// 
+static VOID
+BthPS3PSM_BulkInSkipGaps(
+    _In_ PDEVICE_CONTEXT DeviceContext
+)
+{
+    while (DeviceContext->PendingBulkInCount > 0
+        && DeviceContext->PendingBulkIn[DeviceContext->PendingBulkInHead] == NULL)
+    {
+        DeviceContext->PendingBulkInHead = (DeviceContext->PendingBulkInHead + 1) % BTHPS3PSM_MAX_PENDING_BULK_IN;
+        DeviceContext->PendingBulkInCount--;
+
+        InterlockedExchange(&DeviceContext->IsAclReassemblyStale, TRUE);
+    }
+}
+
+//
+// Forgets a bulk IN transfer the lower driver never got, no completion will follow
+// 
+_Use_decl_annotations_
+VOID
+BthPS3PSM_BulkInSendFailed(
+    PDEVICE_CONTEXT DeviceContext,
+    PURB Urb
+)
+{
+    WdfSpinLockAcquire(DeviceContext->AclReassemblyLock);
+
+    const ULONG offset = BthPS3PSM_BulkInFind(DeviceContext, Urb);
+
+    if (offset != MAXULONG)
+    {
+        //
+        // No data went missing, close the gap so the order of the others is kept
+        // 
+        for (ULONG next = offset + 1; next < DeviceContext->PendingBulkInCount; next++)
+        {
+            DeviceContext->PendingBulkIn[(DeviceContext->PendingBulkInHead + next - 1) % BTHPS3PSM_MAX_PENDING_BULK_IN] =
+                DeviceContext->PendingBulkIn[(DeviceContext->PendingBulkInHead + next) % BTHPS3PSM_MAX_PENDING_BULK_IN];
+        }
+
+        DeviceContext->PendingBulkInCount--;
+
+        BthPS3PSM_BulkInSkipGaps(DeviceContext);
+    }
+
+    WdfSpinLockRelease(DeviceContext->AclReassemblyLock);
+}
+
+//
+// Runs the L2CAP parser over a completed bulk IN transfer
+// 
+static VOID
+BthPS3PSM_ProcessBulkIn(
+    _In_ PDEVICE_CONTEXT DeviceContext,
+    _In_ NTSTATUS Status,
+    _In_ PURB Urb
+)
+{
+    PUCHAR buffer;
+    ULONG preceding;
+    const struct _URB_BULK_OR_INTERRUPT_TRANSFER* pTransfer = &Urb->UrbBulkOrInterruptTransfer;
+
+    const ULONG bufferLength = pTransfer->TransferBufferLength;
+    buffer = (PUCHAR)USBPcapURBGetBufferPointer(
+        pTransfer->TransferBufferLength,
+        pTransfer->TransferBuffer,
+        pTransfer->TransferBufferMDL
+    );
+
+    WdfSpinLockAcquire(DeviceContext->AclReassemblyLock);
+
+    preceding = BthPS3PSM_BulkInFind(DeviceContext, Urb);
+
+    //
+    // Data of an earlier transfer is still on its way, feeding this one after 
+    // the current state would splice the stream wrongly; parse it on its own 
+    // from its first HCI packet boundary, as every transfer used to be, and 
+    // leave a gap marker so the transfers after it resume at a boundary too
+    // 
+    if (preceding != 0)
+    {
+        TraceEvents(TRACE_LEVEL_WARNING,
+            TRACE_FILTER,
+            "Bulk IN transfer 0x%p completed out of order (%d preceding pending)",
+            Urb,
+            (LONG)preceding
+        );
+
+        AclReassembly_Reset(&DeviceContext->AclReassembly);
+
+        if (NT_SUCCESS(Status) && buffer != NULL)
+        {
+            BthPS3PSM_PolicyRefresh(&DeviceContext->Policy, &DeviceContext->ActivePolicy);
+
+            AclReassembly_Process(&DeviceContext->AclReassembly, buffer, bufferLength);
+        }
+
+        InterlockedExchange(&DeviceContext->IsAclReassemblyStale, TRUE);
+
+        if (preceding != MAXULONG)
+        {
+            DeviceContext->PendingBulkIn[
+                (DeviceContext->PendingBulkInHead + preceding) % BTHPS3PSM_MAX_PENDING_BULK_IN
+            ] = NULL;
+        }
+
+        WdfSpinLockRelease(DeviceContext->AclReassemblyLock);
+        return;
+    }
+
+    //
+    // Transfers went by unseen or failed, resume at the next HCI packet boundary
+    // 
+    if (InterlockedExchange(&DeviceContext->IsAclReassemblyStale, FALSE)
+        || !NT_SUCCESS(Status)
+        || buffer == NULL)
+    {
+        AclReassembly_Reset(&DeviceContext->AclReassembly);
+    }
+
+    //
+    // Walks every ACL packet and signalling command, calls BthPS3PSM_PatchPsm
+    // 
+    if (NT_SUCCESS(Status) && buffer != NULL)
+    {
+        BthPS3PSM_PolicyRefresh(&DeviceContext->Policy, &DeviceContext->ActivePolicy);
+
+        AclReassembly_Process(&DeviceContext->AclReassembly, buffer, bufferLength);
+    }
+
+    DeviceContext->PendingBulkInHead = (DeviceContext->PendingBulkInHead + 1) % BTHPS3PSM_MAX_PENDING_BULK_IN;
+    DeviceContext->PendingBulkInCount--;
+
+    BthPS3PSM_BulkInSkipGaps(DeviceContext);
+
+    WdfSpinLockRelease(DeviceContext->AclReassemblyLock);
+}
+
 //
 // Gets called when Bulk IN (L2CAP) data is available
 // 
@@ -122,10 +500,81 @@ UrbFunctionBulkInTransferCompleted(
     IN PWDF_REQUEST_COMPLETION_PARAMS Params,
     IN WDFCONTEXT Context
 )
+{
+    UNREFERENCED_PARAMETER(Target);
+
+    BTHPS3PSM_STATS_COMPLETION_BEGIN();
+
+    FuncEntry(TRACE_FILTER);
+
+    const WDFDEVICE device = (WDFDEVICE)Context;
+    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(device);
+    const PIRP pIrp = WdfRequestWdmGetIrp(Request);
+
+    BthPS3PSM_ProcessBulkIn(pDevCtx, Params->IoStatus.Status, (PURB)URB_FROM_IRP(pIrp));
+
+    BTHPS3PSM_STATS_BULK_IN_COMPLETION_END(&pDevCtx->Stats);
+
+    WdfRequestComplete(Request, Params->IoStatus.Status);
+
+    FuncExitNoReturn(TRACE_FILTER);
+}
+
+#ifdef BTHPS3PSM_WITH_WDM_FAST_PATH
+
+//
+// Gets called when Bulk IN (L2CAP) data is available, WDM fast path flavour
+// 
+_Use_decl_annotations_
+NTSTATUS
+BthPS3PSM_WdmBulkInTransferCompleted(
+    PDEVICE_OBJECT DeviceObject,
+    PIRP Irp,
+    PVOID Context
+)
+{
+    UNREFERENCED_PARAMETER(DeviceObject);
+
+    BTHPS3PSM_STATS_COMPLETION_BEGIN();
+
+    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext((WDFDEVICE)Context);
+
+    //
+    // The URB pointer lives in our stack location, which is current again
+    // 
+    BthPS3PSM_ProcessBulkIn(pDevCtx, Irp->IoStatus.Status, (PURB)URB_FROM_IRP(Irp));
+
+    BTHPS3PSM_STATS_BULK_IN_COMPLETION_END(&pDevCtx->Stats);
+
+    if (Irp->PendingReturned)
+    {
+        IoMarkIrpPending(Irp);
+    }
+
+    IoReleaseRemoveLock(&pDevCtx->FastPathRemoveLock, Irp);
+
+    return STATUS_CONTINUE_COMPLETION;
+}
+
+#endif
+
+//
+// Gets called when HCI events are available
+// 
+_Use_decl_annotations_
+VOID
+UrbFunctionInterruptInTransferCompleted(
+    IN WDFREQUEST Request,
+    IN WDFIOTARGET Target,
+    IN PWDF_REQUEST_COMPLETION_PARAMS Params,
+    IN WDFCONTEXT Context
+)
 {
     PUCHAR buffer;
     UNREFERENCED_PARAMETER(Target);
 
+    BTHPS3PSM_STATS_COMPLETION_BEGIN();
+
     FuncEntry(TRACE_FILTER);
 
     const WDFDEVICE device = (WDFDEVICE)Context;
@@ -142,74 +591,107 @@ UrbFunctionBulkInTransferCompleted(
         pTransfer->TransferBufferMDL
     );
 
-    if (
-        bufferLength >= L2CAP_MIN_BUFFER_LEN
-        && L2CAP_IS_CONTROL_CHANNEL(buffer)
-        && L2CAP_IS_SIGNALLING_COMMAND_CODE(buffer)
-    )
+    WdfSpinLockAcquire(pDevCtx->AclReassemblyLock);
+
+    if (!NT_SUCCESS(Params->IoStatus.Status) || buffer == NULL)
+    {
+        HciEvents_Reset(&pDevCtx->HciEvents);
+    }
+    else
     {
-        const L2CAP_SIGNALLING_COMMAND_CODE code = L2CAP_GET_SIGNALLING_COMMAND_CODE(buffer);
+        HciEvents_Process(&pDevCtx->HciEvents, buffer, bufferLength);
+    }
 
-        if (code == L2CAP_Connection_Request)
-        {
-            const PL2CAP_SIGNALLING_CONNECTION_REQUEST pConReq = (PL2CAP_SIGNALLING_CONNECTION_REQUEST)&buffer[8];
+    WdfSpinLockRelease(pDevCtx->AclReassemblyLock);
 
-            if (pConReq->PSM == PSM_HID_CONTROL)
-            {
-                TraceVerbose(
-                    TRACE_FILTER,
-                    ">> Connection request for HID Control PSM 0x%04X arrived",
-                    pConReq->PSM
-                );
+    BTHPS3PSM_STATS_COMPLETION_END(&pDevCtx->Stats);
 
-                if (pDevCtx->IsPsmPatchingEnabled)
-                {
-                    pConReq->PSM = PSM_DS3_HID_CONTROL;
-
-                    TraceInformation(
-                        TRACE_FILTER,
-                        "++ Patching HID Control PSM to 0x%04X",
-                        pConReq->PSM);
-                }
-                else
-                {
-                    TraceVerbose(
-                        TRACE_FILTER,
-                        "-- NOT Patching HID Control PSM"
-                    );
-                }
-            }
+    WdfRequestComplete(Request, Params->IoStatus.Status);
 
-            if (pConReq->PSM == PSM_HID_INTERRUPT)
-            {
-                TraceVerbose(
-                    TRACE_FILTER,
-                    ">> Connection request for HID Interrupt PSM 0x%04X arrived",
-                    pConReq->PSM
-                );
+    FuncExitNoReturn(TRACE_FILTER);
+}
 
-                if (pDevCtx->IsPsmPatchingEnabled)
-                {
-                    pConReq->PSM = PSM_DS3_HID_INTERRUPT;
-
-                    TraceInformation(
-                        TRACE_FILTER,
-                        "++ Patching HID Interrupt PSM to 0x%04X",
-                        pConReq->PSM
-                    );
-                }
-                else
-                {
-                    TraceVerbose(
-                        TRACE_FILTER,
-                        "-- NOT Patching HID Interrupt PSM"
-                    );
-                }
-            }
-        }
+//
+// Gets called for every L2CAP Connection Request, returns the (patched) PSM
+// 
+unsigned short
+BthPS3PSM_PatchPsm(
+    void* Context,
+    unsigned short ConnectionHandle,
+    unsigned short Psm
+)
+{
+    const PDEVICE_CONTEXT pDevCtx = (PDEVICE_CONTEXT)Context;
+    const USHORT patchedPsm = BthPS3PSM_PolicyRemapPsm(&pDevCtx->ActivePolicy, Psm);
+    ULONG64 remoteAddress = 0;
+    BOOLEAN isAddressKnown;
+
+    if (patchedPsm == Psm)
+    {
+        return Psm;
     }
 
-    WdfRequestComplete(Request, Params->IoStatus.Status);
+    TraceVerbose(
+        TRACE_FILTER,
+        ">> Connection request for PSM 0x%04X arrived (handle: 0x%03X)",
+        Psm,
+        ConnectionHandle
+    );
 
-    FuncExitNoReturn(TRACE_FILTER);
+    if (!pDevCtx->ActivePolicy.IsPsmPatchingEnabled)
+    {
+        TraceVerbose(
+            TRACE_FILTER,
+            "-- NOT Patching PSM 0x%04X",
+            Psm
+        );
+
+        return Psm;
+    }
+
+    //
+    // Called with AclReassemblyLock held, so HciEvents is consistent
+    // 
+    isAddressKnown = (BOOLEAN)HciEvents_GetRemoteAddress(
+        &pDevCtx->HciEvents,
+        ConnectionHandle,
+        &remoteAddress
+    );
+
+    if (!BthPS3PSM_PolicyIsInScope(&pDevCtx->ActivePolicy, isAddressKnown, remoteAddress))
+    {
+        TraceVerbose(
+            TRACE_FILTER,
+            "-- NOT Patching PSM 0x%04X for out of scope remote %012llX",
+            Psm,
+            remoteAddress
+        );
+
+        return Psm;
+    }
+
+    TraceInformation(
+        TRACE_FILTER,
+        "++ Patching PSM 0x%04X to 0x%04X",
+        Psm,
+        patchedPsm
+    );
+
+    return patchedPsm;
+}
+
+//
+// Gets called for every L2CAP signalling command, records it for diagnostics
+// 
+void
+BthPS3PSM_CommandCompleted(
+    void* Context,
+    const ACL_REASSEMBLY_COMMAND* Command
+)
+{
+    const PDEVICE_CONTEXT pDevCtx = (PDEVICE_CONTEXT)Context;
+
+    BthPS3PSM_StatsAddCommand(&pDevCtx->Stats, Command);
+
+    BthPS3PSM_CaptureAdd(&pDevCtx->Capture, Command);
 }
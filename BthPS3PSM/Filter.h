@@ -45,4 +45,39 @@
 
 EVT_WDF_REQUEST_COMPLETION_ROUTINE UrbSelectConfigurationCompleted;
 
+EVT_WDF_REQUEST_COMPLETION_ROUTINE UrbSelectInterfaceCompleted;
+
 EVT_WDF_REQUEST_COMPLETION_ROUTINE UrbFunctionBulkInTransferCompleted;
+
+EVT_WDF_REQUEST_COMPLETION_ROUTINE UrbFunctionInterruptInTransferCompleted;
+
+#ifdef BTHPS3PSM_WITH_WDM_FAST_PATH
+IO_COMPLETION_ROUTINE BthPS3PSM_WdmBulkInTransferCompleted;
+#endif
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3PSM_BulkInSent(
+    _In_ PDEVICE_CONTEXT DeviceContext,
+    _In_ PURB Urb
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3PSM_BulkInSendFailed(
+    _In_ PDEVICE_CONTEXT DeviceContext,
+    _In_ PURB Urb
+);
+
+unsigned short
+BthPS3PSM_PatchPsm(
+    void* Context,
+    unsigned short ConnectionHandle,
+    unsigned short Psm
+);
+
+void
+BthPS3PSM_CommandCompleted(
+    void* Context,
+    const ACL_REASSEMBLY_COMMAND* Command
+);
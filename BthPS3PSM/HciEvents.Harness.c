@@ -0,0 +1,286 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3PSM - Windows kernel-mode BTHUSB lower filter driver                     *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+//
+// User-mode known-answer tests for the portable HCI event parser, not part of the driver build:
+//   cc -o hcievents HciEvents.c HciEvents.Harness.c && ./hcievents
+// 
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HciEvents.h"
+
+#define HARNESS_COMMAND_COMPLETE    0x0E
+
+static int G_Failures = 0;
+
+#define HARNESS_EXPECT(_cond_)                                              \
+    do {                                                                    \
+        if (!(_cond_)) {                                                    \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #_cond_); \
+            G_Failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+//
+// Appends a successful ACL Connection Complete event, returns bytes written
+// 
+static size_t
+Harness_PutConnectionComplete(
+    unsigned char* Buffer,
+    unsigned short Handle,
+    unsigned long long RemoteAddress
+)
+{
+    unsigned char* p = Buffer;
+
+    *p++ = HCI_EVENTS_CONNECTION_COMPLETE;
+    *p++ = 11;
+    *p++ = 0x00;
+    *p++ = (unsigned char)(Handle & 0xFF);
+    *p++ = (unsigned char)(Handle >> 8);
+
+    for (unsigned int index = 0; index < 6; index++)
+    {
+        *p++ = (unsigned char)(RemoteAddress >> (index * 8));
+    }
+
+    *p++ = HCI_EVENTS_LINK_TYPE_ACL;
+    *p++ = 0x00;
+
+    return (size_t)(p - Buffer);
+}
+
+//
+// Appends a successful Disconnection Complete event, returns bytes written
+// 
+static size_t
+Harness_PutDisconnectionComplete(
+    unsigned char* Buffer,
+    unsigned short Handle
+)
+{
+    unsigned char* p = Buffer;
+
+    *p++ = HCI_EVENTS_DISCONNECTION_COMPLETE;
+    *p++ = 4;
+    *p++ = 0x00;
+    *p++ = (unsigned char)(Handle & 0xFF);
+    *p++ = (unsigned char)(Handle >> 8);
+    *p++ = 0x13;
+
+    return (size_t)(p - Buffer);
+}
+
+static int
+Harness_IsConnected(
+    const HCI_EVENTS* Events,
+    unsigned short Handle,
+    unsigned long long RemoteAddress
+)
+{
+    unsigned long long address = 0;
+
+    return HciEvents_GetRemoteAddress(Events, Handle, &address) && address == RemoteAddress;
+}
+
+//
+// Connection Complete split across transfers at every offset, even within the header
+// 
+static void
+Harness_TestSplitConnectionComplete(void)
+{
+    unsigned char buffer[32];
+    const size_t length = Harness_PutConnectionComplete(buffer, 0x0040, 0x001A2B3C4D5EULL);
+
+    for (size_t split = 1; split < length; split++)
+    {
+        HCI_EVENTS events;
+
+        HciEvents_Init(&events);
+        HciEvents_Process(&events, buffer, split);
+
+        HARNESS_EXPECT(events.Connected == 0);
+
+        HciEvents_Process(&events, buffer + split, length - split);
+
+        HARNESS_EXPECT(events.Events == 1);
+        HARNESS_EXPECT(events.Connected == 1);
+        HARNESS_EXPECT(Harness_IsConnected(&events, 0x0040, 0x001A2B3C4D5EULL));
+    }
+}
+
+//
+// Parameters beyond HCI_EVENTS_MAX_PARAMETERS_LENGTH are skipped without losing 
+// track of the events behind them
+// 
+static void
+Harness_TestLongEvents(void)
+{
+    HCI_EVENTS events;
+    unsigned char buffer[512];
+    size_t length = 0;
+
+    //
+    // Unrelated event far longer than what gets kept
+    // 
+    buffer[length++] = HARNESS_COMMAND_COMPLETE;
+    buffer[length++] = 200;
+    memset(buffer + length, HCI_EVENTS_CONNECTION_COMPLETE, 200);
+    length += 200;
+
+    //
+    // Connection Complete carrying trailing bytes a later spec revision might add
+    // 
+    length += Harness_PutConnectionComplete(buffer + length, 0x0041, 0x0000AABBCCDDULL);
+    buffer[length - 12] = 11 + 5;
+    memset(buffer + length, 0xEE, 5);
+    length += 5;
+
+    length += Harness_PutConnectionComplete(buffer + length, 0x0042, 0x0000AABBCCEEULL);
+
+    HciEvents_Init(&events);
+
+    //
+    // Across transfers too, with the skip ending mid-transfer
+    // 
+    HciEvents_Process(&events, buffer, 100);
+    HciEvents_Process(&events, buffer + 100, length - 100);
+
+    HARNESS_EXPECT(events.Events == 3);
+    HARNESS_EXPECT(events.Connected == 2);
+    HARNESS_EXPECT(Harness_IsConnected(&events, 0x0041, 0x0000AABBCCDDULL));
+    HARNESS_EXPECT(Harness_IsConnected(&events, 0x0042, 0x0000AABBCCEEULL));
+}
+
+//
+// Disconnection Complete forgets the handle, others stay
+// 
+static void
+Harness_TestDisconnectionComplete(void)
+{
+    HCI_EVENTS events;
+    unsigned char buffer[64];
+    unsigned long long address;
+    size_t length = Harness_PutConnectionComplete(buffer, 0x0043, 0x000011223344ULL);
+
+    length += Harness_PutConnectionComplete(buffer + length, 0x0044, 0x000011223355ULL);
+    length += Harness_PutDisconnectionComplete(buffer + length, 0x0043);
+
+    HciEvents_Init(&events);
+    HciEvents_Process(&events, buffer, length);
+
+    HARNESS_EXPECT(events.Disconnected == 1);
+    HARNESS_EXPECT(!HciEvents_GetRemoteAddress(&events, 0x0043, &address));
+    HARNESS_EXPECT(Harness_IsConnected(&events, 0x0044, 0x000011223355ULL));
+
+    //
+    // Unknown handle changes nothing
+    // 
+    length = Harness_PutDisconnectionComplete(buffer, 0x0045);
+    HciEvents_Process(&events, buffer, length);
+
+    HARNESS_EXPECT(events.Disconnected == 1);
+    HARNESS_EXPECT(Harness_IsConnected(&events, 0x0044, 0x000011223355ULL));
+}
+
+//
+// Once all connections are in use, the oldest entry is recycled in turn
+// 
+static void
+Harness_TestVictimRecycling(void)
+{
+    HCI_EVENTS events;
+    unsigned char buffer[32];
+    unsigned long long address;
+    size_t length;
+
+    HciEvents_Init(&events);
+
+    for (unsigned short index = 0; index < HCI_EVENTS_MAX_CONNECTIONS; index++)
+    {
+        length = Harness_PutConnectionComplete(buffer, (unsigned short)(0x0100 + index), 0x1000ULL + index);
+        HciEvents_Process(&events, buffer, length);
+    }
+
+    for (unsigned short index = 0; index < HCI_EVENTS_MAX_CONNECTIONS; index++)
+    {
+        HARNESS_EXPECT(Harness_IsConnected(&events, (unsigned short)(0x0100 + index), 0x1000ULL + index));
+    }
+
+    length = Harness_PutConnectionComplete(buffer, 0x0200, 0x2000ULL);
+    HciEvents_Process(&events, buffer, length);
+
+    HARNESS_EXPECT(Harness_IsConnected(&events, 0x0200, 0x2000ULL));
+    HARNESS_EXPECT(!HciEvents_GetRemoteAddress(&events, 0x0100, &address));
+    HARNESS_EXPECT(Harness_IsConnected(&events, 0x0101, 0x1001ULL));
+
+    length = Harness_PutConnectionComplete(buffer, 0x0201, 0x2001ULL);
+    HciEvents_Process(&events, buffer, length);
+
+    HARNESS_EXPECT(Harness_IsConnected(&events, 0x0201, 0x2001ULL));
+    HARNESS_EXPECT(!HciEvents_GetRemoteAddress(&events, 0x0101, &address));
+    HARNESS_EXPECT(Harness_IsConnected(&events, 0x0200, 0x2000ULL));
+
+    //
+    // A reconnect of a known handle updates it in place instead
+    // 
+    length = Harness_PutConnectionComplete(buffer, 0x0102, 0x3000ULL);
+    HciEvents_Process(&events, buffer, length);
+
+    HARNESS_EXPECT(Harness_IsConnected(&events, 0x0102, 0x3000ULL));
+    HARNESS_EXPECT(Harness_IsConnected(&events, 0x0103, 0x1003ULL));
+}
+
+int
+main(void)
+{
+    Harness_TestSplitConnectionComplete();
+    Harness_TestLongEvents();
+    Harness_TestDisconnectionComplete();
+    Harness_TestVictimRecycling();
+
+    if (G_Failures != 0)
+    {
+        fprintf(stderr, "%d expectation(s) failed\n", G_Failures);
+        return EXIT_FAILURE;
+    }
+
+    printf("All tests passed\n");
+
+    return EXIT_SUCCESS;
+}
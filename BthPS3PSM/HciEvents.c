@@ -0,0 +1,265 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3PSM - Windows kernel-mode BTHUSB lower filter driver                     *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#include "HciEvents.h"
+
+//
+// Initializes parsing state and statistics, forgets all connections
+// 
+void
+HciEvents_Init(
+    PHCI_EVENTS Events
+)
+{
+    Events->Events = 0;
+    Events->Connected = 0;
+    Events->Disconnected = 0;
+    Events->NextVictim = 0;
+
+    for (unsigned int index = 0; index < HCI_EVENTS_MAX_CONNECTIONS; index++)
+    {
+        Events->Connections[index].ConnectionHandle = HCI_EVENTS_INVALID_HANDLE;
+        Events->Connections[index].RemoteAddress = 0;
+    }
+
+    HciEvents_Reset(Events);
+}
+
+//
+// Drops a partially received event, next byte is expected to start an event
+// 
+// Known connections are kept, handles stay valid until disconnected.
+// 
+void
+HciEvents_Reset(
+    PHCI_EVENTS Events
+)
+{
+    Events->HeaderLength = 0;
+    Events->ParametersLength = 0;
+    Events->Remaining = 0;
+}
+
+//
+// Looks up the connection of a handle, NULL if not known
+// 
+static PHCI_EVENTS_CONNECTION
+HciEvents_FindConnection(
+    PHCI_EVENTS Events,
+    unsigned short ConnectionHandle
+)
+{
+    for (unsigned int index = 0; index < HCI_EVENTS_MAX_CONNECTIONS; index++)
+    {
+        if (Events->Connections[index].ConnectionHandle == ConnectionHandle)
+        {
+            return &Events->Connections[index];
+        }
+    }
+
+    return NULL;
+}
+
+//
+// Acts on a completely received event
+// 
+static void
+HciEvents_Dispatch(
+    PHCI_EVENTS Events
+)
+{
+    const unsigned char* parameters = Events->Parameters;
+    PHCI_EVENTS_CONNECTION pConnection;
+
+    Events->Events++;
+
+    switch (Events->Header[0])
+    {
+    case HCI_EVENTS_CONNECTION_COMPLETE:
+    {
+        //
+        // Status, handle (LE), BD_ADDR (LE), link type, encryption enabled
+        // 
+        if (Events->ParametersLength < 10
+            || parameters[0] != 0x00
+            || parameters[9] != HCI_EVENTS_LINK_TYPE_ACL)
+        {
+            break;
+        }
+
+        const unsigned short handle = (unsigned short)((parameters[1] | (parameters[2] << 8)) & 0x0FFF);
+        unsigned long long address = 0;
+
+        for (unsigned int index = 6; index > 0; index--)
+        {
+            address = (address << 8) | parameters[2 + index];
+        }
+
+        pConnection = HciEvents_FindConnection(Events, handle);
+
+        if (pConnection == NULL)
+        {
+            pConnection = HciEvents_FindConnection(Events, HCI_EVENTS_INVALID_HANDLE);
+        }
+
+        //
+        // Disconnection got lost somewhere, recycle the oldest entry
+        // 
+        if (pConnection == NULL)
+        {
+            pConnection = &Events->Connections[Events->NextVictim];
+            Events->NextVictim = (Events->NextVictim + 1) % HCI_EVENTS_MAX_CONNECTIONS;
+        }
+
+        pConnection->ConnectionHandle = handle;
+        pConnection->RemoteAddress = address;
+        Events->Connected++;
+
+        break;
+    }
+    case HCI_EVENTS_DISCONNECTION_COMPLETE:
+    {
+        //
+        // Status, handle (LE), reason
+        // 
+        if (Events->ParametersLength < 3 || parameters[0] != 0x00)
+        {
+            break;
+        }
+
+        const unsigned short handle = (unsigned short)((parameters[1] | (parameters[2] << 8)) & 0x0FFF);
+
+        pConnection = HciEvents_FindConnection(Events, handle);
+
+        if (pConnection != NULL)
+        {
+            pConnection->ConnectionHandle = HCI_EVENTS_INVALID_HANDLE;
+            pConnection->RemoteAddress = 0;
+            Events->Disconnected++;
+        }
+
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+//
+// Feeds the content of a completed interrupt IN transfer
+// 
+void
+HciEvents_Process(
+    PHCI_EVENTS Events,
+    const unsigned char* Buffer,
+    size_t Length
+)
+{
+    size_t position = 0;
+
+    while (position < Length)
+    {
+        //
+        // Header: event code, parameter length
+        // 
+        if (Events->HeaderLength < HCI_EVENTS_HEADER_LENGTH)
+        {
+            Events->Header[Events->HeaderLength++] = Buffer[position++];
+
+            if (Events->HeaderLength < HCI_EVENTS_HEADER_LENGTH)
+            {
+                continue;
+            }
+
+            Events->ParametersLength = 0;
+            Events->Remaining = Events->Header[1];
+
+            if (Events->Remaining == 0)
+            {
+                HciEvents_Dispatch(Events);
+                Events->HeaderLength = 0;
+            }
+
+            continue;
+        }
+
+        if (Events->ParametersLength < HCI_EVENTS_MAX_PARAMETERS_LENGTH)
+        {
+            Events->Parameters[Events->ParametersLength++] = Buffer[position++];
+            Events->Remaining--;
+        }
+        else
+        {
+            //
+            // Not interested in trailing parameters, skip in one go
+            // 
+            const size_t available = Length - position;
+            const size_t skip = (available < Events->Remaining) ? available : Events->Remaining;
+
+            position += skip;
+            Events->Remaining -= (unsigned int)skip;
+        }
+
+        if (Events->Remaining == 0)
+        {
+            HciEvents_Dispatch(Events);
+            Events->HeaderLength = 0;
+        }
+    }
+}
+
+//
+// Resolves a connection handle to its remote address, returns non-zero if known
+// 
+int
+HciEvents_GetRemoteAddress(
+    const HCI_EVENTS* Events,
+    unsigned short ConnectionHandle,
+    unsigned long long* RemoteAddress
+)
+{
+    for (unsigned int index = 0; index < HCI_EVENTS_MAX_CONNECTIONS; index++)
+    {
+        if (Events->Connections[index].ConnectionHandle == ConnectionHandle)
+        {
+            *RemoteAddress = Events->Connections[index].RemoteAddress;
+            return 1;
+        }
+    }
+
+    return 0;
+}
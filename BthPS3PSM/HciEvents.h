@@ -0,0 +1,146 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3PSM - Windows kernel-mode BTHUSB lower filter driver                     *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#pragma once
+
+//
+// Portable (no kernel or WDF dependencies) streaming parser for HCI events 
+// as received on the interrupt IN pipe.
+// 
+// Follows Connection Complete and Disconnection Complete events to map 
+// ACL connection handles to the remote device address they belong to.
+// 
+
+#include <stddef.h>
+
+#define HCI_EVENTS_MAX_CONNECTIONS              16
+#define HCI_EVENTS_INVALID_HANDLE               0xFFFF
+
+#define HCI_EVENTS_HEADER_LENGTH                2
+
+//
+// Only the leading parameter bytes are of interest, the rest is skipped
+// 
+#define HCI_EVENTS_MAX_PARAMETERS_LENGTH        11
+
+#define HCI_EVENTS_CONNECTION_COMPLETE          0x03
+#define HCI_EVENTS_DISCONNECTION_COMPLETE       0x05
+
+#define HCI_EVENTS_LINK_TYPE_ACL                0x01
+
+//
+// Established ACL connection
+// 
+typedef struct _HCI_EVENTS_CONNECTION
+{
+    //
+    // HCI connection handle, HCI_EVENTS_INVALID_HANDLE if unused
+    // 
+    unsigned short ConnectionHandle;
+
+    //
+    // Remote BD_ADDR, same layout as BTH_ADDR
+    // 
+    unsigned long long RemoteAddress;
+
+} HCI_EVENTS_CONNECTION, *PHCI_EVENTS_CONNECTION;
+
+//
+// Event parsing state of an interrupt IN pipe and the connections seen on it
+// 
+typedef struct _HCI_EVENTS
+{
+    //
+    // Event header bytes collected so far
+    // 
+    unsigned char Header[HCI_EVENTS_HEADER_LENGTH];
+
+    unsigned int HeaderLength;
+
+    //
+    // Leading parameter bytes of the current event
+    // 
+    unsigned char Parameters[HCI_EVENTS_MAX_PARAMETERS_LENGTH];
+
+    unsigned int ParametersLength;
+
+    //
+    // Parameter bytes of the current event still expected
+    // 
+    unsigned int Remaining;
+
+    HCI_EVENTS_CONNECTION Connections[HCI_EVENTS_MAX_CONNECTIONS];
+
+    //
+    // Connection to reuse once all are occupied
+    // 
+    unsigned int NextVictim;
+
+    //
+    // Statistics
+    // 
+    unsigned long long Events;
+
+    unsigned long long Connected;
+
+    unsigned long long Disconnected;
+
+} HCI_EVENTS, *PHCI_EVENTS;
+
+void
+HciEvents_Init(
+    PHCI_EVENTS Events
+);
+
+void
+HciEvents_Reset(
+    PHCI_EVENTS Events
+);
+
+void
+HciEvents_Process(
+    PHCI_EVENTS Events,
+    const unsigned char* Buffer,
+    size_t Length
+);
+
+int
+HciEvents_GetRemoteAddress(
+    const HCI_EVENTS* Events,
+    unsigned short ConnectionHandle,
+    unsigned long long* RemoteAddress
+);
@@ -0,0 +1,503 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3PSM - Windows kernel-mode BTHUSB lower filter driver                     *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#include "Driver.h"
+#include "Policy.tmh"
+#include <BthPS3PSMETW.h>
+
+
+//
+// Default routes HID connections to the BthPS3 profile driver
+// 
+static const BTHPS3PSM_PSM_REMAP_ENTRY G_DefaultRemap[] =
+{
+    { PSM_HID_CONTROL, PSM_DS3_HID_CONTROL },
+    { PSM_HID_INTERRUPT, PSM_DS3_HID_INTERRUPT }
+};
+
+//
+// Valid PSMs are odd and have the least significant bit of the upper octet cleared
+// 
+#define BTHPS3PSM_IS_VALID_PSM(_psm_)   (((_psm_) & 0x0101) == 0x0001)
+
+//
+// Maps a PSM to its home slot in the remap table
+// 
+static ULONG
+BthPS3PSM_PolicyRemapHash(
+    _In_ USHORT Psm
+)
+{
+    //
+    // Drop the always set bit, fold the upper octet in for vendor PSMs
+    // 
+    return ((Psm >> 1) ^ (Psm >> 9)) & (BTHPS3PSM_PSM_REMAP_TABLE_SIZE - 1);
+}
+
+//
+// Validates entries and fills a zeroed remap table with them
+// 
+_Must_inspect_result_
+static NTSTATUS
+BthPS3PSM_PolicyBuildRemap(
+    _In_reads_(Count) const BTHPS3PSM_PSM_REMAP_ENTRY* Entries,
+    _In_ ULONG Count,
+    _Out_writes_(BTHPS3PSM_PSM_REMAP_TABLE_SIZE) PBTHPS3PSM_PSM_REMAP_ENTRY Table
+)
+{
+    if (Count > BTHPS3PSM_MAX_PSM_REMAP_ENTRIES)
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    RtlZeroMemory(Table, sizeof(BTHPS3PSM_PSM_REMAP_ENTRY) * BTHPS3PSM_PSM_REMAP_TABLE_SIZE);
+
+    for (ULONG entry = 0; entry < Count; entry++)
+    {
+        const USHORT originalPsm = Entries[entry].OriginalPsm;
+        const USHORT patchedPsm = Entries[entry].PatchedPsm;
+        ULONG index = BthPS3PSM_PolicyRemapHash(originalPsm);
+
+        if (!BTHPS3PSM_IS_VALID_PSM(originalPsm) || !BTHPS3PSM_IS_VALID_PSM(patchedPsm))
+        {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        //
+        // Never fills up completely so probing always hits a free slot
+        // 
+        while (Table[index].OriginalPsm != 0)
+        {
+            if (Table[index].OriginalPsm == originalPsm)
+            {
+                return STATUS_OBJECT_NAME_COLLISION;
+            }
+
+            index = (index + 1) & (BTHPS3PSM_PSM_REMAP_TABLE_SIZE - 1);
+        }
+
+        Table[index].OriginalPsm = originalPsm;
+        Table[index].PatchedPsm = patchedPsm;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
+//
+// Sets up the policy block and its persistence
+// 
+_Use_decl_annotations_
+NTSTATUS
+BthPS3PSM_PolicyInit(
+    WDFDEVICE Device,
+    ULONG IsPsmPatchingEnabled
+)
+{
+    NTSTATUS status;
+    WDF_OBJECT_ATTRIBUTES attributes;
+    WDF_TIMER_CONFIG timerCfg;
+    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(Device);
+    const PBTHPS3PSM_POLICY pPolicy = &pDevCtx->Policy;
+
+    FuncEntry(TRACE_DEVICE);
+
+    pPolicy->Generation = 0;
+    pPolicy->IsPsmPatchingEnabled = IsPsmPatchingEnabled;
+
+    pDevCtx->PersistedPsmPatchingEnabled = IsPsmPatchingEnabled;
+
+    do
+    {
+        if (!NT_SUCCESS(status = BthPS3PSM_PolicyBuildRemap(
+            G_DefaultRemap,
+            ARRAYSIZE(G_DefaultRemap),
+            pPolicy->Remap
+        )))
+        {
+            TraceError(
+                TRACE_DEVICE,
+                "BthPS3PSM_PolicyBuildRemap failed with status %!STATUS!",
+                status
+            );
+            break;
+        }
+
+        pPolicy->RemapCount = ARRAYSIZE(G_DefaultRemap);
+        pPolicy->Scope = BTHPS3PSM_PATCH_SCOPE_ALL;
+        pPolicy->ScopeCount = 0;
+
+        //
+        // Completion routine only refreshes its copy once the generation moved
+        // 
+        RtlCopyMemory(&pDevCtx->ActivePolicy, pPolicy, sizeof(BTHPS3PSM_POLICY));
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = Device;
+
+        if (!NT_SUCCESS(status = WdfSpinLockCreate(
+            &attributes,
+            &pDevCtx->PolicyLock
+        )))
+        {
+            TraceError(
+                TRACE_DEVICE,
+                "WdfSpinLockCreate failed with status %!STATUS!",
+                status
+            );
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfSpinLockCreate", status);
+            break;
+        }
+
+        WDF_TIMER_CONFIG_INIT(&timerCfg, BthPS3PSM_EvtSaveConfigTimer);
+        timerCfg.AutomaticSerialization = FALSE;
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = Device;
+        attributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+        if (!NT_SUCCESS(status = WdfTimerCreate(
+            &timerCfg,
+            &attributes,
+            &pDevCtx->SaveConfigTimer
+        )))
+        {
+            TraceError(
+                TRACE_DEVICE,
+                "WdfTimerCreate failed with status %!STATUS!",
+                status
+            );
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfTimerCreate", status);
+            break;
+        }
+
+    } while (FALSE);
+
+    FuncExit(TRACE_DEVICE, "status=%!STATUS!", status);
+
+    return status;
+}
+
+//
+// Takes a consistent copy of the policy without locking
+// 
+_Use_decl_annotations_
+VOID
+BthPS3PSM_PolicyRead(
+    const BTHPS3PSM_POLICY* Policy,
+    PBTHPS3PSM_POLICY Snapshot
+)
+{
+    LONG generation;
+
+    do
+    {
+        //
+        // Writer is busy, it runs at DISPATCH_LEVEL so this won't take long
+        // 
+        while ((generation = ReadAcquire(&Policy->Generation)) & 1)
+        {
+            YieldProcessor();
+        }
+
+        RtlCopyMemory(Snapshot, (const void*)Policy, sizeof(BTHPS3PSM_POLICY));
+
+        KeMemoryBarrier();
+
+    } while (ReadAcquire(&Policy->Generation) != generation);
+
+    Snapshot->Generation = generation;
+}
+
+//
+// Updates a snapshot taken earlier, only copies if the policy changed since
+// 
+_Use_decl_annotations_
+VOID
+BthPS3PSM_PolicyRefresh(
+    const BTHPS3PSM_POLICY* Policy,
+    PBTHPS3PSM_POLICY Snapshot
+)
+{
+    if (ReadAcquire(&Policy->Generation) != Snapshot->Generation)
+    {
+        BthPS3PSM_PolicyRead(Policy, Snapshot);
+    }
+}
+
+//
+// Publishes a new patch state and schedules persisting it
+// 
+_Use_decl_annotations_
+VOID
+BthPS3PSM_PolicySetPatching(
+    WDFDEVICE Device,
+    BOOLEAN IsEnabled
+)
+{
+    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(Device);
+
+    WdfSpinLockAcquire(pDevCtx->PolicyLock);
+
+    InterlockedIncrement(&pDevCtx->Policy.Generation);
+    pDevCtx->Policy.IsPsmPatchingEnabled = IsEnabled;
+    InterlockedIncrement(&pDevCtx->Policy.Generation);
+
+    WdfSpinLockRelease(pDevCtx->PolicyLock);
+
+    //
+    // Restarting the timer coalesces flapping into a single registry write
+    // 
+    (void)WdfTimerStart(
+        pDevCtx->SaveConfigTimer,
+        WDF_REL_TIMEOUT_IN_MS(BTHPS3PSM_POLICY_SAVE_DELAY_MS)
+    );
+}
+
+//
+// Publishes a new PSM remap table, takes effect with the next Connection Request.
+// An empty table would silently stop all patching, so Count 0 restores the defaults.
+// 
+_Use_decl_annotations_
+NTSTATUS
+BthPS3PSM_PolicySetRemap(
+    WDFDEVICE Device,
+    const BTHPS3PSM_PSM_REMAP_ENTRY* Entries,
+    ULONG Count
+)
+{
+    NTSTATUS status;
+    BTHPS3PSM_PSM_REMAP_ENTRY table[BTHPS3PSM_PSM_REMAP_TABLE_SIZE];
+    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(Device);
+
+    if (Count == 0)
+    {
+        Entries = G_DefaultRemap;
+        Count = ARRAYSIZE(G_DefaultRemap);
+    }
+
+    //
+    // Build outside the lock so readers only ever wait for the copy
+    // 
+    if (!NT_SUCCESS(status = BthPS3PSM_PolicyBuildRemap(
+        Entries,
+        Count,
+        table
+    )))
+    {
+        return status;
+    }
+
+    WdfSpinLockAcquire(pDevCtx->PolicyLock);
+
+    InterlockedIncrement(&pDevCtx->Policy.Generation);
+    RtlCopyMemory(pDevCtx->Policy.Remap, table, sizeof(table));
+    pDevCtx->Policy.RemapCount = Count;
+    InterlockedIncrement(&pDevCtx->Policy.Generation);
+
+    WdfSpinLockRelease(pDevCtx->PolicyLock);
+
+    return status;
+}
+
+//
+// Publishes the set of connections patching applies to
+// 
+_Use_decl_annotations_
+NTSTATUS
+BthPS3PSM_PolicySetScope(
+    WDFDEVICE Device,
+    ULONG Scope,
+    const ULONG64* Addresses,
+    ULONG Count
+)
+{
+    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(Device);
+
+    if (Scope > BTHPS3PSM_PATCH_SCOPE_DENY_LIST || Count > BTHPS3PSM_MAX_SCOPE_ADDRESSES)
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    WdfSpinLockAcquire(pDevCtx->PolicyLock);
+
+    InterlockedIncrement(&pDevCtx->Policy.Generation);
+    pDevCtx->Policy.Scope = Scope;
+    pDevCtx->Policy.ScopeCount = Count;
+    RtlCopyMemory(pDevCtx->Policy.ScopeAddresses, Addresses, Count * sizeof(ULONG64));
+    InterlockedIncrement(&pDevCtx->Policy.Generation);
+
+    WdfSpinLockRelease(pDevCtx->PolicyLock);
+
+    return STATUS_SUCCESS;
+}
+
+//
+// Checks if a connection is subject to patching
+// 
+_Use_decl_annotations_
+BOOLEAN
+BthPS3PSM_PolicyIsInScope(
+    const BTHPS3PSM_POLICY* Policy,
+    BOOLEAN IsAddressKnown,
+    ULONG64 RemoteAddress
+)
+{
+    BOOLEAN isListed = FALSE;
+
+    if (Policy->Scope == BTHPS3PSM_PATCH_SCOPE_ALL)
+    {
+        return TRUE;
+    }
+
+    //
+    // Connection predates us (or got lost), only an allow-list can't vouch for it
+    // 
+    if (!IsAddressKnown)
+    {
+        return (Policy->Scope == BTHPS3PSM_PATCH_SCOPE_DENY_LIST);
+    }
+
+    for (ULONG index = 0; index < Policy->ScopeCount; index++)
+    {
+        if (Policy->ScopeAddresses[index] == RemoteAddress)
+        {
+            isListed = TRUE;
+            break;
+        }
+    }
+
+    return (Policy->Scope == BTHPS3PSM_PATCH_SCOPE_ALLOW_LIST) ? isListed : !isListed;
+}
+
+//
+// Returns the PSM to patch a Connection Request with, Psm if not remapped
+// 
+_Use_decl_annotations_
+USHORT
+BthPS3PSM_PolicyRemapPsm(
+    const BTHPS3PSM_POLICY* Policy,
+    USHORT Psm
+)
+{
+    ULONG index = BthPS3PSM_PolicyRemapHash(Psm);
+
+    //
+    // Table is at most half full, so this terminates after a couple of probes
+    // 
+    while (Policy->Remap[index].OriginalPsm != 0)
+    {
+        if (Policy->Remap[index].OriginalPsm == Psm)
+        {
+            return Policy->Remap[index].PatchedPsm;
+        }
+
+        index = (index + 1) & (BTHPS3PSM_PSM_REMAP_TABLE_SIZE - 1);
+    }
+
+    return Psm;
+}
+
+//
+// Stores changed settings to registry at PASSIVE_LEVEL once changes settled
+// 
+_Use_decl_annotations_
+VOID
+BthPS3PSM_EvtSaveConfigTimer(
+    WDFTIMER Timer
+)
+{
+    NTSTATUS status;
+    BTHPS3PSM_POLICY policy;
+    const WDFDEVICE device = WdfTimerGetParentObject(Timer);
+    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(device);
+
+    DECLARE_CONST_UNICODE_STRING(patchPSMRegValue, G_PatchPSMRegValue);
+
+    FuncEntryArguments(TRACE_DEVICE, "IRQL=%!irql!", KeGetCurrentIrql());
+
+    BthPS3PSM_PolicyRead(&pDevCtx->Policy, &policy);
+
+    //
+    // Enabled and disabled again before the timer fired, nothing to write
+    // 
+    if (policy.IsPsmPatchingEnabled == pDevCtx->PersistedPsmPatchingEnabled)
+    {
+        TraceVerbose(
+            TRACE_DEVICE,
+            "Settings unchanged (generation: %d)",
+            policy.Generation
+        );
+
+        FuncExitNoReturn(TRACE_DEVICE);
+        return;
+    }
+
+    if (!NT_SUCCESS(status = WdfRegistryAssignULong(
+        pDevCtx->RegKeyDeviceNode,
+        &patchPSMRegValue,
+        policy.IsPsmPatchingEnabled
+    )))
+    {
+        TraceError(
+            TRACE_DEVICE,
+            "WdfRegistryAssignULong failed with status %!STATUS!",
+            status
+        );
+        EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfRegistryAssignULong", status);
+    }
+    else
+    {
+        TraceVerbose(
+            TRACE_DEVICE,
+            "Settings stored (generation: %d)",
+            policy.Generation
+        );
+
+        pDevCtx->PersistedPsmPatchingEnabled = policy.IsPsmPatchingEnabled;
+
+        const PWSTR instanceIdString = (const PWSTR)WdfMemoryGetBuffer(pDevCtx->InstanceId, NULL);
+
+        EventWriteSetPatchStatusForDeviceInstance(
+            NULL,
+            policy.IsPsmPatchingEnabled,
+            instanceIdString
+        );
+    }
+
+    FuncExitNoReturn(TRACE_DEVICE);
+}
@@ -0,0 +1,155 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3PSM - Windows kernel-mode BTHUSB lower filter driver                     *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#pragma once
+
+//
+// Delay before a changed policy gets persisted, restarted on every change
+// 
+#define BTHPS3PSM_POLICY_SAVE_DELAY_MS          3000
+
+#define BTHPS3PSM_PSM_REMAP_TABLE_BITS          4
+#define BTHPS3PSM_PSM_REMAP_TABLE_SIZE          (1 << BTHPS3PSM_PSM_REMAP_TABLE_BITS) /* keeps load factor below 0.5 */
+
+C_ASSERT(BTHPS3PSM_MAX_PSM_REMAP_ENTRIES < BTHPS3PSM_PSM_REMAP_TABLE_SIZE);
+
+//
+// Per-radio filter policy, published to lock-free readers
+// 
+typedef struct _BTHPS3PSM_POLICY
+{
+    //
+    // Odd while an update is in progress, bumped twice per update
+    // 
+    volatile LONG Generation;
+
+    //
+    // Patches PSM values if TRUE
+    // 
+    ULONG IsPsmPatchingEnabled;
+
+    //
+    // Number of occupied slots in Remap
+    // 
+    ULONG RemapCount;
+
+    //
+    // Open-addressed (linear probing) and keyed by OriginalPsm, 0 marks a free slot
+    // 
+    BTHPS3PSM_PSM_REMAP_ENTRY Remap[BTHPS3PSM_PSM_REMAP_TABLE_SIZE];
+
+    //
+    // One of BTHPS3PSM_PATCH_SCOPE
+    // 
+    ULONG Scope;
+
+    //
+    // Number of valid ScopeAddresses
+    // 
+    ULONG ScopeCount;
+
+    //
+    // Remote addresses patching is restricted to or excluded from
+    // 
+    ULONG64 ScopeAddresses[BTHPS3PSM_MAX_SCOPE_ADDRESSES];
+
+} BTHPS3PSM_POLICY, *PBTHPS3PSM_POLICY;
+
+_Must_inspect_result_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3PSM_PolicyInit(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG IsPsmPatchingEnabled
+);
+
+_IRQL_requires_max_(HIGH_LEVEL)
+VOID
+BthPS3PSM_PolicyRead(
+    _In_ const BTHPS3PSM_POLICY* Policy,
+    _Out_ PBTHPS3PSM_POLICY Snapshot
+);
+
+_IRQL_requires_max_(HIGH_LEVEL)
+VOID
+BthPS3PSM_PolicyRefresh(
+    _In_ const BTHPS3PSM_POLICY* Policy,
+    _Inout_ PBTHPS3PSM_POLICY Snapshot
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3PSM_PolicySetPatching(
+    _In_ WDFDEVICE Device,
+    _In_ BOOLEAN IsEnabled
+);
+
+_Must_inspect_result_
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+BthPS3PSM_PolicySetRemap(
+    _In_ WDFDEVICE Device,
+    _In_reads_(Count) const BTHPS3PSM_PSM_REMAP_ENTRY* Entries,
+    _In_ ULONG Count
+);
+
+_Must_inspect_result_
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+BthPS3PSM_PolicySetScope(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG Scope,
+    _In_reads_(Count) const ULONG64* Addresses,
+    _In_ ULONG Count
+);
+
+_IRQL_requires_max_(HIGH_LEVEL)
+BOOLEAN
+BthPS3PSM_PolicyIsInScope(
+    _In_ const BTHPS3PSM_POLICY* Policy,
+    _In_ BOOLEAN IsAddressKnown,
+    _In_ ULONG64 RemoteAddress
+);
+
+_IRQL_requires_max_(HIGH_LEVEL)
+USHORT
+BthPS3PSM_PolicyRemapPsm(
+    _In_ const BTHPS3PSM_POLICY* Policy,
+    _In_ USHORT Psm
+);
+
+EVT_WDF_TIMER BthPS3PSM_EvtSaveConfigTimer;
@@ -121,6 +121,8 @@ BthPS3PSMEvtIoInternalDeviceControl(
     {
         const PURB urb = (PURB)URB_FROM_IRP(irp);
 
+        InterlockedIncrement64(&pContext->Stats.UrbsSeen);
+
         switch (urb->UrbHeader.Function)
         {
 #pragma region URB_FUNCTION_SELECT_CONFIGURATION
@@ -160,6 +162,43 @@ BthPS3PSMEvtIoInternalDeviceControl(
 
 #pragma endregion
 
+#pragma region URB_FUNCTION_SELECT_INTERFACE
+
+        case URB_FUNCTION_SELECT_INTERFACE:
+
+            TraceVerbose(
+                TRACE_QUEUE,
+                "<< URB_FUNCTION_SELECT_INTERFACE");
+
+            WdfRequestFormatRequestUsingCurrentType(Request);
+
+            WdfRequestSetCompletionRoutine(
+                Request,
+                UrbSelectInterfaceCompleted,
+                device
+            );
+
+            ret = WdfRequestSend(
+                Request,
+                WdfDeviceGetIoTarget(WdfIoQueueGetDevice(Queue)),
+                WDF_NO_SEND_OPTIONS
+            );
+
+            if (ret == FALSE)
+            {
+                status = WdfRequestGetStatus(Request);
+                TraceError(
+                    TRACE_QUEUE,
+                    "WdfRequestSend failed with status %!STATUS!",
+                    status
+                );
+                WdfRequestComplete(Request, status);
+            }
+
+            return;
+
+#pragma endregion
+
 #pragma region URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER
 
         case URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER:
@@ -169,7 +208,12 @@ BthPS3PSMEvtIoInternalDeviceControl(
             // routine to it so we can grab the incoming data once coming
             // back from the lower driver.
             // 
-            if (urb->UrbBulkOrInterruptTransfer.PipeHandle == pContext->BulkReadPipe)
+            // If configured, skip this while patching is disabled since the
+            // completion routine wouldn't alter anything; the transfer then
+            // takes the send-and-forget path below.
+            // 
+            if (urb->UrbBulkOrInterruptTransfer.PipeHandle == pContext->BulkReadPipe
+                && (!pContext->IsInterceptArmedOnly || ReadULongNoFence(&pContext->Policy.IsPsmPatchingEnabled)))
             {
                 TraceVerbose(
                     TRACE_QUEUE,
@@ -177,6 +221,8 @@ BthPS3PSMEvtIoInternalDeviceControl(
                     urb->UrbBulkOrInterruptTransfer.PipeHandle
                 );
 
+                InterlockedIncrement64(&pContext->Stats.BulkInIntercepted);
+
                 WdfRequestFormatRequestUsingCurrentType(Request);
 
                 WdfRequestSetCompletionRoutine(
@@ -185,6 +231,44 @@ BthPS3PSMEvtIoInternalDeviceControl(
                     device
                 );
 
+                BthPS3PSM_BulkInSent(pContext, urb);
+
+                ret = WdfRequestSend(
+                    Request,
+                    WdfDeviceGetIoTarget(WdfIoQueueGetDevice(Queue)),
+                    WDF_NO_SEND_OPTIONS
+                );
+
+                if (ret == FALSE)
+                {
+                    status = WdfRequestGetStatus(Request);
+                    TraceError(
+                        TRACE_QUEUE,
+                        "WdfRequestSend failed with status %!STATUS!",
+                        status
+                    );
+                    BthPS3PSM_BulkInSendFailed(pContext, urb);
+                    WdfRequestComplete(Request, status);
+                }
+
+                return;
+            }
+
+            //
+            // HCI events are rare, always watch them to keep track of connections
+            // 
+            if (urb->UrbBulkOrInterruptTransfer.PipeHandle == pContext->InterruptReadPipe)
+            {
+                InterlockedIncrement64(&pContext->Stats.InterruptInIntercepted);
+
+                WdfRequestFormatRequestUsingCurrentType(Request);
+
+                WdfRequestSetCompletionRoutine(
+                    Request,
+                    UrbFunctionInterruptInTransferCompleted,
+                    device
+                );
+
                 ret = WdfRequestSend(
                     Request,
                     WdfDeviceGetIoTarget(WdfIoQueueGetDevice(Queue)),
@@ -205,6 +289,15 @@ BthPS3PSMEvtIoInternalDeviceControl(
                 return;
             }
 
+            //
+            // Bypassed bulk IN data is never seen, reassembly has to start over
+            // 
+            if (urb->UrbBulkOrInterruptTransfer.PipeHandle == pContext->BulkReadPipe)
+            {
+                InterlockedIncrement64(&pContext->Stats.BulkInBypassed);
+                InterlockedExchange(&pContext->IsAclReassemblyStale, TRUE);
+            }
+
             break;
 
 #pragma endregion
@@ -242,3 +335,108 @@ BthPS3PSMEvtIoInternalDeviceControl(
         WdfRequestComplete(Request, status);
     }
 }
+
+#ifdef BTHPS3PSM_WITH_WDM_FAST_PATH
+
+//
+// Handle IRP_MJ_INTERNAL_DEVICE_CONTROL requests before the framework does
+// 
+// Bulk IN transfers are the bulk of the traffic, so if enabled, attach a bare
+// completion routine to them and skip creating and queueing a WDFREQUEST.
+// Everything else (and everything while disabled) takes the regular path.
+// 
+_Use_decl_annotations_
+NTSTATUS
+BthPS3PSM_EvtWdmIrpPreprocessInternalDeviceControl(
+    WDFDEVICE Device,
+    PIRP Irp
+)
+{
+    NTSTATUS status;
+    const PDEVICE_CONTEXT pContext = DeviceGetContext(Device);
+    const PIO_STACK_LOCATION stack = IoGetCurrentIrpStackLocation(Irp);
+    const LARGE_INTEGER start = KeQueryPerformanceCounter(NULL);
+    const PURB urb = (PURB)URB_FROM_IRP(Irp);
+
+    const BOOLEAN isBulkIn = (
+        stack->Parameters.DeviceIoControl.IoControlCode == IOCTL_INTERNAL_USB_SUBMIT_URB
+        && urb->UrbHeader.Function == URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER
+        && urb->UrbBulkOrInterruptTransfer.PipeHandle == pContext->BulkReadPipe
+    );
+
+    //
+    // Only the fast path holds the remove lock, released in its completion routine; 
+    // failing to get it means removal started and the framework gets to handle it
+    // 
+    if (isBulkIn
+        && pContext->IsWdmFastPath
+        && (!pContext->IsInterceptArmedOnly || ReadULongNoFence(&pContext->Policy.IsPsmPatchingEnabled))
+        && NT_SUCCESS(IoAcquireRemoveLock(&pContext->FastPathRemoveLock, Irp)))
+    {
+        //
+        // Never reaches BthPS3PSMEvtIoInternalDeviceControl, account for it here
+        // 
+        InterlockedIncrement64(&pContext->Stats.UrbsSeen);
+        InterlockedIncrement64(&pContext->Stats.BulkInIntercepted);
+        InterlockedIncrement64(&pContext->Stats.BulkInFastPath);
+
+        IoCopyCurrentIrpStackLocationToNext(Irp);
+
+        IoSetCompletionRoutine(
+            Irp,
+            BthPS3PSM_WdmBulkInTransferCompleted,
+            Device,
+            TRUE,
+            TRUE,
+            TRUE
+        );
+
+        BthPS3PSM_BulkInSent(pContext, urb);
+
+        status = IoCallDriver(WdfDeviceWdmGetAttachedDevice(Device), Irp);
+    }
+    else
+    {
+        IoSkipCurrentIrpStackLocation(Irp);
+        status = WdfDeviceWdmDispatchPreprocessedIrp(Device, Irp);
+    }
+
+    //
+    // Both paths measured the same way so they can be compared
+    // 
+    if (isBulkIn)
+    {
+        InterlockedAdd64(
+            &pContext->Stats.BulkInDispatchTicks,
+            KeQueryPerformanceCounter(NULL).QuadPart - start.QuadPart
+        );
+        InterlockedIncrement64(&pContext->Stats.BulkInDispatches);
+    }
+
+    return status;
+}
+
+//
+// Waits for fast path IRPs to return before the device goes away
+// 
+_Use_decl_annotations_
+NTSTATUS
+BthPS3PSM_EvtWdmIrpPreprocessRemoveDevice(
+    WDFDEVICE Device,
+    PIRP Irp
+)
+{
+    const PDEVICE_CONTEXT pContext = DeviceGetContext(Device);
+
+    //
+    // Can't fail before the wait below, acquired to be released by it
+    // 
+    (void)IoAcquireRemoveLock(&pContext->FastPathRemoveLock, Irp);
+
+    IoReleaseRemoveLockAndWait(&pContext->FastPathRemoveLock, Irp);
+
+    IoSkipCurrentIrpStackLocation(Irp);
+    return WdfDeviceWdmDispatchPreprocessedIrp(Device, Irp);
+}
+
+#endif
@@ -52,4 +52,9 @@ BthPS3PSM_QueueInitialize(
 EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL BthPS3PSMEvtIoInternalDeviceControl;
 EVT_WDF_REQUEST_COMPLETION_ROUTINE UrbFunctionSelectConfigurationCompleted;
 
+#ifdef BTHPS3PSM_WITH_WDM_FAST_PATH
+EVT_WDFDEVICE_WDM_IRP_PREPROCESS BthPS3PSM_EvtWdmIrpPreprocessInternalDeviceControl;
+EVT_WDFDEVICE_WDM_IRP_PREPROCESS BthPS3PSM_EvtWdmIrpPreprocessRemoveDevice;
+#endif
+
 EXTERN_C_END
@@ -256,6 +256,70 @@ BthPS3PSM_DeleteControlDevice(
     }
 }
 
+//
+// Copies a counted string to a fixed size buffer, truncates and NULL-terminates
+// 
+static VOID
+BthPS3PSM_CopyDeviceId(
+    _Out_writes_(BTHPS3_MAX_DEVICE_ID_LEN) PWCHAR Destination,
+    _In_ PCUNICODE_STRING Source
+)
+{
+    const USHORT length = min(Source->Length / sizeof(WCHAR), BTHPS3_MAX_DEVICE_ID_LEN - 1);
+
+    RtlCopyMemory(Destination, Source->Buffer, length * sizeof(WCHAR));
+    Destination[length] = L'\0';
+}
+
+//
+// Fills in state and counters of a filter instance
+// 
+static VOID
+BthPS3PSM_GetInstance(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG DeviceIndex,
+    _Out_ PBTHPS3PSM_INSTANCE Instance
+)
+{
+    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(Device);
+    const PBTHPS3PSM_INSTANCE_COUNTERS pCounters = &Instance->Counters;
+    BTHPS3PSM_POLICY policy;
+    UNICODE_STRING string;
+    size_t instanceIdSize = 0;
+
+    RtlZeroMemory(Instance, sizeof(BTHPS3PSM_INSTANCE));
+
+    BthPS3PSM_PolicyRead(&pDevCtx->Policy, &policy);
+
+    Instance->DeviceIndex = DeviceIndex;
+    Instance->IsEnabled = (policy.IsPsmPatchingEnabled > 0);
+    Instance->Scope = policy.Scope;
+
+    WdfStringGetUnicodeString(pDevCtx->SymbolicLinkName, &string);
+    BthPS3PSM_CopyDeviceId(Instance->SymbolicLinkName, &string);
+
+    string.Buffer = (PWCH)WdfMemoryGetBuffer(pDevCtx->InstanceId, &instanceIdSize);
+    string.Length = string.MaximumLength = (USHORT)wcsnlen(string.Buffer, instanceIdSize / sizeof(WCHAR)) * sizeof(WCHAR);
+    BthPS3PSM_CopyDeviceId(Instance->InstanceId, &string);
+
+    //
+    // Take a consistent set
+    // 
+    WdfSpinLockAcquire(pDevCtx->AclReassemblyLock);
+
+    pCounters->AclPackets = pDevCtx->AclReassembly.Packets;
+    pCounters->AclFragments = pDevCtx->AclReassembly.Fragments;
+    pCounters->ConnectionRequests = pDevCtx->AclReassembly.ConnectionRequests;
+    pCounters->PatchedRequests = pDevCtx->AclReassembly.Patched;
+    pCounters->UnpatchableRequests = pDevCtx->AclReassembly.Unpatchable;
+    pCounters->DiscardedPdus = pDevCtx->AclReassembly.Discarded;
+    pCounters->Connections = pDevCtx->HciEvents.Connected;
+    pCounters->Disconnections = pDevCtx->HciEvents.Disconnected;
+    pCounters->CapturedCommands = (ULONG64)pDevCtx->Capture.Head;
+
+    WdfSpinLockRelease(pDevCtx->AclReassemblyLock);
+}
+
 #pragma warning(push)
 #pragma warning(disable:28118) // this callback will run at IRQL=PASSIVE_LEVEL
 _Use_decl_annotations_
@@ -274,10 +338,17 @@ VOID BthPS3PSM_SidebandIoDeviceControl(
     PBTHPS3PSM_ENABLE_PSM_PATCHING pEnable = NULL;
     PBTHPS3PSM_DISABLE_PSM_PATCHING pDisable = NULL;
     PBTHPS3PSM_GET_PSM_PATCHING pGet = NULL;
+    PBTHPS3PSM_SET_PSM_REMAP pRemap = NULL;
+    PBTHPS3PSM_SET_PATCH_SCOPE pScope = NULL;
+    PBTHPS3PSM_GET_SIGNALLING_CAPTURE pGetCapture = NULL;
+    PBTHPS3PSM_SIGNALLING_CAPTURE pCapture = NULL;
+    BTHPS3PSM_GET_SIGNALLING_CAPTURE captureRequest;
+    PBTHPS3PSM_INSTANCES pInstances = NULL;
+    PBTHPS3PSM_GET_STATS pStats = NULL;
+    ULONG deviceIndex;
+    ULONG count, fitting;
     UNICODE_STRING linkName;
-    WDF_WORKITEM_CONFIG wiCfg;
-    WDF_OBJECT_ATTRIBUTES attributes;
-    WDFWORKITEM workItem = NULL;
+    BTHPS3PSM_POLICY policy;
 
     FuncEntry(TRACE_SIDEBAND);
 
@@ -322,8 +393,7 @@ VOID BthPS3PSM_SidebandIoDeviceControl(
         }
         else
         {
-            pDevCtx = DeviceGetContext(device);
-            pDevCtx->IsPsmPatchingEnabled = TRUE;
+            BthPS3PSM_PolicySetPatching(device, TRUE);
 
             TraceEvents(
                 TRACE_LEVEL_VERBOSE,
@@ -331,31 +401,6 @@ VOID BthPS3PSM_SidebandIoDeviceControl(
                 "PSM patch enabled for device %d",
                 pEnable->DeviceIndex
             );
-
-            //
-            // Prepare async saving at PASSIVE_LEVEL
-            // 
-            WDF_WORKITEM_CONFIG_INIT(&wiCfg, BthPS3PSM_EvtSaveConfigToRegistry);
-            WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-            attributes.ParentObject = device;
-
-            if (!NT_SUCCESS(status = WdfWorkItemCreate(
-                &wiCfg,
-                &attributes,
-                &workItem
-            )))
-            {
-                TraceError(
-                    TRACE_SIDEBAND,
-                    "WdfWorkItemCreate failed with status %!STATUS!",
-                    status
-                );
-                EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfWorkItemCreate", status);
-            }
-            else
-            {
-                WdfWorkItemEnqueue(workItem);
-            }
         }
 
         WdfWaitLockRelease(FilterDeviceCollectionLock);
@@ -398,8 +443,7 @@ VOID BthPS3PSM_SidebandIoDeviceControl(
         }
         else
         {
-            pDevCtx = DeviceGetContext(device);
-            pDevCtx->IsPsmPatchingEnabled = FALSE;
+            BthPS3PSM_PolicySetPatching(device, FALSE);
 
             TraceEvents(
                 TRACE_LEVEL_VERBOSE,
@@ -407,31 +451,6 @@ VOID BthPS3PSM_SidebandIoDeviceControl(
                 "PSM patch disabled for device %d",
                 pDisable->DeviceIndex
             );
-
-            //
-            // Prepare async saving at PASSIVE_LEVEL
-            // 
-            WDF_WORKITEM_CONFIG_INIT(&wiCfg, BthPS3PSM_EvtSaveConfigToRegistry);
-            WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-            attributes.ParentObject = device;
-
-            if (!NT_SUCCESS(status = WdfWorkItemCreate(
-                &wiCfg,
-                &attributes,
-                &workItem
-            )))
-            {
-                TraceError(
-                    TRACE_SIDEBAND,
-                    "WdfWorkItemCreate failed with status %!STATUS!",
-                    status
-                );
-                EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfWorkItemCreate", status);
-            }
-            else
-            {
-                WdfWorkItemEnqueue(workItem);
-            }
         }
 
         WdfWaitLockRelease(FilterDeviceCollectionLock);
@@ -495,7 +514,9 @@ VOID BthPS3PSM_SidebandIoDeviceControl(
             }
             else
             {
-                pGet->IsEnabled = (pDevCtx->IsPsmPatchingEnabled > 0);
+                BthPS3PSM_PolicyRead(&pDevCtx->Policy, &policy);
+
+                pGet->IsEnabled = (policy.IsPsmPatchingEnabled > 0);
 
                 WdfStringGetUnicodeString(pDevCtx->SymbolicLinkName, &linkName);
 
@@ -524,70 +545,370 @@ VOID BthPS3PSM_SidebandIoDeviceControl(
 
 #pragma endregion
 
-    default:
-        TraceEvents(
-            TRACE_LEVEL_WARNING,
-            TRACE_SIDEBAND,
-            "Unknown I/O Control Code submitted: %X",
-            IoControlCode
+#pragma region IOCTL_BTHPS3PSM_SET_PSM_REMAP
+
+    case IOCTL_BTHPS3PSM_SET_PSM_REMAP:
+
+        status = WdfRequestRetrieveInputBuffer(
+            Request,
+            sizeof(BTHPS3PSM_SET_PSM_REMAP),
+            (void*)&pRemap,
+            &length
         );
+
+        if (!NT_SUCCESS(status) || length != sizeof(BTHPS3PSM_SET_PSM_REMAP))
+        {
+            TraceEvents(
+                TRACE_LEVEL_ERROR,
+                TRACE_SIDEBAND,
+                "WdfRequestRetrieveInputBuffer failed with status %!STATUS!",
+                status
+            );
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfRequestRetrieveInputBuffer", status);
+
+            break;
+        }
+
+        WdfWaitLockAcquire(FilterDeviceCollectionLock, NULL);
+
+        device = WdfCollectionGetItem(FilterDeviceCollection, pRemap->DeviceIndex);
+
+        if (device == NULL)
+        {
+            status = STATUS_NO_SUCH_DEVICE;
+        }
+        else if (!NT_SUCCESS(status = BthPS3PSM_PolicySetRemap(
+            device,
+            pRemap->Entries,
+            pRemap->Count
+        )))
+        {
+            TraceEvents(
+                TRACE_LEVEL_ERROR,
+                TRACE_SIDEBAND,
+                "BthPS3PSM_PolicySetRemap failed with status %!STATUS!",
+                status
+            );
+        }
+        else
+        {
+            TraceEvents(
+                TRACE_LEVEL_VERBOSE,
+                TRACE_SIDEBAND,
+                "PSM remap table with %d entries set for device %d",
+                pRemap->Count,
+                pRemap->DeviceIndex
+            );
+        }
+
+        WdfWaitLockRelease(FilterDeviceCollectionLock);
+
         break;
-    }
 
-    WdfRequestComplete(Request, status);
+#pragma endregion
 
-    FuncExitNoReturn(TRACE_SIDEBAND);
-}
-#pragma warning(pop) // enable 28118 again
+#pragma region IOCTL_BTHPS3PSM_SET_PATCH_SCOPE
 
-//
-// Async operation to store changed settings to registry at PASSIVE_LEVEL
-// 
-_Use_decl_annotations_
-void BthPS3PSM_EvtSaveConfigToRegistry(
-    WDFWORKITEM WorkItem
-)
-{
-    NTSTATUS status;
-    const WDFDEVICE device = WdfWorkItemGetParentObject(WorkItem);
-    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(device);
+    case IOCTL_BTHPS3PSM_SET_PATCH_SCOPE:
 
-    DECLARE_CONST_UNICODE_STRING(patchPSMRegValue, G_PatchPSMRegValue);
+        status = WdfRequestRetrieveInputBuffer(
+            Request,
+            sizeof(BTHPS3PSM_SET_PATCH_SCOPE),
+            (void*)&pScope,
+            &length
+        );
 
-    FuncEntryArguments(TRACE_SIDEBAND, "IRQL=%!irql!", KeGetCurrentIrql());
+        if (!NT_SUCCESS(status) || length != sizeof(BTHPS3PSM_SET_PATCH_SCOPE))
+        {
+            TraceEvents(
+                TRACE_LEVEL_ERROR,
+                TRACE_SIDEBAND,
+                "WdfRequestRetrieveInputBuffer failed with status %!STATUS!",
+                status
+            );
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfRequestRetrieveInputBuffer", status);
 
-    if (!NT_SUCCESS(status = WdfRegistryAssignULong(
-        pDevCtx->RegKeyDeviceNode,
-        &patchPSMRegValue,
-        pDevCtx->IsPsmPatchingEnabled
-    )))
-    {
-        TraceError(
-            TRACE_SIDEBAND,
-            "WdfRegistryAssignULong failed with status %!STATUS!",
-            status
+            break;
+        }
+
+        WdfWaitLockAcquire(FilterDeviceCollectionLock, NULL);
+
+        device = WdfCollectionGetItem(FilterDeviceCollection, pScope->DeviceIndex);
+
+        if (device == NULL)
+        {
+            status = STATUS_NO_SUCH_DEVICE;
+        }
+        else if (!NT_SUCCESS(status = BthPS3PSM_PolicySetScope(
+            device,
+            pScope->Scope,
+            pScope->Addresses,
+            pScope->Count
+        )))
+        {
+            TraceEvents(
+                TRACE_LEVEL_ERROR,
+                TRACE_SIDEBAND,
+                "BthPS3PSM_PolicySetScope failed with status %!STATUS!",
+                status
+            );
+        }
+        else
+        {
+            TraceEvents(
+                TRACE_LEVEL_VERBOSE,
+                TRACE_SIDEBAND,
+                "Patch scope %d with %d addresses set for device %d",
+                pScope->Scope,
+                pScope->Count,
+                pScope->DeviceIndex
+            );
+        }
+
+        WdfWaitLockRelease(FilterDeviceCollectionLock);
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_BTHPS3PSM_GET_SIGNALLING_CAPTURE
+
+    case IOCTL_BTHPS3PSM_GET_SIGNALLING_CAPTURE:
+
+        status = WdfRequestRetrieveInputBuffer(
+            Request,
+            sizeof(BTHPS3PSM_GET_SIGNALLING_CAPTURE),
+            (void*)&pGetCapture,
+            &length
         );
-        EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfRegistryAssignULong", status);
-    }
-    else
-    {
-        TraceVerbose(
+
+        if (!NT_SUCCESS(status) || length != sizeof(BTHPS3PSM_GET_SIGNALLING_CAPTURE))
+        {
+            TraceEvents(
+                TRACE_LEVEL_ERROR,
+                TRACE_SIDEBAND,
+                "WdfRequestRetrieveInputBuffer failed with status %!STATUS!",
+                status
+            );
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfRequestRetrieveInputBuffer", status);
+
+            break;
+        }
+
+        //
+        // Input and output share the system buffer
+        // 
+        captureRequest = *pGetCapture;
+
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            FIELD_OFFSET(BTHPS3PSM_SIGNALLING_CAPTURE, Data),
+            (void*)&pCapture,
+            &length
+        );
+
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(
+                TRACE_LEVEL_ERROR,
+                TRACE_SIDEBAND,
+                "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+                status
+            );
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfRequestRetrieveOutputBuffer", status);
+
+            break;
+        }
+
+        WdfWaitLockAcquire(FilterDeviceCollectionLock, NULL);
+
+        device = WdfCollectionGetItem(FilterDeviceCollection, captureRequest.DeviceIndex);
+
+        if (device == NULL)
+        {
+            status = STATUS_NO_SUCH_DEVICE;
+        }
+        else
+        {
+            pDevCtx = DeviceGetContext(device);
+
+            if (NT_SUCCESS(status = BthPS3PSM_CaptureExport(
+                &pDevCtx->Capture,
+                (BTHPS3PSM_CAPTURE_FORMAT)captureRequest.Format,
+                captureRequest.StartSequence,
+                pCapture->Data,
+                (ULONG)(length - FIELD_OFFSET(BTHPS3PSM_SIGNALLING_CAPTURE, Data)),
+                &pCapture->Length,
+                &pCapture->NextSequence,
+                &pCapture->LostEntries
+            )))
+            {
+                WdfRequestSetInformation(
+                    Request,
+                    FIELD_OFFSET(BTHPS3PSM_SIGNALLING_CAPTURE, Data) + pCapture->Length
+                );
+            }
+        }
+
+        WdfWaitLockRelease(FilterDeviceCollectionLock);
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_BTHPS3PSM_ENUMERATE_INSTANCES
+
+    case IOCTL_BTHPS3PSM_ENUMERATE_INSTANCES:
+
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            FIELD_OFFSET(BTHPS3PSM_INSTANCES, Instances),
+            (void*)&pInstances,
+            &length
+        );
+
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(
+                TRACE_LEVEL_ERROR,
+                TRACE_SIDEBAND,
+                "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+                status
+            );
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfRequestRetrieveOutputBuffer", status);
+
+            break;
+        }
+
+        fitting = (ULONG)((length - FIELD_OFFSET(BTHPS3PSM_INSTANCES, Instances)) / sizeof(BTHPS3PSM_INSTANCE));
+
+        //
+        // One pass over all radios under a single lock acquisition
+        // 
+        WdfWaitLockAcquire(FilterDeviceCollectionLock, NULL);
+
+        count = WdfCollectionGetCount(FilterDeviceCollection);
+
+        pInstances->Count = count;
+
+        for (ULONG index = 0; index < count && index < fitting; index++)
+        {
+            BthPS3PSM_GetInstance(
+                WdfCollectionGetItem(FilterDeviceCollection, index),
+                index,
+                &pInstances->Instances[index]
+            );
+        }
+
+        WdfWaitLockRelease(FilterDeviceCollectionLock);
+
+        status = (count > fitting) ? STATUS_BUFFER_OVERFLOW : STATUS_SUCCESS;
+
+        WdfRequestSetInformation(
+            Request,
+            FIELD_OFFSET(BTHPS3PSM_INSTANCES, Instances) + min(count, fitting) * sizeof(BTHPS3PSM_INSTANCE)
+        );
+
+        TraceEvents(
+            TRACE_LEVEL_VERBOSE,
             TRACE_SIDEBAND,
-            "Settings stored"
+            "Enumerated %d of %d instances",
+            min(count, fitting),
+            count
         );
 
-        const PWSTR instanceIdString = (const PWSTR)WdfMemoryGetBuffer(pDevCtx->InstanceId, NULL);
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_BTHPS3PSM_GET_STATS
 
-        EventWriteSetPatchStatusForDeviceInstance(
-            NULL,
-            pDevCtx->IsPsmPatchingEnabled,
-            instanceIdString
+    case IOCTL_BTHPS3PSM_GET_STATS:
+
+        status = WdfRequestRetrieveInputBuffer(
+            Request,
+            sizeof(BTHPS3PSM_GET_STATS),
+            (void*)&pStats,
+            &length
         );
+
+        if (!NT_SUCCESS(status) || length != sizeof(BTHPS3PSM_GET_STATS))
+        {
+            TraceEvents(
+                TRACE_LEVEL_ERROR,
+                TRACE_SIDEBAND,
+                "WdfRequestRetrieveInputBuffer failed with status %!STATUS!",
+                status
+            );
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfRequestRetrieveInputBuffer", status);
+
+            break;
+        }
+
+        //
+        // Input and output share the system buffer
+        // 
+        deviceIndex = pStats->DeviceIndex;
+
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            sizeof(BTHPS3PSM_GET_STATS),
+            (void*)&pStats,
+            &length
+        );
+
+        if (!NT_SUCCESS(status) || length != sizeof(BTHPS3PSM_GET_STATS))
+        {
+            TraceEvents(
+                TRACE_LEVEL_ERROR,
+                TRACE_SIDEBAND,
+                "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+                status
+            );
+            EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfRequestRetrieveOutputBuffer", status);
+
+            break;
+        }
+
+        WdfWaitLockAcquire(FilterDeviceCollectionLock, NULL);
+
+        device = WdfCollectionGetItem(FilterDeviceCollection, deviceIndex);
+
+        if (device == NULL)
+        {
+            status = STATUS_NO_SUCH_DEVICE;
+        }
+        else
+        {
+            RtlZeroMemory(pStats, sizeof(BTHPS3PSM_GET_STATS));
+
+            pStats->DeviceIndex = deviceIndex;
+
+            BthPS3PSM_StatsExport(device, pStats);
+
+            WdfRequestSetInformation(Request, sizeof(BTHPS3PSM_GET_STATS));
+        }
+
+        WdfWaitLockRelease(FilterDeviceCollectionLock);
+
+        break;
+
+#pragma endregion
+
+    default:
+        TraceEvents(
+            TRACE_LEVEL_WARNING,
+            TRACE_SIDEBAND,
+            "Unknown I/O Control Code submitted: %X",
+            IoControlCode
+        );
+        break;
     }
 
-    WdfObjectDelete(WorkItem);
+    WdfRequestComplete(Request, status);
 
     FuncExitNoReturn(TRACE_SIDEBAND);
 }
+#pragma warning(pop) // enable 28118 again
 
 #endif
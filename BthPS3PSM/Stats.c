@@ -0,0 +1,238 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3PSM - Windows kernel-mode BTHUSB lower filter driver                     *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#include "Driver.h"
+#include "Stats.tmh"
+#include <BthPS3PSMETW.h>
+
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, BthPS3PSM_StatsInit)
+#endif
+
+
+//
+// Creates the periodic statistics timer
+// 
+_Use_decl_annotations_
+NTSTATUS
+BthPS3PSM_StatsInit(
+    WDFDEVICE Device
+)
+{
+    NTSTATUS status;
+    WDF_TIMER_CONFIG timerCfg;
+    WDF_OBJECT_ATTRIBUTES attributes;
+    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(Device);
+
+    PAGED_CODE();
+
+    FuncEntry(TRACE_DEVICE);
+
+    RtlZeroMemory(&pDevCtx->Stats, sizeof(BTHPS3PSM_STATS));
+
+    WDF_TIMER_CONFIG_INIT_PERIODIC(
+        &timerCfg,
+        BthPS3PSM_EvtStatsTimer,
+        BTHPS3PSM_STATS_INTERVAL_MS
+    );
+    timerCfg.AutomaticSerialization = FALSE;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device;
+
+    if (!NT_SUCCESS(status = WdfTimerCreate(
+        &timerCfg,
+        &attributes,
+        &pDevCtx->Stats.Timer
+    )))
+    {
+        TraceError(
+            TRACE_DEVICE,
+            "WdfTimerCreate failed with status %!STATUS!",
+            status
+        );
+        EventWriteFailedWithNTStatus(NULL, __FUNCTION__, L"WdfTimerCreate", status);
+    }
+    else
+    {
+        WdfTimerStart(
+            pDevCtx->Stats.Timer,
+            WDF_REL_TIMEOUT_IN_MS(BTHPS3PSM_STATS_INTERVAL_MS)
+        );
+    }
+
+    FuncExit(TRACE_DEVICE, "status=%!STATUS!", status);
+
+    return status;
+}
+
+//
+// Accounts a parsed signalling command, called with AclReassemblyLock held
+// 
+_Use_decl_annotations_
+VOID
+BthPS3PSM_StatsAddCommand(
+    PBTHPS3PSM_STATS Stats,
+    const ACL_REASSEMBLY_COMMAND* Command
+)
+{
+    USHORT psm;
+    ULONG index;
+
+    Stats->SignallingCommands++;
+
+    if (Command->Code != ACL_REASSEMBLY_CONNECTION_REQUEST
+        || Command->DataLength < sizeof(USHORT))
+    {
+        return;
+    }
+
+    Stats->ConnectionRequests++;
+
+    if (Command->IsPatched)
+    {
+        Stats->PatchedPsms++;
+    }
+
+    psm = (USHORT)(Command->Data[0] | (Command->Data[1] << 8));
+
+    //
+    // Few distinct PSMs are ever seen, first come first served
+    // 
+    for (index = 0; index < BTHPS3PSM_STATS_MAX_PSMS; index++)
+    {
+        if (Stats->Psms[index].Psm == psm || Stats->Psms[index].Psm == 0)
+        {
+            break;
+        }
+    }
+
+    if (index == BTHPS3PSM_STATS_MAX_PSMS)
+    {
+        Stats->UntrackedConnectionRequests++;
+        return;
+    }
+
+    Stats->Psms[index].Psm = psm;
+    Stats->Psms[index].ConnectionRequests++;
+
+    if (Command->IsPatched)
+    {
+        Stats->Psms[index].Patched++;
+    }
+}
+
+//
+// Copies the counters of a radio into an IOCTL_BTHPS3PSM_GET_STATS payload
+// 
+_Use_decl_annotations_
+VOID
+BthPS3PSM_StatsExport(
+    WDFDEVICE Device,
+    PBTHPS3PSM_GET_STATS Stats
+)
+{
+    LARGE_INTEGER frequency;
+    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(Device);
+    const PBTHPS3PSM_STATS pStats = &pDevCtx->Stats;
+
+    KeQueryPerformanceCounter(&frequency);
+
+    Stats->UrbsSeen = (ULONG64)ReadNoFence64(&pStats->UrbsSeen);
+    Stats->BulkInIntercepted = (ULONG64)ReadNoFence64(&pStats->BulkInIntercepted);
+    Stats->BulkInBypassed = (ULONG64)ReadNoFence64(&pStats->BulkInBypassed);
+    Stats->InterruptInIntercepted = (ULONG64)ReadNoFence64(&pStats->InterruptInIntercepted);
+    Stats->BulkInFastPath = (ULONG64)ReadNoFence64(&pStats->BulkInFastPath);
+    Stats->BulkInDispatches = (ULONG64)ReadNoFence64(&pStats->BulkInDispatches);
+    Stats->BulkInDispatchTicks = (ULONG64)ReadNoFence64(&pStats->BulkInDispatchTicks);
+    Stats->Completions = (ULONG64)ReadNoFence64(&pStats->Completions);
+    Stats->CompletionTicks = (ULONG64)ReadNoFence64(&pStats->CompletionTicks);
+    Stats->BulkInCompletions = (ULONG64)ReadNoFence64(&pStats->BulkInCompletions);
+    Stats->BulkInCompletionTicks = (ULONG64)ReadNoFence64(&pStats->BulkInCompletionTicks);
+    Stats->PerformanceFrequency = (ULONG64)frequency.QuadPart;
+
+    WdfSpinLockAcquire(pDevCtx->AclReassemblyLock);
+
+    Stats->SignallingCommands = pStats->SignallingCommands;
+    Stats->ConnectionRequests = pStats->ConnectionRequests;
+    Stats->PatchedPsms = pStats->PatchedPsms;
+    Stats->UntrackedConnectionRequests = pStats->UntrackedConnectionRequests;
+
+    RtlCopyMemory(Stats->Psms, pStats->Psms, sizeof(Stats->Psms));
+
+    WdfSpinLockRelease(pDevCtx->AclReassemblyLock);
+}
+
+//
+// Emits the current counters as ETW event
+// 
+_Use_decl_annotations_
+VOID
+BthPS3PSM_EvtStatsTimer(
+    WDFTIMER Timer
+)
+{
+    BTHPS3PSM_GET_STATS stats;
+    const WDFDEVICE device = WdfTimerGetParentObject(Timer);
+    const PDEVICE_CONTEXT pDevCtx = DeviceGetContext(device);
+
+    if (!EventEnabledFilterStatistics())
+    {
+        return;
+    }
+
+    RtlZeroMemory(&stats, sizeof(BTHPS3PSM_GET_STATS));
+
+    BthPS3PSM_StatsExport(device, &stats);
+
+    EventWriteFilterStatistics(
+        NULL,
+        (PCWSTR)WdfMemoryGetBuffer(pDevCtx->InstanceId, NULL),
+        stats.UrbsSeen,
+        stats.BulkInIntercepted,
+        stats.BulkInBypassed,
+        stats.InterruptInIntercepted,
+        stats.SignallingCommands,
+        stats.ConnectionRequests,
+        stats.PatchedPsms,
+        stats.Completions,
+        stats.PerformanceFrequency
+            ? stats.CompletionTicks * 1000000 / stats.PerformanceFrequency
+            : 0
+    );
+}
@@ -0,0 +1,143 @@
+/**********************************************************************************
+ *                                                                                *
+ * BthPS3PSM - Windows kernel-mode BTHUSB lower filter driver                     *
+ *                                                                                *
+ * BSD 3-Clause License                                                           *
+ *                                                                                *
+ * Copyright (c) 2018-2024, Nefarius Software Solutions e.U.                      *
+ * All rights reserved.                                                           *
+ *                                                                                *
+ * Redistribution and use in source and binary forms, with or without             *
+ * modification, are permitted provided that the following conditions are met:    *
+ *                                                                                *
+ * 1. Redistributions of source code must retain the above copyright notice, this *
+ *    list of conditions and the following disclaimer.                            *
+ *                                                                                *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,   *
+ *    this list of conditions and the following disclaimer in the documentation   *
+ *    and/or other materials provided with the distribution.                      *
+ *                                                                                *
+ * 3. Neither the name of the copyright holder nor the names of its               *
+ *    contributors may be used to endorse or promote products derived from        *
+ *    this software without specific prior written permission.                    *
+ *                                                                                *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"    *
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE      *
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE *
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE   *
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL     *
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR     *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER     *
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  *
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE  *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.           *
+ *                                                                                *
+ **********************************************************************************/
+
+
+#pragma once
+
+//
+// Emit the FilterStatistics ETW event this often
+// 
+#define BTHPS3PSM_STATS_INTERVAL_MS             60000
+
+//
+// Hot path counters of a radio
+// 
+typedef struct _BTHPS3PSM_STATS
+{
+    //
+    // Updated with interlocked operations from concurrent dispatch routines
+    // 
+    volatile LONG64 UrbsSeen;
+
+    volatile LONG64 BulkInIntercepted;
+
+    volatile LONG64 BulkInBypassed;
+
+    volatile LONG64 InterruptInIntercepted;
+
+    volatile LONG64 BulkInFastPath;
+
+    volatile LONG64 BulkInDispatches;
+
+    volatile LONG64 BulkInDispatchTicks;
+
+    volatile LONG64 Completions;
+
+    volatile LONG64 CompletionTicks;
+
+    volatile LONG64 BulkInCompletions;
+
+    volatile LONG64 BulkInCompletionTicks;
+
+    //
+    // Updated with AclReassemblyLock held
+    // 
+    ULONG64 SignallingCommands;
+
+    ULONG64 ConnectionRequests;
+
+    ULONG64 PatchedPsms;
+
+    ULONG64 UntrackedConnectionRequests;
+
+    BTHPS3PSM_PSM_STATS Psms[BTHPS3PSM_STATS_MAX_PSMS];
+
+    //
+    // Periodically emits the FilterStatistics ETW event
+    // 
+    WDFTIMER Timer;
+
+} BTHPS3PSM_STATS, *PBTHPS3PSM_STATS;
+
+_Must_inspect_result_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+BthPS3PSM_StatsInit(
+    _In_ WDFDEVICE Device
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3PSM_StatsAddCommand(
+    _Inout_ PBTHPS3PSM_STATS Stats,
+    _In_ const ACL_REASSEMBLY_COMMAND* Command
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BthPS3PSM_StatsExport(
+    _In_ WDFDEVICE Device,
+    _Inout_ PBTHPS3PSM_GET_STATS Stats
+);
+
+EVT_WDF_TIMER BthPS3PSM_EvtStatsTimer;
+
+//
+// Wraps the completion routine body to account for the time spent in it
+// 
+#define BTHPS3PSM_STATS_COMPLETION_BEGIN()                              \
+    const LARGE_INTEGER statsStart = KeQueryPerformanceCounter(NULL)
+
+#define BTHPS3PSM_STATS_COMPLETION_END(_stats_)                         \
+    do {                                                                \
+        InterlockedAdd64(&(_stats_)->CompletionTicks,                   \
+            KeQueryPerformanceCounter(NULL).QuadPart - statsStart.QuadPart); \
+        InterlockedIncrement64(&(_stats_)->Completions);                \
+    } while (FALSE)
+
+//
+// Same for bulk IN transfers, additionally accounted on their own so both 
+// bulk IN paths can be compared
+// 
+#define BTHPS3PSM_STATS_BULK_IN_COMPLETION_END(_stats_)                 \
+    do {                                                                \
+        const LONG64 statsTicks =                                       \
+            KeQueryPerformanceCounter(NULL).QuadPart - statsStart.QuadPart; \
+        InterlockedAdd64(&(_stats_)->CompletionTicks, statsTicks);      \
+        InterlockedIncrement64(&(_stats_)->Completions);                \
+        InterlockedAdd64(&(_stats_)->BulkInCompletionTicks, statsTicks); \
+        InterlockedIncrement64(&(_stats_)->BulkInCompletions);          \
+    } while (FALSE)
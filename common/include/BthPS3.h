@@ -245,6 +245,21 @@ DEFINE_GUID(GUID_DEVINTERFACE_BTHPS3_WIRELESS,
 // 
 #define BTHPS3_REG_VALUE_CHILD_IDLE_TIMEOUT     L"ChildIdleTimeout"
 
+//
+// Number of HID Interrupt reads kept outstanding by the driver (0 disables the read ring)
+// 
+#define BTHPS3_REG_VALUE_CHILD_READ_RING_SIZE   L"ChildReadRingSize"
+
+//
+// Only keep the most recent HID Interrupt report (implies a read ring of at least 1)
+// 
+#define BTHPS3_REG_VALUE_CHILD_COALESCE_READS   L"ChildCoalesceReads"
+
+//
+// Milliseconds a disconnected PDO stays present awaiting a reconnect (0 removes it immediately)
+// 
+#define BTHPS3_REG_VALUE_CHILD_LINGER_TIMEOUT   L"ChildLingerTimeout"
+
 //
 // Should the profile driver attempt to auto-enable the patch again
 // 
@@ -362,6 +377,8 @@ typedef enum _DS_DEVICE_TYPE
 #define BUSENUM_W_IOCTL(_index_)        CTL_CODE(FILE_DEVICE_BUSENUM, _index_, METHOD_BUFFERED, FILE_WRITE_DATA)
 #define BUSENUM_R_IOCTL(_index_)        CTL_CODE(FILE_DEVICE_BUSENUM, _index_, METHOD_BUFFERED, FILE_READ_DATA)
 #define BUSENUM_RW_IOCTL(_index_)       CTL_CODE(FILE_DEVICE_BUSENUM, _index_, METHOD_BUFFERED, FILE_WRITE_DATA | FILE_READ_DATA)
+#define BUSENUM_R_DIRECT_IOCTL(_index_) CTL_CODE(FILE_DEVICE_BUSENUM, _index_, METHOD_OUT_DIRECT, FILE_READ_DATA)
+#define BUSENUM_W_DIRECT_IOCTL(_index_) CTL_CODE(FILE_DEVICE_BUSENUM, _index_, METHOD_IN_DIRECT, FILE_WRITE_DATA)
 
 #define IOCTL_BTHPS3_BASE 0x801
 
@@ -389,6 +406,91 @@ typedef enum _DS_DEVICE_TYPE
 // 
 #define IOCTL_BTHPS3_HID_INTERRUPT_WRITE        BUSENUM_W_IOCTL (IOCTL_BTHPS3_BASE + 0x203)
 
+// 
+// Read all buffered input reports from interrupt channel
+// 
+#define IOCTL_BTHPS3_HID_INTERRUPT_READ_BATCH   BUSENUM_R_IOCTL (IOCTL_BTHPS3_BASE + 0x204)
+
+// 
+// Toggle latest-value (coalescing) mode of interrupt channel reads
+// 
+#define IOCTL_BTHPS3_HID_INTERRUPT_SET_COALESCING   BUSENUM_RW_IOCTL (IOCTL_BTHPS3_BASE + 0x205)
+
+// 
+// Share a caller-supplied page with the driver which receives every interrupt channel input report
+// 
+#define IOCTL_BTHPS3_HID_INTERRUPT_MAP_MAILBOX  BUSENUM_R_DIRECT_IOCTL (IOCTL_BTHPS3_BASE + 0x206)
+
+// 
+// Read from control channel (direct I/O, report is returned in the output buffer)
+// 
+#define IOCTL_BTHPS3_HID_CONTROL_READ_DIRECT        BUSENUM_R_DIRECT_IOCTL (IOCTL_BTHPS3_BASE + 0x207)
+
+// 
+// Write to control channel (direct I/O, report is taken from the output buffer)
+// 
+#define IOCTL_BTHPS3_HID_CONTROL_WRITE_DIRECT       BUSENUM_W_DIRECT_IOCTL (IOCTL_BTHPS3_BASE + 0x208)
+
+// 
+// Read from interrupt channel (direct I/O, report is returned in the output buffer)
+// 
+#define IOCTL_BTHPS3_HID_INTERRUPT_READ_DIRECT      BUSENUM_R_DIRECT_IOCTL (IOCTL_BTHPS3_BASE + 0x209)
+
+// 
+// Write to interrupt channel (direct I/O, report is taken from the output buffer)
+// 
+#define IOCTL_BTHPS3_HID_INTERRUPT_WRITE_DIRECT     BUSENUM_W_DIRECT_IOCTL (IOCTL_BTHPS3_BASE + 0x20A)
+
+#include <pshpack1.h>
+
+//
+// Precedes every input report returned by IOCTL_BTHPS3_HID_INTERRUPT_READ_BATCH
+// 
+typedef struct _BTHPS3_HID_INPUT_REPORT_HEADER
+{
+    //
+    // Size of report data following this header
+    // 
+    OUT ULONG Length;
+
+    //
+    // KeQueryPerformanceCounter value at report arrival
+    // 
+    OUT LARGE_INTEGER Timestamp;
+
+} BTHPS3_HID_INPUT_REPORT_HEADER, *PBTHPS3_HID_INPUT_REPORT_HEADER;
+
+//
+// Payload for IOCTL_BTHPS3_HID_INTERRUPT_SET_COALESCING
+// 
+typedef struct _BTHPS3_HID_INTERRUPT_SET_COALESCING
+{
+    //
+    // Keep only the most recent input report if non-zero
+    // 
+    IN ULONG IsEnabled;
+
+    //
+    // Number of input reports replaced by a newer one so far
+    // 
+    OUT ULONG64 CoalescedReports;
+
+} BTHPS3_HID_INTERRUPT_SET_COALESCING, *PBTHPS3_HID_INTERRUPT_SET_COALESCING;
+
+//
+// Input payload for IOCTL_BTHPS3_HID_INTERRUPT_MAP_MAILBOX
+// 
+typedef struct _BTHPS3_HID_INTERRUPT_MAP_MAILBOX
+{
+    //
+    // Optional event handle (0 if unused) signalled on every new report
+    // 
+    IN ULONG64 EventHandle;
+
+} BTHPS3_HID_INTERRUPT_MAP_MAILBOX, *PBTHPS3_HID_INTERRUPT_MAP_MAILBOX;
+
+#include <poppack.h>
+
 
 /*************************************************************/
 /* I/O control codes for filter control device communication */
@@ -409,6 +511,51 @@ typedef enum _DS_DEVICE_TYPE
 // 
 #define IOCTL_BTHPS3PSM_GET_PSM_PATCHING        BUSENUM_R_IOCTL (IOCTL_BTHPS3_BASE + 0x302)
 
+//
+// Replace the PSM remap table for a supplied device index
+// 
+#define IOCTL_BTHPS3PSM_SET_PSM_REMAP           BUSENUM_W_IOCTL (IOCTL_BTHPS3_BASE + 0x303)
+
+//
+// Maximum number of entries accepted by IOCTL_BTHPS3PSM_SET_PSM_REMAP
+// 
+#define BTHPS3PSM_MAX_PSM_REMAP_ENTRIES         8
+
+//
+// Restrict PSM patching to or exclude remote addresses for a supplied device index
+// 
+#define IOCTL_BTHPS3PSM_SET_PATCH_SCOPE         BUSENUM_W_IOCTL (IOCTL_BTHPS3_BASE + 0x304)
+
+//
+// Maximum number of addresses accepted by IOCTL_BTHPS3PSM_SET_PATCH_SCOPE
+// 
+#define BTHPS3PSM_MAX_SCOPE_ADDRESSES           16
+
+//
+// Retrieve captured L2CAP signalling commands for a supplied device index
+// 
+#define IOCTL_BTHPS3PSM_GET_SIGNALLING_CAPTURE  BUSENUM_RW_IOCTL (IOCTL_BTHPS3_BASE + 0x305)
+
+//
+// Leading command data bytes kept per captured signalling command
+// 
+#define BTHPS3PSM_CAPTURE_MAX_DATA              12
+
+//
+// Retrieve state and counters of all filter instances at once
+// 
+#define IOCTL_BTHPS3PSM_ENUMERATE_INSTANCES     BUSENUM_R_IOCTL (IOCTL_BTHPS3_BASE + 0x306)
+
+//
+// Retrieve hot-path statistics for a supplied device index
+// 
+#define IOCTL_BTHPS3PSM_GET_STATS               BUSENUM_RW_IOCTL (IOCTL_BTHPS3_BASE + 0x307)
+
+//
+// Number of distinct PSMs Connection Requests are counted for
+// 
+#define BTHPS3PSM_STATS_MAX_PSMS                8
+
 #include <pshpack1.h>
 
 //
@@ -442,6 +589,426 @@ typedef struct _BTHPS3PSM_GET_PSM_PATCHING
 
 } BTHPS3PSM_GET_PSM_PATCHING, *PBTHPS3PSM_GET_PSM_PATCHING;
 
+//
+// Replaces a PSM in incoming L2CAP Connection Requests
+// 
+typedef struct _BTHPS3PSM_PSM_REMAP_ENTRY
+{
+    IN USHORT OriginalPsm;
+
+    IN USHORT PatchedPsm;
+
+} BTHPS3PSM_PSM_REMAP_ENTRY, *PBTHPS3PSM_PSM_REMAP_ENTRY;
+
+//
+// Payload for IOCTL_BTHPS3PSM_SET_PSM_REMAP
+// 
+typedef struct _BTHPS3PSM_SET_PSM_REMAP
+{
+    IN ULONG DeviceIndex;
+
+    //
+    // Number of valid Entries, 0 restores the default table (Control and
+    // Interrupt PSM of HID mapped to their BthPS3 counterparts)
+    // 
+    IN ULONG Count;
+
+    IN BTHPS3PSM_PSM_REMAP_ENTRY Entries[BTHPS3PSM_MAX_PSM_REMAP_ENTRIES];
+
+} BTHPS3PSM_SET_PSM_REMAP, *PBTHPS3PSM_SET_PSM_REMAP;
+
+//
+// Connections PSM patching applies to
+// 
+typedef enum _BTHPS3PSM_PATCH_SCOPE
+{
+    //
+    // Every connection (default)
+    // 
+    BTHPS3PSM_PATCH_SCOPE_ALL = 0,
+
+    //
+    // Only connections to listed remote addresses
+    // 
+    BTHPS3PSM_PATCH_SCOPE_ALLOW_LIST,
+
+    //
+    // Every connection except those to listed remote addresses
+    // 
+    BTHPS3PSM_PATCH_SCOPE_DENY_LIST
+
+} BTHPS3PSM_PATCH_SCOPE;
+
+//
+// Payload for IOCTL_BTHPS3PSM_SET_PATCH_SCOPE
+// 
+typedef struct _BTHPS3PSM_SET_PATCH_SCOPE
+{
+    IN ULONG DeviceIndex;
+
+    //
+    // One of BTHPS3PSM_PATCH_SCOPE
+    // 
+    IN ULONG Scope;
+
+    //
+    // Number of valid Addresses
+    // 
+    IN ULONG Count;
+
+    IN ULONG64 Addresses[BTHPS3PSM_MAX_SCOPE_ADDRESSES];
+
+} BTHPS3PSM_SET_PATCH_SCOPE, *PBTHPS3PSM_SET_PATCH_SCOPE;
+
+//
+// Layout of data returned by IOCTL_BTHPS3PSM_GET_SIGNALLING_CAPTURE
+// 
+typedef enum _BTHPS3PSM_CAPTURE_FORMAT
+{
+    //
+    // Array of BTHPS3PSM_SIGNALLING_CAPTURE_ENTRY
+    // 
+    BTHPS3PSM_CAPTURE_FORMAT_RAW = 0,
+
+    //
+    // Complete pcap file (LINKTYPE_BLUETOOTH_HCI_H4), one ACL packet per command 
+    // as forwarded to BTHUSB, i.e. with patched PSMs
+    // 
+    BTHPS3PSM_CAPTURE_FORMAT_PCAP
+
+} BTHPS3PSM_CAPTURE_FORMAT;
+
+//
+// L2CAP signalling command received on the bulk IN pipe
+// 
+typedef struct _BTHPS3PSM_SIGNALLING_CAPTURE_ENTRY
+{
+    //
+    // Position in the capture, increments by one per command
+    // 
+    ULONG64 Sequence;
+
+    //
+    // KeQuerySystemTimePrecise value at arrival
+    // 
+    LARGE_INTEGER Timestamp;
+
+    USHORT ConnectionHandle;
+
+    UCHAR Code;
+
+    UCHAR Identifier;
+
+    //
+    // Length of command data as announced in the command header
+    // 
+    USHORT Length;
+
+    //
+    // PSM of Connection Requests as received, 0 otherwise
+    // 
+    USHORT Psm;
+
+    //
+    // PSM forwarded in place of Psm if IsPatched is set
+    // 
+    USHORT PatchedPsm;
+
+    //
+    // Channel IDs carried by connection, configuration and disconnection commands, 0 otherwise
+    // 
+    USHORT DestinationCid;
+
+    USHORT SourceCid;
+
+    UCHAR IsPatched;
+
+    //
+    // Number of valid bytes in Data
+    // 
+    UCHAR DataLength;
+
+    //
+    // Leading command data bytes as received
+    // 
+    UCHAR Data[BTHPS3PSM_CAPTURE_MAX_DATA];
+
+} BTHPS3PSM_SIGNALLING_CAPTURE_ENTRY, *PBTHPS3PSM_SIGNALLING_CAPTURE_ENTRY;
+
+//
+// Input payload for IOCTL_BTHPS3PSM_GET_SIGNALLING_CAPTURE
+// 
+typedef struct _BTHPS3PSM_GET_SIGNALLING_CAPTURE
+{
+    IN ULONG DeviceIndex;
+
+    //
+    // One of BTHPS3PSM_CAPTURE_FORMAT
+    // 
+    IN ULONG Format;
+
+    //
+    // First sequence to return, NextSequence of the previous call to poll
+    // 
+    IN ULONG64 StartSequence;
+
+} BTHPS3PSM_GET_SIGNALLING_CAPTURE, *PBTHPS3PSM_GET_SIGNALLING_CAPTURE;
+
+//
+// Output payload for IOCTL_BTHPS3PSM_GET_SIGNALLING_CAPTURE
+// 
+typedef struct _BTHPS3PSM_SIGNALLING_CAPTURE
+{
+    //
+    // StartSequence to supply to continue where this call stopped
+    // 
+    OUT ULONG64 NextSequence;
+
+    //
+    // Commands overwritten before they could be retrieved
+    // 
+    OUT ULONG64 LostEntries;
+
+    //
+    // Number of valid bytes in Data
+    // 
+    OUT ULONG Length;
+
+    //
+    // Captured commands in the requested format, output buffer size permitting
+    // 
+    OUT UCHAR Data[1];
+
+} BTHPS3PSM_SIGNALLING_CAPTURE, *PBTHPS3PSM_SIGNALLING_CAPTURE;
+
+//
+// Traffic counters of a filter instance since it got loaded
+// 
+typedef struct _BTHPS3PSM_INSTANCE_COUNTERS
+{
+    //
+    // HCI ACL packets received on the bulk IN pipe
+    // 
+    OUT ULONG64 AclPackets;
+
+    //
+    // HCI ACL continuation fragments received
+    // 
+    OUT ULONG64 AclFragments;
+
+    //
+    // L2CAP Connection Requests seen
+    // 
+    OUT ULONG64 ConnectionRequests;
+
+    //
+    // Connection Requests with their PSM replaced
+    // 
+    OUT ULONG64 PatchedRequests;
+
+    //
+    // Connection Requests which should have been patched but were split across transfers
+    // 
+    OUT ULONG64 UnpatchableRequests;
+
+    //
+    // L2CAP PDUs dropped because they couldn't be reassembled
+    // 
+    OUT ULONG64 DiscardedPdus;
+
+    //
+    // ACL connections established and torn down
+    // 
+    OUT ULONG64 Connections;
+
+    OUT ULONG64 Disconnections;
+
+    //
+    // Signalling commands recorded for IOCTL_BTHPS3PSM_GET_SIGNALLING_CAPTURE
+    // 
+    OUT ULONG64 CapturedCommands;
+
+} BTHPS3PSM_INSTANCE_COUNTERS, *PBTHPS3PSM_INSTANCE_COUNTERS;
+
+//
+// Filter instance as returned by IOCTL_BTHPS3PSM_ENUMERATE_INSTANCES
+// 
+typedef struct _BTHPS3PSM_INSTANCE
+{
+    //
+    // Value to supply as DeviceIndex to address this instance
+    // 
+    OUT ULONG DeviceIndex;
+
+    OUT ULONG IsEnabled;
+
+    //
+    // One of BTHPS3PSM_PATCH_SCOPE
+    // 
+    OUT ULONG Scope;
+
+    OUT WCHAR SymbolicLinkName[BTHPS3_MAX_DEVICE_ID_LEN];
+
+    OUT WCHAR InstanceId[BTHPS3_MAX_DEVICE_ID_LEN];
+
+    OUT BTHPS3PSM_INSTANCE_COUNTERS Counters;
+
+} BTHPS3PSM_INSTANCE, *PBTHPS3PSM_INSTANCE;
+
+//
+// Output payload for IOCTL_BTHPS3PSM_ENUMERATE_INSTANCES
+// 
+// Fails with STATUS_BUFFER_OVERFLOW if not all instances fit, 
+// Count is set regardless so the caller can grow its buffer.
+// 
+typedef struct _BTHPS3PSM_INSTANCES
+{
+    //
+    // Number of filter instances
+    // 
+    OUT ULONG Count;
+
+    OUT BTHPS3PSM_INSTANCE Instances[1];
+
+} BTHPS3PSM_INSTANCES, *PBTHPS3PSM_INSTANCES;
+
+//
+// Connection Requests of one PSM
+// 
+typedef struct _BTHPS3PSM_PSM_STATS
+{
+    //
+    // PSM as received, 0 if the entry is unused
+    // 
+    OUT USHORT Psm;
+
+    OUT ULONG64 ConnectionRequests;
+
+    OUT ULONG64 Patched;
+
+} BTHPS3PSM_PSM_STATS, *PBTHPS3PSM_PSM_STATS;
+
+//
+// Payload for IOCTL_BTHPS3PSM_GET_STATS
+// 
+typedef struct _BTHPS3PSM_GET_STATS
+{
+    IN ULONG DeviceIndex;
+
+    //
+    // IOCTL_INTERNAL_USB_SUBMIT_URB requests passing the filter
+    // 
+    OUT ULONG64 UrbsSeen;
+
+    //
+    // Bulk IN transfers a completion routine got attached to
+    // 
+    OUT ULONG64 BulkInIntercepted;
+
+    //
+    // Bulk IN transfers forwarded untouched while patching was disabled
+    // 
+    OUT ULONG64 BulkInBypassed;
+
+    //
+    // Interrupt IN (HCI event) transfers a completion routine got attached to
+    // 
+    OUT ULONG64 InterruptInIntercepted;
+
+    //
+    // L2CAP signalling commands parsed
+    // 
+    OUT ULONG64 SignallingCommands;
+
+    //
+    // L2CAP Connection Requests observed
+    // 
+    OUT ULONG64 ConnectionRequests;
+
+    //
+    // Connection Requests with their PSM replaced
+    // 
+    OUT ULONG64 PatchedPsms;
+
+    //
+    // Connection Requests of PSMs not fitting into Psms any more
+    // 
+    OUT ULONG64 UntrackedConnectionRequests;
+
+    //
+    // Completion routine invocations and time spent in them
+    // 
+    OUT ULONG64 Completions;
+
+    OUT ULONG64 CompletionTicks;
+
+    //
+    // KeQueryPerformanceCounter ticks per second
+    // 
+    OUT ULONG64 PerformanceFrequency;
+
+    OUT BTHPS3PSM_PSM_STATS Psms[BTHPS3PSM_STATS_MAX_PSMS];
+
+    //
+    // Bulk IN transfers intercepted bypassing the framework
+    // 
+    OUT ULONG64 BulkInFastPath;
+
+    //
+    // Bulk IN transfers dispatched and time spent doing so, whatever the path
+    // 
+    OUT ULONG64 BulkInDispatches;
+
+    OUT ULONG64 BulkInDispatchTicks;
+
+    //
+    // Bulk IN completion routine invocations and time spent in them, whatever the 
+    // path; Completions additionally includes interrupt IN transfers
+    // 
+    OUT ULONG64 BulkInCompletions;
+
+    OUT ULONG64 BulkInCompletionTicks;
+
+} BTHPS3PSM_GET_STATS, *PBTHPS3PSM_GET_STATS;
+
 #include <poppack.h>
 
+//
+// Output buffer of IOCTL_BTHPS3_HID_INTERRUPT_MAP_MAILBOX
+// 
+// The request stays pending while the mailbox is in use, cancel it or close the
+// handle to unregister. It completes with STATUS_DEVICE_NOT_CONNECTED once the
+// device is removed.
+// Readers take a consistent snapshot by retrying until SeqLock is even and
+// unchanged before and after copying the report.
+// 
+typedef struct _BTHPS3_HID_INPUT_REPORT_MAILBOX
+{
+    //
+    // Incremented before and after every update, odd while an update is in progress
+    // 
+    OUT volatile LONG SeqLock;
+
+    //
+    // Size of valid data in Data
+    // 
+    OUT ULONG Length;
+
+    //
+    // Number of reports published so far
+    // 
+    OUT volatile LONG64 Sequence;
+
+    //
+    // KeQueryPerformanceCounter value at report arrival
+    // 
+    OUT LARGE_INTEGER Timestamp;
+
+    //
+    // Latest input report
+    // 
+    OUT UCHAR Data[BTHPS3_SIXAXIS_HID_INPUT_REPORT_SIZE];
+
+} BTHPS3_HID_INPUT_REPORT_MAILBOX, *PBTHPS3_HID_INPUT_REPORT_MAILBOX;
+
 #pragma endregion
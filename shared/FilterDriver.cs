@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Collections.Generic;
 using System.Diagnostics.CodeAnalysis;
 using System.Runtime.InteropServices;
 
@@ -12,6 +13,7 @@ public class FilterDriver
     private const uint IOCTL_BTHPS3PSM_ENABLE_PSM_PATCHING = 0x002AAC04;
     private const uint IOCTL_BTHPS3PSM_DISABLE_PSM_PATCHING = 0x002AAC08;
     private const uint IOCTL_BTHPS3PSM_GET_PSM_PATCHING = 0x002A6C0C;
+    private const uint IOCTL_BTHPS3PSM_ENUMERATE_INSTANCES = 0x002A6C1C;
 
     private static readonly string BTHPS3PSM_CONTROL_DEVICE_PATH = "\\\\.\\BthPS3PSMControl";
 
@@ -134,6 +136,76 @@ public class FilterDriver
         }
     }
 
+    /// <summary>
+    ///     Retrieves state and counters of every filter instance (one per radio) in a single request.
+    /// </summary>
+    public static IReadOnlyList<FilterInstance> GetInstances()
+    {
+        using Kernel32.SafeObjectHandle handle = Kernel32.CreateFile(BTHPS3PSM_CONTROL_DEVICE_PATH,
+            Kernel32.ACCESS_MASK.GenericRight.GENERIC_READ | Kernel32.ACCESS_MASK.GenericRight.GENERIC_WRITE,
+            Kernel32.FileShare.FILE_SHARE_READ | Kernel32.FileShare.FILE_SHARE_WRITE,
+            IntPtr.Zero, Kernel32.CreationDisposition.OPEN_EXISTING,
+            Kernel32.CreateFileFlags.FILE_ATTRIBUTE_NORMAL
+            | Kernel32.CreateFileFlags.FILE_FLAG_NO_BUFFERING
+            | Kernel32.CreateFileFlags.FILE_FLAG_WRITE_THROUGH,
+            Kernel32.SafeObjectHandle.Null
+        );
+        if (handle.IsInvalid)
+        {
+            throw new Exception(ErrorMessage);
+        }
+
+        int instanceSize = Marshal.SizeOf<BTHPS3PSM_INSTANCE>();
+        int capacity = 4;
+
+        while (true)
+        {
+            int bufferSize = sizeof(uint) + capacity * instanceSize;
+            IntPtr buffer = Marshal.AllocHGlobal(bufferSize);
+
+            try
+            {
+                Marshal.WriteInt32(buffer, 0);
+
+                // fails with ERROR_MORE_DATA if too small, Count is valid regardless
+                Kernel32.DeviceIoControl(
+                    handle,
+                    unchecked((int)IOCTL_BTHPS3PSM_ENUMERATE_INSTANCES),
+                    IntPtr.Zero,
+                    0,
+                    buffer,
+                    bufferSize,
+                    out _,
+                    IntPtr.Zero
+                );
+
+                int count = Marshal.ReadInt32(buffer);
+
+                if (count > capacity)
+                {
+                    capacity = count;
+                    continue;
+                }
+
+                List<FilterInstance> instances = new(count);
+
+                for (int index = 0; index < count; index++)
+                {
+                    BTHPS3PSM_INSTANCE instance = Marshal.PtrToStructure<BTHPS3PSM_INSTANCE>(
+                        buffer + sizeof(uint) + index * instanceSize);
+
+                    instances.Add(new FilterInstance(instance));
+                }
+
+                return instances;
+            }
+            finally
+            {
+                Marshal.FreeHGlobal(buffer);
+            }
+        }
+    }
+
     [StructLayout(LayoutKind.Sequential, Pack = 1)]
     private struct BTHPS3PSM_ENABLE_PSM_PATCHING
     {
@@ -157,4 +229,106 @@ public class FilterDriver
         [MarshalAs(UnmanagedType.ByValTStr, SizeConst = 0xC8)]
         public readonly string SymbolicLinkName;
     }
-}
\ No newline at end of file
+
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    internal struct BTHPS3PSM_INSTANCE_COUNTERS
+    {
+        public readonly ulong AclPackets;
+        public readonly ulong AclFragments;
+        public readonly ulong ConnectionRequests;
+        public readonly ulong PatchedRequests;
+        public readonly ulong UnpatchableRequests;
+        public readonly ulong DiscardedPdus;
+        public readonly ulong Connections;
+        public readonly ulong Disconnections;
+        public readonly ulong CapturedCommands;
+    }
+
+    [StructLayout(LayoutKind.Sequential, Pack = 1, CharSet = CharSet.Unicode)]
+    internal struct BTHPS3PSM_INSTANCE
+    {
+        public readonly uint DeviceIndex;
+
+        public readonly uint IsEnabled;
+
+        public readonly uint Scope;
+
+        [MarshalAs(UnmanagedType.ByValTStr, SizeConst = 0xC8)]
+        public readonly string SymbolicLinkName;
+
+        [MarshalAs(UnmanagedType.ByValTStr, SizeConst = 0xC8)]
+        public readonly string InstanceId;
+
+        public readonly BTHPS3PSM_INSTANCE_COUNTERS Counters;
+    }
+}
+
+/// <summary>
+///     State and counters of the filter driver loaded on one Bluetooth host radio.
+/// </summary>
+public sealed class FilterInstance
+{
+    internal FilterInstance(FilterDriver.BTHPS3PSM_INSTANCE instance)
+    {
+        DeviceIndex = instance.DeviceIndex;
+        IsEnabled = instance.IsEnabled > 0;
+        SymbolicLinkName = instance.SymbolicLinkName;
+        InstanceId = instance.InstanceId;
+        AclPackets = instance.Counters.AclPackets;
+        ConnectionRequests = instance.Counters.ConnectionRequests;
+        PatchedRequests = instance.Counters.PatchedRequests;
+        UnpatchableRequests = instance.Counters.UnpatchableRequests;
+        DiscardedPdus = instance.Counters.DiscardedPdus;
+        Connections = instance.Counters.Connections;
+    }
+
+    /// <summary>
+    ///     Index to address this instance with.
+    /// </summary>
+    public uint DeviceIndex { get; }
+
+    /// <summary>
+    ///     True if PSM patching is enabled.
+    /// </summary>
+    public bool IsEnabled { get; }
+
+    /// <summary>
+    ///     Symbolic link name of the host radio.
+    /// </summary>
+    public string SymbolicLinkName { get; }
+
+    /// <summary>
+    ///     Device instance ID of the host radio.
+    /// </summary>
+    public string InstanceId { get; }
+
+    /// <summary>
+    ///     HCI ACL packets received.
+    /// </summary>
+    public ulong AclPackets { get; }
+
+    /// <summary>
+    ///     L2CAP Connection Requests seen.
+    /// </summary>
+    public ulong ConnectionRequests { get; }
+
+    /// <summary>
+    ///     Connection Requests with their PSM replaced.
+    /// </summary>
+    public ulong PatchedRequests { get; }
+
+    /// <summary>
+    ///     Connection Requests which couldn't be patched.
+    /// </summary>
+    public ulong UnpatchableRequests { get; }
+
+    /// <summary>
+    ///     L2CAP PDUs dropped during reassembly.
+    /// </summary>
+    public ulong DiscardedPdus { get; }
+
+    /// <summary>
+    ///     ACL connections established.
+    /// </summary>
+    public ulong Connections { get; }
+}